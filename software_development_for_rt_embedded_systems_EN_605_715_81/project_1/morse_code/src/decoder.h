@@ -0,0 +1,193 @@
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "morse_code.h"
+
+// Streaming morse code decoder. Timestamped level changes of a keyed signal are fed in as they
+// arrive and characters are handed to a callback as soon as the silence after them is long enough
+// to be a letter gap.
+//
+// The dot length is not configured. It is estimated online from the marks themselves: a mark
+// shorter than two dots is a dot, anything longer is a dash worth three dots, and every mark nudges
+// the estimate towards what it implies. Consecutive marks that differ by more than a factor of two
+// and marks far longer than a dash pull the estimate much harder, which lets the decoder recover
+// within a few elements when an operator jumps anywhere between MIN_WPM and MAX_WPM.
+//
+// Gaps shorter than two dots separate elements, gaps up to five dots separate letters and longer
+// gaps separate words.
+//
+// Letters are looked up by their packed code in REVERSE_CODES, which is MORSE_CODES turned around.
+// Nothing in here depends on Arduino, so it can be compiled and run on the host.
+
+namespace decoder {
+
+inline constexpr uint32_t MIN_WPM = 5;
+inline constexpr uint32_t MAX_WPM = 40;
+inline constexpr uint32_t INITIAL_WPM = 15;
+
+// PARIS timing: one dot lasts 1.2 seconds divided by the words per minute.
+constexpr uint32_t DotMicros(uint32_t wpm) {
+  return 1200000 / wpm;
+}
+
+// Emitted for a mark sequence that does not match any code.
+inline constexpr char UNKNOWN_LETTER = '*';
+
+namespace internal {
+
+struct ReverseTable {
+  char letters[256];
+
+  constexpr char operator[](uint8_t code) const {
+    return letters[code];
+  }
+};
+
+// Printable characters claim their codes first so that e.g. -.- decodes to 'K' rather than the
+// invitation prosign. Lower case letters never win since their upper case version comes first.
+constexpr ReverseTable BuildReverseTable() {
+  ReverseTable table{};
+  for (int pass = 0; pass < 2; ++pass) {
+    for (int ascii = 0; ascii < 256; ++ascii) {
+      bool printable = ascii >= ' ' && ascii < 127;
+      uint8_t code = morse::MORSE_CODES[static_cast<char>(ascii)];
+      if (printable == (pass == 0) && code != 0 && table.letters[code] == 0) {
+        table.letters[code] = static_cast<char>(ascii);
+      }
+    }
+  }
+
+  return table;
+}
+
+} // internal
+
+inline constexpr internal::ReverseTable REVERSE_CODES = internal::BuildReverseTable();
+static_assert(REVERSE_CODES[morse::MORSE_CODES['K']] == 'K', "Letters must win over prosigns");
+
+using LetterCallback = void (*)(char letter);
+
+class Decoder {
+ public:
+  explicit Decoder(LetterCallback on_letter) : on_letter_(on_letter) {}
+
+  // Feeds a level change. `time_us` is when the signal switched to `level` (true for key down).
+  void OnEdge(uint32_t time_us, bool level) {
+    if (!started_) {
+      started_ = true;
+      level_ = level;
+      last_edge_us_ = time_us;
+      return;
+    }
+
+    if (level == level_) {
+      return;
+    }
+
+    uint32_t duration_us = time_us - last_edge_us_;
+    if (level_) {
+      AddMark(duration_us);
+    } else {
+      CloseGap(duration_us);
+    }
+
+    level_ = level;
+    last_edge_us_ = time_us;
+  }
+
+  // Emits whatever the silence since the last mark has completed. Has to be called periodically,
+  // otherwise the last letter of a transmission is only emitted when the next one starts.
+  void Poll(uint32_t now_us) {
+    if (started_ && !level_) {
+      CloseGap(now_us - last_edge_us_);
+    }
+  }
+
+  uint32_t DotEstimateMicros() const {
+    return dot_us_;
+  }
+
+  uint32_t Wpm() const {
+    return 1200000 / dot_us_;
+  }
+
+ private:
+  void AddMark(uint32_t mark_us) {
+    // Two consecutive marks at least a factor two apart have to be a dot and a dash, whatever the
+    // current estimate says. Pulling hard towards the dot they imply is what lets the estimate
+    // escape when the speed changed so much that dots and dashes fall on the same side of it.
+    if (last_mark_us_ != 0 && (mark_us >= 2 * last_mark_us_ || last_mark_us_ >= 2 * mark_us)) {
+      uint32_t shorter_us = mark_us < last_mark_us_ ? mark_us : last_mark_us_;
+      uint32_t longer_us = mark_us < last_mark_us_ ? last_mark_us_ : mark_us;
+      dot_us_ = (dot_us_ + (shorter_us + longer_us / 3) / 2) / 2;
+    }
+    last_mark_us_ = mark_us;
+
+    bool dash = mark_us >= 2 * dot_us_;
+    uint32_t implied_dot_us = dash ? mark_us / 3 : mark_us;
+    if (mark_us >= 6 * dot_us_) {
+      dot_us_ = implied_dot_us;
+    } else {
+      dot_us_ = (3 * dot_us_ + implied_dot_us) / 4;
+    }
+
+    if (dot_us_ < DotMicros(MAX_WPM)) {
+      dot_us_ = DotMicros(MAX_WPM);
+    } else if (dot_us_ > DotMicros(MIN_WPM)) {
+      dot_us_ = DotMicros(MIN_WPM);
+    }
+
+    // Seven elements is the longest code that fits in a packed byte.
+    if (code_length_ == 7) {
+      overflowed_ = true;
+      return;
+    }
+
+    code_pattern_ |= (uint8_t)dash << code_length_;
+    ++code_length_;
+  }
+
+  void CloseGap(uint32_t gap_us) {
+    if (code_length_ != 0 && gap_us >= 2 * dot_us_) {
+      EmitLetter();
+    }
+
+    if (!word_closed_ && gap_us >= 5 * dot_us_) {
+      word_closed_ = true;
+      on_letter_(' ');
+    }
+  }
+
+  void EmitLetter() {
+    char letter = REVERSE_CODES[code_pattern_ | (1 << code_length_)];
+    if (overflowed_ || letter == 0) {
+      letter = UNKNOWN_LETTER;
+    }
+
+    code_pattern_ = 0;
+    code_length_ = 0;
+    overflowed_ = false;
+    word_closed_ = false;
+    on_letter_(letter);
+  }
+
+  LetterCallback on_letter_;
+
+  bool started_ = false;
+  bool level_ = false;
+  uint32_t last_edge_us_ = 0;
+  uint32_t dot_us_ = DotMicros(INITIAL_WPM);
+  uint32_t last_mark_us_ = 0;
+
+  uint8_t code_pattern_ = 0;
+  uint8_t code_length_ = 0;
+  bool overflowed_ = false;
+  bool word_closed_ = true;
+};
+
+} // decoder
+
+#endif // DECODER_H
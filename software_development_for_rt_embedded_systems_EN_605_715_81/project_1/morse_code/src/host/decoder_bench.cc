@@ -0,0 +1,183 @@
+// Host benchmark of decoder::Decoder, built by the native environment:
+//
+//   pio run -e native
+//   .pio/build/native/program [--repeat N] [--jitter PERCENT] [--seed N]
+//
+// Synthesizes keyed traces of a test text at fixed speeds from MIN_WPM to MAX_WPM, and one that
+// jumps to a random speed in that range every few words, with every mark and gap jittered. Each
+// trace is decoded from a fresh decoder starting at INITIAL_WPM. Prints the share of characters
+// decoded correctly and how much faster than real time decoding ran.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "decoder.h"
+#include "timeline.h"
+
+namespace {
+
+const char* const TEXT = "THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG 0123456789 PARIS CQ DE K1ABC";
+
+struct Edge {
+  uint32_t time_us;
+  bool level;
+};
+
+struct Trace {
+  std::vector<Edge> edges;
+  std::string text;
+  uint32_t end_us = 0;
+};
+
+std::string decoded;
+
+// Appends `words` keyed at `wpm` to `trace`, marks and gaps jittered by up to `jitter` of their
+// length. The timeline's closing word gap separates it from whatever follows.
+void AppendWords(Trace& trace, const std::string& words, uint32_t wpm, double jitter,
+                 std::mt19937& random) {
+  static timeline::Timeline compiled;
+  if (!timeline::Compile(words.c_str(), compiled)) {
+    return;
+  }
+
+  std::uniform_real_distribution<double> spread(1 - jitter, 1 + jitter);
+  double dot_us = decoder::DotMicros(wpm);
+  for (size_t i = 0; i < compiled.length; ++i) {
+    trace.edges.push_back({trace.end_us, (bool)compiled.edges[i].mark});
+    trace.end_us += (uint32_t)(compiled.edges[i].units * dot_us * spread(random));
+  }
+  if (!trace.text.empty()) {
+    trace.text += ' ';
+  }
+  trace.text += words;
+}
+
+// Edit distance between what was sent and what was decoded, in characters.
+size_t Distance(const std::string& a, const std::string& b) {
+  std::vector<size_t> previous(b.size() + 1);
+  std::vector<size_t> current(b.size() + 1);
+  for (size_t j = 0; j <= b.size(); ++j) {
+    previous[j] = j;
+  }
+  for (size_t i = 1; i <= a.size(); ++i) {
+    current[0] = i;
+    for (size_t j = 1; j <= b.size(); ++j) {
+      size_t substitution = previous[j - 1] + (a[i - 1] != b[j - 1]);
+      size_t deletion = previous[j] + 1;
+      size_t insertion = current[j - 1] + 1;
+      current[j] = std::min(substitution, std::min(deletion, insertion));
+    }
+    previous.swap(current);
+  }
+  return previous[b.size()];
+}
+
+std::string Trim(const std::string& text) {
+  size_t first = text.find_first_not_of(' ');
+  size_t last = text.find_last_not_of(' ');
+  return first == std::string::npos ? std::string() : text.substr(first, last - first + 1);
+}
+
+struct Result {
+  double accuracy;
+  double seconds;
+};
+
+// Decodes `trace` `repeat` times. The accuracy is of the first pass, the time of all of them.
+Result Decode(const Trace& trace, int repeat) {
+  double seconds = 0;
+  std::string first;
+  for (int pass = 0; pass < repeat; ++pass) {
+    decoded.clear();
+    decoder::Decoder morse_decoder([](char letter) { decoded += letter; });
+
+    auto start = std::chrono::steady_clock::now();
+    for (const Edge& edge : trace.edges) {
+      morse_decoder.OnEdge(edge.time_us, edge.level);
+    }
+    morse_decoder.Poll(trace.end_us);
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (pass == 0) {
+      first = Trim(decoded);
+    }
+  }
+
+  size_t errors = Distance(trace.text, first);
+  double accuracy = errors >= trace.text.size() ? 0 : 1 - (double)errors / trace.text.size();
+  return {accuracy, seconds / repeat};
+}
+
+const char* Option(int argc, char** argv, const char* name) {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (strcmp(argv[i], name) == 0) {
+      return argv[i + 1];
+    }
+  }
+  return nullptr;
+}
+
+void PrintResult(const char* name, const Trace& trace, const Result& result) {
+  double real_seconds = trace.end_us / 1e6;
+  printf("%-10s %8.1f s  %6zu edges  %6.2f%% correct  %10.0fx real time\n", name, real_seconds,
+         trace.edges.size(), result.accuracy * 100,
+         result.seconds > 0 ? real_seconds / result.seconds : 0);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const char* repeat_option = Option(argc, argv, "--repeat");
+  const char* jitter_option = Option(argc, argv, "--jitter");
+  const char* seed_option = Option(argc, argv, "--seed");
+  int repeat = repeat_option != nullptr ? atoi(repeat_option) : 1000;
+  double jitter = (jitter_option != nullptr ? atof(jitter_option) : 10) / 100;
+  std::mt19937 random(seed_option != nullptr ? (uint32_t)atoi(seed_option) : 1);
+  if (repeat < 1 || jitter < 0 || jitter >= 0.5) {
+    fprintf(stderr, "usage: program [--repeat N] [--jitter PERCENT below 50] [--seed N]\n");
+    return 2;
+  }
+
+  printf("trace       keyed for     edges     accuracy           speed\n");
+  double worst = 1;
+  for (uint32_t wpm = decoder::MIN_WPM; wpm <= decoder::MAX_WPM; wpm += 5) {
+    Trace trace;
+    AppendWords(trace, TEXT, wpm, jitter, random);
+    Result result = Decode(trace, repeat);
+    worst = result.accuracy < worst ? result.accuracy : worst;
+
+    char name[16];
+    snprintf(name, sizeof(name), "%u WPM", (unsigned)wpm);
+    PrintResult(name, trace, result);
+  }
+
+  // A new speed every three words.
+  Trace jumping;
+  std::uniform_int_distribution<uint32_t> speeds(decoder::MIN_WPM, decoder::MAX_WPM);
+  std::string text = TEXT;
+  for (int round = 0; round < 4; ++round) {
+    size_t start = 0;
+    while (start < text.size()) {
+      size_t end = start;
+      for (int words = 0; words < 3 && end != std::string::npos; ++words) {
+        end = text.find(' ', end + 1);
+      }
+      end = end == std::string::npos ? text.size() : end;
+      AppendWords(jumping, text.substr(start, end - start), speeds(random), jitter, random);
+      start = end + 1;
+    }
+  }
+  Result result = Decode(jumping, repeat);
+  worst = result.accuracy < worst ? result.accuracy : worst;
+  PrintResult("jumping", jumping, result);
+
+  printf("worst accuracy %.2f%%\n", worst * 100);
+  return 0;
+}
@@ -0,0 +1,122 @@
+#ifndef INTAKE_H
+#define INTAKE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Fixed size storage for messages arriving over Serial. Nothing in here allocates: bytes are
+// assembled into lines in a static buffer and complete lines are copied into a bounded queue of
+// fixed length slots until their output channel is ready for them. Both report when they have to
+// drop input so that a full queue or an overlong line is never lost silently.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace intake {
+
+inline constexpr size_t MAX_MESSAGE_LENGTH = 64;
+// Per output channel.
+inline constexpr size_t MAX_QUEUED_MESSAGES = 4;
+
+// Bounded FIFO of messages, each stored in its own fixed size slot.
+template <size_t SLOTS, size_t LENGTH>
+class MessageQueue {
+ public:
+  // Copies `message` into the next free slot. Returns false if every slot is taken.
+  bool Push(const char* message) {
+    if (count_ == SLOTS) {
+      return false;
+    }
+
+    char* slot = slots_[(head_ + count_) % SLOTS];
+    strncpy(slot, message, LENGTH);
+    slot[LENGTH] = '\0';
+    ++count_;
+    return true;
+  }
+
+  // Oldest message in the queue. Only valid while the queue is not empty.
+  const char* Front() const {
+    return slots_[head_];
+  }
+
+  void Pop() {
+    if (count_ == 0) {
+      return;
+    }
+
+    head_ = (head_ + 1) % SLOTS;
+    --count_;
+  }
+
+  bool IsEmpty() const {
+    return count_ == 0;
+  }
+
+  bool IsFull() const {
+    return count_ == SLOTS;
+  }
+
+  size_t Size() const {
+    return count_;
+  }
+
+ private:
+  char slots_[SLOTS][LENGTH + 1];
+  size_t head_ = 0;
+  size_t count_ = 0;
+};
+
+enum class LineStatus {
+  INCOMPLETE,
+  COMPLETE,
+  TOO_LONG,
+};
+
+// Collects bytes into a line terminated by '\n' or '\r'. Surrounding whitespace is trimmed and
+// empty lines are ignored, so "\r\n" line endings produce a single line.
+template <size_t LENGTH>
+class LineAssembler {
+ public:
+  // Adds a byte. Returns COMPLETE once a line is available through Line(), which stays valid until
+  // the next call. Returns TOO_LONG once for a line that overflowed, which is then discarded.
+  LineStatus Add(char byte) {
+    if (byte != '\n' && byte != '\r') {
+      if (length_ == LENGTH) {
+        overflowed_ = true;
+      } else if (length_ != 0 || byte != ' ') {
+        line_[length_++] = byte;
+      }
+      return LineStatus::INCOMPLETE;
+    }
+
+    bool overflowed = overflowed_;
+    while (length_ != 0 && line_[length_ - 1] == ' ') {
+      --length_;
+    }
+    line_[length_] = '\0';
+
+    size_t length = length_;
+    length_ = 0;
+    overflowed_ = false;
+
+    if (overflowed) {
+      return LineStatus::TOO_LONG;
+    }
+
+    return length == 0 ? LineStatus::INCOMPLETE : LineStatus::COMPLETE;
+  }
+
+  const char* Line() const {
+    return line_;
+  }
+
+ private:
+  char line_[LENGTH + 1];
+  size_t length_ = 0;
+  bool overflowed_ = false;
+};
+
+} // intake
+
+#endif // INTAKE_H
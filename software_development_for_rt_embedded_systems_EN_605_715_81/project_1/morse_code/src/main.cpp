@@ -1,50 +1,276 @@
 #include <Arduino.h>
 
+#include "FspTimer.h"
+#include "decoder.h"
+#include "intake.h"
 #include "morse_code.h"
 #include "pulse.h"
+#include "ring_buffer.h"
+#include "sidetone.h"
 
 // Main entry point for pulsing a message in morse code
 //
-// IMPORTANT: Configure which pins you want to be activated in the int PULSE_PINS[] array
+// IMPORTANT: Configure the output channels in the CHANNELS[] array
 //
-// Multiple pins can be configured such that they are activated for each pulse in a letter. To
-// adjust the timing of ONE_UNIT to be longer or shorter, thus the timing of all other units, the
-// value can be updated in morse_code.h
+// Every channel is an independent morse code output with its own pin, its own unit length and its
+// own message queue. Messages are compiled into a timeline of edges and all channels are played
+// back by one pulse::Scheduler from a hardware timer ISR, so loop() keeps reading Serial while
+// messages are being transmitted. A line of the form "N:message" is sent on channel N, any other
+// line on channel 0.
+//
+// Serial input is drained without blocking into a fixed line buffer, and complete lines wait in
+// their channel's bounded message queue until the channel can take them. When a queue is full the
+// line is dropped and reported back over Serial instead of being lost silently. No String or other
+// heap allocation is involved on the way from Serial to the pins.
+//
+// ONE_UNITS in morse_code.h is the default unit length. Channels may run faster or slower.
+//
+// SIDETONE_CHANNEL is also played as an audio tone on the DAC pin (A0). A second timer ISR
+// produces one sample per tick from a precomputed sine table and gates it with the channel's
+// current level, shaping each dot and dash with a raised cosine ramp to avoid clicks.
+//
+// Morse code keyed on RECEIVE_PIN is decoded and printed to Serial. Every level change is
+// timestamped by an interrupt and handed to loop() through a ring buffer, where a
+// decoder::Decoder turns it into letters while tracking the sender's speed.
 namespace {
 
-using arduino::String;
+using intake::LineAssembler;
+using intake::LineStatus;
+using intake::MAX_MESSAGE_LENGTH;
+using intake::MAX_QUEUED_MESSAGES;
+using intake::MessageQueue;
 using morse::ONE_UNITS;
-using morse::THREE_UNITS;
-using morse::SEVEN_UNITS;
-using morse::TERMINATING_INT;
-using pulse::PulseWords;
+using pulse::Channel;
+using pulse::JitterStats;
+using pulse::MAX_CHANNELS;
+using pulse::Scheduler;
+using pulse::SubmitResult;
+using ring_buffer::RingBuffer;
+
+
+struct ChannelConfig {
+  int pin;
+  uint32_t unit_ms;
+};
+
+// Configure the pin and unit length of each morse code channel. At most MAX_CHANNELS.
+constexpr ChannelConfig CHANNELS[] = {
+    {3, ONE_UNITS},
+    {6, ONE_UNITS / 2},
+};
+constexpr size_t NUM_CHANNELS = sizeof(CHANNELS) / sizeof(ChannelConfig);
+static_assert(NUM_CHANNELS <= MAX_CHANNELS, "Too many morse code channels configured");
+
+// Channel played as a sidetone on the DAC, its pitch and the length of the key shaping ramps.
+constexpr size_t SIDETONE_CHANNEL = 0;
+constexpr uint32_t SIDETONE_HZ = 700;
+constexpr uint32_t SIDETONE_SAMPLE_RATE_HZ = 8000;
+constexpr size_t SIDETONE_RAMP_SAMPLES = SIDETONE_SAMPLE_RATE_HZ * 5 / 1000; // 5 milliseconds
+static_assert(SIDETONE_CHANNEL < NUM_CHANNELS, "Sidetone must follow a configured channel");
 
+// Pin that morse code is received on. HIGH is key down. Must be interrupt capable.
+constexpr int RECEIVE_PIN = 2;
 
-// Configure which pins should be pulsed for morse code
-// Array should always end with TERMINATING_INT
-constexpr int PULSE_PINS[] = {3, 6, TERMINATING_INT};
+struct ReceivedEdge {
+  uint32_t time_us;
+  bool level;
+};
 
-void ConfigurePinModes(const int* pins, int mode) {
-  int pin_index = 0;
-  while (pins[pin_index] != TERMINATING_INT) {
-    pinMode(pins[pin_index], mode);
-    ++pin_index;
+Scheduler scheduler;
+FspTimer pulse_timer;
+
+sidetone::Sidetone<SIDETONE_RAMP_SAMPLES> tone_generator(SIDETONE_SAMPLE_RATE_HZ, SIDETONE_HZ);
+FspTimer sidetone_timer;
+
+LineAssembler<MAX_MESSAGE_LENGTH> line_assembler;
+MessageQueue<MAX_QUEUED_MESSAGES, MAX_MESSAGE_LENGTH> message_queues[NUM_CHANNELS];
+
+RingBuffer<ReceivedEdge, 64> received_edges;
+uint32_t reported_dropped_edges = 0;
+decoder::Decoder morse_decoder([](char letter) {
+  Serial.print(letter);
+});
+
+void ConfigureChannels() {
+  for (const ChannelConfig& config : CHANNELS) {
+    pinMode(config.pin, OUTPUT);
+    if (scheduler.AddChannel(config.pin, config.unit_ms) == nullptr) {
+      Serial.print("Unable to configure channel on pin ");
+      Serial.println(config.pin);
+    }
   }
 }
 
+void timer_callback(timer_callback_args_t __attribute__((unused)) *p_args) {
+  scheduler.Tick();
+}
+
+// Writes straight to the DAC data register. analogWrite() has already configured the DAC.
+void sidetone_callback(timer_callback_args_t __attribute__((unused)) *p_args) {
+  tone_generator.Key(scheduler[SIDETONE_CHANNEL].IsHigh());
+  R_DAC->DADR[0] = tone_generator.NextSample();
+}
+
+void ReceiveEdgeIsrFunction() {
+  received_edges.Push({micros(), digitalRead(RECEIVE_PIN) == HIGH});
+}
+
+void DecodeReceivedEdges() {
+  ReceivedEdge edge;
+  while (received_edges.Pop(edge)) {
+    morse_decoder.OnEdge(edge.time_us, edge.level);
+  }
+  morse_decoder.Poll(micros());
+
+  uint32_t dropped = received_edges.Dropped();
+  if (dropped != reported_dropped_edges) {
+    reported_dropped_edges = dropped;
+    Serial.print("\nReceive buffer overflowed, edges dropped so far: ");
+    Serial.println(dropped);
+  }
+}
+
+bool BeginTimer(FspTimer& timer, float rate_hz, void (*callback)(timer_callback_args_t*)) {
+  uint8_t timer_type = GPT_TIMER;
+  int8_t tindex = FspTimer::get_available_timer(timer_type, true);
+
+  if (tindex < 0) {
+    return false;
+  }
+
+  if (!timer.begin(TIMER_MODE_PERIODIC, timer_type, tindex, rate_hz, 0.0f, callback)) {
+    Serial.println("begin() failed");
+    return false;
+  }
+
+  if (!timer.setup_overflow_irq() || !timer.open() || !timer.start()) {
+    Serial.println("failed to start timer");
+    return false;
+  }
+
+  return true;
+}
+
+// Splits an optional "N:" channel prefix off a line. Returns the channel, or -1 if N is not a
+// configured channel.
+int ParseChannel(const char*& line) {
+  if (line[0] < '0' || line[0] > '9' || line[1] != ':') {
+    return 0;
+  }
+
+  size_t channel = line[0] - '0';
+  line += 2;
+  return channel < scheduler.Count() ? (int)channel : -1;
+}
+
+// Moves whatever bytes the UART driver has buffered into complete lines on the message queues.
+// Never waits for more input to arrive.
+void ReadSerialMessages() {
+  while (Serial.available()) {
+    LineStatus status = line_assembler.Add((char)Serial.read());
+
+    if (status == LineStatus::TOO_LONG) {
+      Serial.print("Message longer than ");
+      Serial.print(MAX_MESSAGE_LENGTH);
+      Serial.println(" characters. Dropped");
+      continue;
+    }
+
+    if (status != LineStatus::COMPLETE) {
+      continue;
+    }
+
+    const char* message = line_assembler.Line();
+    int channel = ParseChannel(message);
+    if (channel < 0) {
+      Serial.print("No such channel, message dropped: ");
+      Serial.println(line_assembler.Line());
+      continue;
+    }
+
+    if (!message_queues[channel].Push(message)) {
+      Serial.print("Queue full on channel ");
+      Serial.print(channel);
+      Serial.print(", message dropped: ");
+      Serial.println(message);
+    }
+  }
+}
+
+// Hands the oldest queued message of a channel to it once the channel is idle.
+void SubmitQueuedMessage(size_t channel) {
+  MessageQueue<MAX_QUEUED_MESSAGES, MAX_MESSAGE_LENGTH>& queue = message_queues[channel];
+  if (queue.IsEmpty()) {
+    return;
+  }
+
+  const char* message = queue.Front();
+  switch (scheduler[channel].Submit(message)) {
+    case SubmitResult::BUSY:
+      return;
+    case SubmitResult::TOO_LONG:
+      Serial.print("Message too long to compile. Dropped: ");
+      Serial.println(message);
+      break;
+    case SubmitResult::EMPTY:
+      Serial.print("Nothing to transmit in: ");
+      Serial.println(message);
+      break;
+    default:
+      break;
+  }
+
+  queue.Pop();
+}
+
+void PrintJitter(size_t channel, const JitterStats& stats) {
+  Serial.print("Channel ");
+  Serial.print(channel);
+  Serial.print(" finished message. Edge jitter over ");
+  Serial.print(stats.edges);
+  Serial.print(" edges: max ");
+  Serial.print(stats.max_error_us);
+  Serial.print(" us, mean ");
+  Serial.print(stats.edges ? stats.total_error_us / stats.edges : 0);
+  Serial.print(" us. Longest scheduler tick ");
+  Serial.print(scheduler.MaxTickMicros());
+  Serial.println(" us");
+}
+
 } // namespace
 
 void setup()
 {
-  ConfigurePinModes(PULSE_PINS, OUTPUT);
-  Serial.begin(9600);
+  pinMode(RECEIVE_PIN, INPUT);
+  Serial.begin(115200);
+
+  ConfigureChannels();
+
+  if (!BeginTimer(pulse_timer, pulse::TICK_HZ, timer_callback)) {
+    Serial.println("Timer failed to start");
+  }
+
+  analogWriteResolution(sidetone::DAC_BITS);
+  analogWrite(DAC, sidetone::DAC_MIDSCALE);
+  if (!BeginTimer(sidetone_timer, SIDETONE_SAMPLE_RATE_HZ, sidetone_callback)) {
+    Serial.println("Sidetone timer failed to start");
+  }
+
+  attachInterrupt(digitalPinToInterrupt(RECEIVE_PIN), ReceiveEdgeIsrFunction, CHANGE);
 }
 
 void loop()
 {
-  if (Serial.available()) {
-    String msg_to_encode(Serial.readStringUntil('\n'));
-    msg_to_encode.trim();
-    PulseWords(msg_to_encode, PULSE_PINS);
+  ReadSerialMessages();
+
+  for (size_t channel = 0; channel < scheduler.Count(); ++channel) {
+    SubmitQueuedMessage(channel);
+
+    JitterStats stats;
+    if (scheduler[channel].TakeFinished(stats)) {
+      PrintJitter(channel, stats);
+    }
   }
-}
\ No newline at end of file
+
+  DecodeReceivedEdges();
+}
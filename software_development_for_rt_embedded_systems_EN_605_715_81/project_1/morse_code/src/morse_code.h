@@ -1,27 +1,25 @@
 #ifndef MORSE_CODE_H
 #define MORSE_CODE_H
 
-// This file contains the mapping of letter to morse code pulses. 
-//
-// IMPORTANT: Only the character set [A-Za-z0-9]+ is supported
-//
-// Each character is mapped to an index position in the array `int* MORSE_CODES[]` by its ASCII
-// value. The values 0-9 are queued first in the array, followed by A-Z. E.g "0" is at index
-// position 0 of the array MORSE_CODES[] and "A" is at index 10.
+#include <stdint.h>
+
+// This file contains the mapping of letter to morse code pulses.
 //
-// String numbers are converted to their index values by subtracing 48 from their ASCII Ordinal
-// value. This is because "0" - "9" are 48 - 57 respecitvely. E.g. "5" ASCII integer value is 53;
-// 53 - 48 = 5;
+// Every character is packed into a single byte. Bit i holds element i of the character (0 for a
+// dot, 1 for a dash) and a sentinel 1 bit sits just above the last element, so the position of
+// the highest set bit is the number of elements. E.g. "A" (.-) is 0b110 and "B" (-...) is 0b10001.
+// A byte of 0 means the character has no morse code mapping.
 //
-// Capital letters are converted to their index values by subtracting 55 from their ASCII Ordinal
-// value. This is because A-Z are 65 - 90 respecitvely. Because "0" - "9" consume the first 9
-// indicies in the array, this means A must start at index position 10. E.g. A ASCII integer values
-// is 65; 65 - 55 = 10.
+// MORSE_CODES is indexed directly by the character's unsigned ASCII value, so looking up a
+// character is a single table access without any range checks. The table is generated at compile
+// time from ITU_MAPPINGS below. Lower case letters share the code of their upper case letter.
 //
-// Lower case letter are first converted to upper case letters by subtracting 32 from their ASCII
-// Ordinal value. E.g. "a" is 97; 97 - 32 = 65 = A. Then the above logic follows.
+// Besides letters and digits the table covers the ITU-R M.1677 punctuation, a few widely used
+// non-ITU signs and the ITU prosigns. Prosigns have no printable character so they are mapped to
+// the ASCII control character closest in meaning (e.g. EOT for "end of work"). The ITU error
+// signal is eight dots, which needs nine bits and therefore is not in the table; send "HH" instead.
 //
-// See ascii_helpers.h for Atoi conversions as discussed here.
+// Durations are not stored per element. A dot lasts ONE_UNITS and a dash lasts THREE_UNITS.
 
 namespace morse {
 
@@ -30,49 +28,96 @@ inline constexpr int THREE_UNITS = ONE_UNITS * 3;
 inline constexpr int SEVEN_UNITS = ONE_UNITS * 7;
 inline constexpr int TERMINATING_INT = 999;
 
-inline constexpr int zero[] = {THREE_UNITS, THREE_UNITS, THREE_UNITS, THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int one[] = {ONE_UNITS, THREE_UNITS, THREE_UNITS, THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int two[] = {ONE_UNITS, ONE_UNITS, THREE_UNITS, THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int three[] = {ONE_UNITS, ONE_UNITS, ONE_UNITS, THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int four[] = {ONE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int five[] = {ONE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int six[] = {THREE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int seven[] = {THREE_UNITS, THREE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int eight[] = {THREE_UNITS, THREE_UNITS, THREE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int nine[] = {THREE_UNITS, THREE_UNITS, THREE_UNITS, THREE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int A[] = {ONE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int B[] = {THREE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int C[] = {THREE_UNITS, ONE_UNITS, THREE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int D[] = {THREE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int E[] = {ONE_UNITS, TERMINATING_INT};
-inline constexpr int F[] = {ONE_UNITS, ONE_UNITS, THREE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int G[] = {THREE_UNITS, THREE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int H[] = {ONE_UNITS, ONE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int I[] = {ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int J[] = {ONE_UNITS ,THREE_UNITS , THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int K[] = {THREE_UNITS, ONE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int L[] = {ONE_UNITS, THREE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int M[] = {THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int N[] = {THREE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int O[] = {THREE_UNITS, THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int P[] = {ONE_UNITS, THREE_UNITS, THREE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int Q[] = {THREE_UNITS, THREE_UNITS, ONE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int R[] = {ONE_UNITS, THREE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int S[] = {ONE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-inline constexpr int T[] = {THREE_UNITS, TERMINATING_INT};
-inline constexpr int U[] = {ONE_UNITS, ONE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int V[] = {ONE_UNITS, ONE_UNITS, ONE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int W[] = {ONE_UNITS, THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int X[] = {THREE_UNITS, ONE_UNITS, ONE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int Y[] = {THREE_UNITS, ONE_UNITS, THREE_UNITS, THREE_UNITS, TERMINATING_INT};
-inline constexpr int Z[] = {THREE_UNITS, THREE_UNITS, ONE_UNITS, ONE_UNITS, TERMINATING_INT};
-
-
-inline constexpr const int* MORSE_CODES[] = {
-    zero, one, two, three, four, five, six, seven, eight, nine, A, B, C, D, E, F, G, H, I, J, K, L,
-    M, N, O, P, Q, R, S, T, U, V, W, X, Y, Z
+// Control characters standing in for the ITU prosigns.
+inline constexpr char PROSIGN_STARTING_SIGNAL = '\x02'; // STX, -.-.-
+inline constexpr char PROSIGN_END_OF_MESSAGE = '\x03';  // ETX, .-.-.
+inline constexpr char PROSIGN_END_OF_WORK = '\x04';     // EOT, ...-.-
+inline constexpr char PROSIGN_INVITATION = '\x05';      // ENQ, -.-
+inline constexpr char PROSIGN_UNDERSTOOD = '\x06';      // ACK, ...-.
+inline constexpr char PROSIGN_WAIT = '\x13';            // DC3, .-...
+
+namespace internal {
+
+struct Mapping {
+  char letter;
+  const char* pattern;
+};
+
+inline constexpr Mapping ITU_MAPPINGS[] = {
+    {'A', ".-"}, {'B', "-..."}, {'C', "-.-."}, {'D', "-.."}, {'E', "."}, {'F', "..-."},
+    {'G', "--."}, {'H', "...."}, {'I', ".."}, {'J', ".---"}, {'K', "-.-"}, {'L', ".-.."},
+    {'M', "--"}, {'N', "-."}, {'O', "---"}, {'P', ".--."}, {'Q', "--.-"}, {'R', ".-."},
+    {'S', "..."}, {'T', "-"}, {'U', "..-"}, {'V', "...-"}, {'W', ".--"}, {'X', "-..-"},
+    {'Y', "-.--"}, {'Z', "--.."},
+    {'0', "-----"}, {'1', ".----"}, {'2', "..---"}, {'3', "...--"}, {'4', "....-"},
+    {'5', "....."}, {'6', "-...."}, {'7', "--..."}, {'8', "---.."}, {'9', "----."},
+    {'.', ".-.-.-"}, {',', "--..--"}, {':', "---..."}, {'?', "..--.."}, {'\'', ".----."},
+    {'-', "-....-"}, {'/', "-..-."}, {'(', "-.--."}, {')', "-.--.-"}, {'"', ".-..-."},
+    {'=', "-...-"}, {'+', ".-.-."}, {'@', ".--.-."},
+    // Not part of ITU-R M.1677 but in common use.
+    {'!', "-.-.--"}, {'&', ".-..."}, {';', "-.-.-."}, {'_', "..--.-"}, {'$', "...-..-"},
+    {PROSIGN_STARTING_SIGNAL, "-.-.-"}, {PROSIGN_END_OF_MESSAGE, ".-.-."},
+    {PROSIGN_END_OF_WORK, "...-.-"}, {PROSIGN_INVITATION, "-.-"},
+    {PROSIGN_UNDERSTOOD, "...-."}, {PROSIGN_WAIT, ".-..."},
+};
+
+constexpr uint8_t Encode(const char* pattern) {
+  uint8_t code = 0;
+  int length = 0;
+  for (; pattern[length] != '\0'; ++length) {
+    if (pattern[length] == '-') {
+      code |= 1 << length;
+    }
+  }
+
+  return code | (1 << length);
+}
+
+struct CodeTable {
+  uint8_t codes[256];
+
+  constexpr uint8_t operator[](char letter) const {
+    return codes[static_cast<uint8_t>(letter)];
+  }
 };
 
+constexpr CodeTable BuildCodeTable() {
+  CodeTable table{};
+  for (const Mapping& mapping : ITU_MAPPINGS) {
+    uint8_t code = Encode(mapping.pattern);
+    table.codes[static_cast<uint8_t>(mapping.letter)] = code;
+    if (mapping.letter >= 'A' && mapping.letter <= 'Z') {
+      table.codes[static_cast<uint8_t>(mapping.letter - 'A' + 'a')] = code;
+    }
+  }
+
+  return table;
+}
+
+} // internal
+
+inline constexpr internal::CodeTable MORSE_CODES = internal::BuildCodeTable();
+static_assert(sizeof(MORSE_CODES) == 256, "MORSE_CODES must stay one byte per ASCII value");
+
+// Number of dots and dashes in a packed code. The code must not be 0.
+constexpr int CodeLength(uint8_t code) {
+  return 31 - __builtin_clz(code);
+}
+
+// Whether element `index` of a packed code is a dash.
+constexpr bool IsDash(uint8_t code, int index) {
+  return (code >> index) & 1;
+}
+
+// How long element `index` of a packed code stays on, in milliseconds.
+constexpr int ElementDuration(uint8_t code, int index) {
+  return IsDash(code, index) ? THREE_UNITS : ONE_UNITS;
+}
+
+static_assert(MORSE_CODES['A'] == 0b110 && MORSE_CODES['b'] == 0b10001, "Unexpected packing");
+static_assert(CodeLength(MORSE_CODES['$']) == 7, "Longest code must fit in a byte");
+static_assert(MORSE_CODES['#'] == 0, "Unmapped characters must be 0");
+
 } // morse
 
-#endif MORSE_CODE_H
\ No newline at end of file
+#endif MORSE_CODE_H
@@ -0,0 +1,53 @@
+#ifndef PORT_OUTPUT_H
+#define PORT_OUTPUT_H
+
+#include <Arduino.h>
+
+#include "morse_code.h"
+
+// Drives a group of output pins with a single register write. Every RA4M1 I/O port has a PCNTR3
+// register whose low half sets and whose high half clears output bits, so one store switches all
+// pins of the group at the same instant instead of one digitalWrite per pin.
+
+namespace port_output {
+
+struct PortPins {
+  R_PORT0_Type* port = nullptr;
+  uint16_t mask = 0;
+};
+
+// Resolves an array of Arduino pin numbers into their I/O port and bit mask. The array is expected
+// to have the sentinel TERMINATING_INT. All pins have to be on the same port, returns false
+// otherwise or if the array is empty.
+inline bool Resolve(const int* pins, PortPins& resolved) {
+  resolved = PortPins();
+
+  int i = 0;
+  while (pins[i] != morse::TERMINATING_INT) {
+    R_PORT0_Type* port = (R_PORT0_Type*)IOPORT_PRV_PORT_ADDRESS(digitalPinToPort(pins[i]));
+    if (resolved.port != nullptr && resolved.port != port) {
+      return false;
+    }
+
+    resolved.port = port;
+    resolved.mask |= digitalPinToBitMask(pins[i]);
+    i++;
+  }
+
+  return resolved.port != nullptr;
+}
+
+// Drives the `set` bits of a port high and the `clear` bits low in one write, without reading the
+// port back. Safe to call from an ISR.
+inline void WriteBits(R_PORT0_Type* port, uint16_t set, uint16_t clear) {
+  port->PCNTR3 = ((uint32_t)clear << 16) | set;
+}
+
+// Drives the pins in `high_mask` high and every other pin of the group low.
+inline void Write(const PortPins& pins, uint16_t high_mask) {
+  WriteBits(pins.port, pins.mask & high_mask, pins.mask & ~high_mask);
+}
+
+} // port_output
+
+#endif // PORT_OUTPUT_H
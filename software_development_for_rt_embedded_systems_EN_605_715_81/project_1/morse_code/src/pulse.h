@@ -1,73 +1,261 @@
 #ifndef PULSE_H
 #define PULSE_H
 
-#include "ascii_helpers.h"
 #include "morse_code.h"
+#include "port_output.h"
+#include "timeline.h"
 
 namespace pulse {
-namespace {
-
-using morse::ONE_UNITS;
-using morse::THREE_UNITS;
-using morse::SEVEN_UNITS;
-using morse::TERMINATING_INT;
-
-} // namespace
-
-// Iterates through an array of pins and writes the value to them. The array is expected to have
-// the sentinel TERMINATING_INT to determine when to stop iterating and writing.
-void WritePins(const int* pins, int value) {
-  int i = 0;
-  while (pins[i] != TERMINATING_INT) {
-    digitalWrite(pins[i], value);
-    i++;
+
+// Rate of the hardware timer driving Scheduler::Tick(). Edges land on tick boundaries, so this is
+// the resolution of the generated timing.
+inline constexpr uint32_t TICK_HZ = 1000;
+
+inline constexpr size_t MAX_CHANNELS = 8;
+
+// Deviation of each applied edge from the time it should have been applied at, measured against
+// micros(). Collected per message and handed to loop() when the message finishes.
+struct JitterStats {
+  unsigned long edges = 0;
+  unsigned long max_error_us = 0;
+  unsigned long total_error_us = 0;
+};
+
+enum class SubmitResult {
+  ACCEPTED,
+  BUSY,
+  EMPTY,
+  TOO_LONG,
+};
+
+// One independent morse code output: its own pin, its own unit length and its own timeline. A
+// message is compiled into the timeline in loop() and then played back one tick at a time by the
+// Scheduler from the timer ISR. A channel takes the next message once the current one, including
+// its trailing word gap, has finished.
+class Channel {
+ public:
+  // Resolves the output pin and sets how many milliseconds one unit lasts on this channel.
+  bool Begin(int pin, uint32_t unit_ms) {
+    const int pins[] = {pin, morse::TERMINATING_INT};
+    ticks_per_unit_ = unit_ms * TICK_HZ / 1000;
+    micros_per_unit_ = unit_ms * 1000;
+    return port_output::Resolve(pins, pins_);
   }
-}
-
-// Iterates through an array of pulses for a letter. Ensures each configured pin is activated for
-// the appropriate pulse length before deactivating. Respects the morse code rules of ONE_UNIT of
-// pause between consecutive pulses for the letter.
-void PulseLetters(const int* letter_pulses, const int* pins) {
-  int i = 0;
-  while (letter_pulses[i] != TERMINATING_INT) {
-    int pulse_length = letter_pulses[i];
-
-    Serial.print("Pulse for ");
-    Serial.println(pulse_length);
-    WritePins(pins, HIGH);
-    delay(pulse_length);
-    WritePins(pins, LOW);
-
-    // If this is the last pulse for the letter, we don't want to add an extra ONE_UNIT delay
-    // to the delay between two letters. Conversely we don't want to add an extra ONE_UNIT delay
-    // between words if this is the last letter in a word.
-    if (letter_pulses[i + 1] != TERMINATING_INT) {
-      delay(ONE_UNITS);
+
+  // Compiles a message into the channel's timeline. Called from loop() only.
+  SubmitResult Submit(const char* message) {
+    if (!IsIdle()) {
+      return SubmitResult::BUSY;
+    }
+
+    // The ISR does not look at the timeline until ready_ is set, so it is safe to write.
+    if (!timeline::Compile(message, timeline_)) {
+      return SubmitResult::TOO_LONG;
     }
-    i++;
+
+    if (timeline_.length == 0) {
+      return SubmitResult::EMPTY;
+    }
+
+    ready_ = true;
+    return SubmitResult::ACCEPTED;
+  }
+
+  bool IsIdle() const {
+    return !playing_ && !ready_;
   }
-  Serial.println("Finished with letter");
-}
-
-// Iterates through an array of characters that make up words in a sentence. Pulse each character in
-// a word. Applies the morse code rules of THREE_UNITs of pause between each letter that makes
-// up a word. Also applies the rule of SEVEN_UNITS between each word. The start of a new word is
-// identified as the first char seen AFTER a ' ' character.
-void PulseWords(String words, const int* pins) {
-  char word_separator = ' ';
-  for (const auto& letter : words) {
-    Serial.print("Letter ");
-    Serial.println(letter);
-    if (word_separator == letter) {
-      delay(SEVEN_UNITS);
-      continue;
+
+  // Copies the jitter statistics of the last finished message into `stats`. Returns false if no
+  // message finished since the last call. Called from loop() only.
+  bool TakeFinished(JitterStats& stats) {
+    noInterrupts();
+    bool finished = finished_;
+    if (finished) {
+      stats = finished_jitter_;
+      finished_ = false;
     }
+    interrupts();
+
+    return finished;
+  }
 
-    const int* letter_pulses = morse::MORSE_CODES[ascii::AsciiToIndex(letter)];
-    PulseLetters(letter_pulses, pins);
-    delay(THREE_UNITS);
+  const port_output::PortPins& Pins() const {
+    return pins_;
   }
-}
+
+  // Whether the channel's pins are currently driven high, i.e. a dot or dash is being sent.
+  bool IsHigh() const {
+    return high_;
+  }
+
+  // Advances playback by one tick. Returns true if the channel's pins switch on this tick, with
+  // `high` set to their new level. Called from the timer ISR only.
+  bool Advance(bool& high) {
+    if (playing_) {
+      if (--remaining_ticks_ != 0) {
+        return false;
+      }
+
+      if (++edge_index_ == timeline_.length) {
+        playing_ = false;
+        finished_jitter_ = jitter_;
+        finished_ = true;
+        return false;
+      }
+    } else {
+      if (!ready_) {
+        return false;
+      }
+
+      ready_ = false;
+      playing_ = true;
+      edge_index_ = 0;
+      starting_ = true;
+    }
+
+    const timeline::Edge& edge = timeline_.edges[edge_index_];
+    high = edge.mark;
+    high_ = high;
+    remaining_ticks_ = edge.units * ticks_per_unit_;
+    return true;
+  }
+
+  // Records when the edge returned by the last Advance() was written to the port. Called from the
+  // timer ISR only.
+  void RecordEdge(unsigned long now_us) {
+    if (starting_) {
+      starting_ = false;
+      jitter_ = JitterStats();
+      expected_us_ = now_us;
+    }
+
+    long error_us = (long)(now_us - expected_us_);
+    if (error_us < 0) {
+      error_us = -error_us;
+    }
+
+    ++jitter_.edges;
+    jitter_.total_error_us += error_us;
+    if ((unsigned long)error_us > jitter_.max_error_us) {
+      jitter_.max_error_us = error_us;
+    }
+
+    expected_us_ += timeline_.edges[edge_index_].units * micros_per_unit_;
+  }
+
+ private:
+  port_output::PortPins pins_;
+  uint32_t ticks_per_unit_ = 0;
+  uint32_t micros_per_unit_ = 0;
+  timeline::Timeline timeline_;
+
+  volatile bool ready_ = false;
+  volatile bool playing_ = false;
+  volatile bool finished_ = false;
+  volatile bool high_ = false;
+
+  // Only touched from the ISR.
+  size_t edge_index_ = 0;
+  uint32_t remaining_ticks_ = 0;
+  bool starting_ = false;
+  unsigned long expected_us_ = 0;
+  JitterStats jitter_;
+
+  JitterStats finished_jitter_;
+};
+
+// Multiplexes up to MAX_CHANNELS channels on a single timer. Every tick each channel is advanced,
+// the pin changes of all channels sharing an I/O port are merged, and each affected port is written
+// once. Channels that switch on the same tick therefore switch at the same instant, and the error
+// of any edge is bounded by the time one tick takes. That time is tracked so it can be reported.
+class Scheduler {
+ public:
+  // Adds a channel on `pin` with a unit of `unit_ms`. Returns the channel, or nullptr if there is
+  // no room left or the pin cannot be resolved.
+  Channel* AddChannel(int pin, uint32_t unit_ms) {
+    if (count_ == MAX_CHANNELS || !channels_[count_].Begin(pin, unit_ms)) {
+      return nullptr;
+    }
+
+    return &channels_[count_++];
+  }
+
+  size_t Count() const {
+    return count_;
+  }
+
+  Channel& operator[](size_t index) {
+    return channels_[index];
+  }
+
+  // Longest time a single tick took so far, in microseconds.
+  unsigned long MaxTickMicros() const {
+    return max_tick_us_;
+  }
+
+  // Advances every channel by one tick. Must be called from the timer ISR only.
+  void Tick() {
+    unsigned long start_us = micros();
+
+    PortWrite writes[MAX_CHANNELS];
+    size_t write_count = 0;
+    Channel* switched[MAX_CHANNELS];
+    size_t switched_count = 0;
+
+    for (size_t i = 0; i < count_; ++i) {
+      bool high;
+      if (!channels_[i].Advance(high)) {
+        continue;
+      }
+
+      const port_output::PortPins& pins = channels_[i].Pins();
+      PortWrite& write = FindWrite(writes, write_count, pins.port);
+      if (high) {
+        write.set |= pins.mask;
+      } else {
+        write.clear |= pins.mask;
+      }
+      switched[switched_count++] = &channels_[i];
+    }
+
+    for (size_t i = 0; i < write_count; ++i) {
+      port_output::WriteBits(writes[i].port, writes[i].set, writes[i].clear);
+    }
+
+    unsigned long written_us = micros();
+    for (size_t i = 0; i < switched_count; ++i) {
+      switched[i]->RecordEdge(written_us);
+    }
+
+    unsigned long tick_us = micros() - start_us;
+    if (tick_us > max_tick_us_) {
+      max_tick_us_ = tick_us;
+    }
+  }
+
+ private:
+  struct PortWrite {
+    R_PORT0_Type* port;
+    uint16_t set;
+    uint16_t clear;
+  };
+
+  static PortWrite& FindWrite(PortWrite* writes, size_t& count, R_PORT0_Type* port) {
+    for (size_t i = 0; i < count; ++i) {
+      if (writes[i].port == port) {
+        return writes[i];
+      }
+    }
+
+    writes[count] = {port, 0, 0};
+    return writes[count++];
+  }
+
+  Channel channels_[MAX_CHANNELS];
+  size_t count_ = 0;
+  volatile unsigned long max_tick_us_ = 0;
+};
+
 } // pulse
 
-#endif PULSE_H
\ No newline at end of file
+#endif PULSE_H
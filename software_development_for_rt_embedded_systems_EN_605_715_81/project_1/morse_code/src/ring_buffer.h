@@ -0,0 +1,63 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ring_buffer {
+
+// Fixed capacity single-producer / single-consumer queue. One side (typically an ISR) only calls
+// Push() and the other side (typically loop()) only calls Pop(), so no interrupts have to be
+// disabled. The indices run freely and are masked on access, which is why N has to be a power of
+// two. A full buffer rejects new items and counts them in Dropped() instead of overwriting.
+template <typename T, size_t N>
+class RingBuffer {
+  static_assert(N != 0 && (N & (N - 1)) == 0, "RingBuffer capacity must be a power of two");
+
+ public:
+  bool Push(const T& item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == N) {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    items_[head & (N - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(T& item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = items_[tail & (N - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t Size() const {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  bool IsEmpty() const {
+    return Size() == 0;
+  }
+
+  uint32_t Dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  T items_[N];
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+} // ring_buffer
+
+#endif // RING_BUFFER_H
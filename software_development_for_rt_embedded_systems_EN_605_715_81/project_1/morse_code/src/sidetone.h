@@ -0,0 +1,150 @@
+#ifndef SIDETONE_H
+#define SIDETONE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Audio sidetone for the morse code output. A sine wave is read from a table generated at compile
+// time through a phase accumulator, and every element is shaped with a raised cosine envelope so
+// the tone fades in and out instead of clicking on and off.
+//
+// The generator only produces samples. Keying comes from whatever drives Key(), and the samples go
+// wherever NextSample()'s caller puts them, which is the DAC on the board and a plain buffer on the
+// host. Samples are unsigned DAC_BITS values centered on DAC_MIDSCALE.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace sidetone {
+
+inline constexpr int DAC_BITS = 12;
+inline constexpr int32_t DAC_MIDSCALE = 1 << (DAC_BITS - 1);
+// Peak deviation from DAC_MIDSCALE at full envelope. Leaves headroom below full scale.
+inline constexpr int32_t AMPLITUDE = DAC_MIDSCALE * 3 / 4;
+
+inline constexpr size_t SINE_TABLE_BITS = 8;
+inline constexpr size_t SINE_TABLE_SIZE = 1 << SINE_TABLE_BITS;
+inline constexpr int32_t ENVELOPE_MAX = 1 << 15;
+
+namespace internal {
+
+inline constexpr double PI = 3.14159265358979323846;
+
+// Taylor series of sin around 0, accurate to well below one 16 bit step after folding x into
+// [-pi/2, pi/2]. std::sin is not usable in a constant expression.
+constexpr double Sin(double x) {
+  while (x > PI) {
+    x -= 2 * PI;
+  }
+  while (x < -PI) {
+    x += 2 * PI;
+  }
+  if (x > PI / 2) {
+    x = PI - x;
+  } else if (x < -PI / 2) {
+    x = -PI - x;
+  }
+
+  double term = x;
+  double sum = x;
+  for (int n = 1; n < 10; ++n) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+
+  return sum;
+}
+
+struct SineTable {
+  int16_t values[SINE_TABLE_SIZE];
+};
+
+// One full period of sin scaled to AMPLITUDE.
+constexpr SineTable BuildSineTable() {
+  SineTable table{};
+  for (size_t i = 0; i < SINE_TABLE_SIZE; ++i) {
+    double value = Sin(2 * PI * i / SINE_TABLE_SIZE) * AMPLITUDE;
+    table.values[i] = (int16_t)(value < 0 ? value - 0.5 : value + 0.5);
+  }
+
+  return table;
+}
+
+template <size_t N>
+struct RampTable {
+  int32_t values[N + 1];
+};
+
+// Rising half of a raised cosine, (1 - cos(pi * i / N)) / 2, scaled to ENVELOPE_MAX.
+template <size_t N>
+constexpr RampTable<N> BuildRampTable() {
+  RampTable<N> table{};
+  for (size_t i = 0; i <= N; ++i) {
+    double value = (1 - Sin(PI * i / N + PI / 2)) / 2 * ENVELOPE_MAX;
+    table.values[i] = (int32_t)(value + 0.5);
+  }
+
+  return table;
+}
+
+} // internal
+
+inline constexpr internal::SineTable SINE_TABLE = internal::BuildSineTable();
+
+// Tone generator with a raised cosine attack and release of RAMP_SAMPLES samples each.
+template <size_t RAMP_SAMPLES>
+class Sidetone {
+ public:
+  Sidetone(uint32_t sample_rate_hz, uint32_t tone_hz)
+      : phase_step_((uint32_t)(((uint64_t)tone_hz << 32) / sample_rate_hz)) {}
+
+  // Keys the tone on or off. The envelope ramps towards the new state from wherever it currently
+  // is, so keying mid-ramp does not jump.
+  void Key(bool down) {
+    key_down_ = down;
+  }
+
+  // Produces the next sample. Meant to be called at the sample rate, typically from a timer ISR.
+  uint16_t NextSample() {
+    if (key_down_) {
+      if (ramp_position_ < RAMP_SAMPLES) {
+        ++ramp_position_;
+      }
+    } else if (ramp_position_ > 0) {
+      --ramp_position_;
+    }
+
+    if (ramp_position_ == 0) {
+      // Restart every element at phase 0 so that they all sound alike.
+      phase_ = 0;
+      return DAC_MIDSCALE;
+    }
+
+    int32_t sine = SINE_TABLE.values[phase_ >> (32 - SINE_TABLE_BITS)];
+    phase_ += phase_step_;
+    return (uint16_t)(DAC_MIDSCALE + sine * RAMP.values[ramp_position_] / ENVELOPE_MAX);
+  }
+
+  // Fills `samples` with the next `count` samples.
+  void Render(uint16_t* samples, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+      samples[i] = NextSample();
+    }
+  }
+
+  bool IsSilent() const {
+    return ramp_position_ == 0;
+  }
+
+ private:
+  static constexpr internal::RampTable<RAMP_SAMPLES> RAMP =
+      internal::BuildRampTable<RAMP_SAMPLES>();
+
+  uint32_t phase_step_;
+  uint32_t phase_ = 0;
+  size_t ramp_position_ = 0;
+  volatile bool key_down_ = false;
+};
+
+} // sidetone
+
+#endif // SIDETONE_H
@@ -0,0 +1,118 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "morse_code.h"
+
+// Compiles a whole message into a flat array of edges ahead of time, so playback only has to walk
+// the array. Each edge says whether the channel's pins are high (a mark) or low (a gap) and for how
+// many units that level is held. The port mask itself belongs to the channel playing the timeline,
+// which keeps an edge at a single byte so that every channel can hold a full length message.
+//
+// The spacing follows the standard morse code rules: ONE_UNIT between the elements of a letter,
+// THREE_UNITS between letters and SEVEN_UNITS between words. Every timeline ends with a SEVEN_UNITS
+// gap so that back to back messages are always separated by a word gap.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace timeline {
+
+inline constexpr uint16_t DOT_UNITS = 1;
+inline constexpr uint16_t DASH_UNITS = 3;
+inline constexpr uint16_t ELEMENT_GAP_UNITS = 1;
+inline constexpr uint16_t LETTER_GAP_UNITS = 3;
+inline constexpr uint16_t WORD_GAP_UNITS = 7;
+
+// Enough for the longest message the serial intake accepts, even if every letter is seven elements.
+inline constexpr size_t MAX_EDGES = 1024;
+
+struct Edge {
+  uint8_t units : 7;
+  uint8_t mark : 1;
+};
+static_assert(sizeof(Edge) == 1, "Edges are expected to pack into a single byte");
+
+struct Timeline {
+  Edge edges[MAX_EDGES];
+  size_t length = 0;
+};
+
+namespace internal {
+
+inline bool Append(Timeline& timeline, bool mark, uint16_t units) {
+  if (timeline.length == MAX_EDGES) {
+    return false;
+  }
+
+  timeline.edges[timeline.length++] = {(uint8_t)units, mark};
+  return true;
+}
+
+} // internal
+
+// Compiles `message` into `timeline`. Characters without a morse code mapping are skipped. Returns
+// false if the message does not fit in MAX_EDGES, in which case the timeline is left empty.
+inline bool Compile(const char* message, Timeline& timeline) {
+  timeline.length = 0;
+  uint16_t pending_gap = 0;
+
+  for (const char* letter = message; *letter != '\0'; ++letter) {
+    if (*letter == ' ') {
+      pending_gap = timeline.length ? WORD_GAP_UNITS : 0;
+      continue;
+    }
+
+    uint8_t code = morse::MORSE_CODES[*letter];
+    if (code == 0) {
+      continue;
+    }
+
+    if (pending_gap != 0 && !internal::Append(timeline, false, pending_gap)) {
+      timeline.length = 0;
+      return false;
+    }
+
+    int length = morse::CodeLength(code);
+    for (int i = 0; i < length; ++i) {
+      uint16_t units = morse::IsDash(code, i) ? DASH_UNITS : DOT_UNITS;
+      bool fits = internal::Append(timeline, true, units);
+      if (fits && i + 1 < length) {
+        fits = internal::Append(timeline, false, ELEMENT_GAP_UNITS);
+      }
+
+      if (!fits) {
+        timeline.length = 0;
+        return false;
+      }
+    }
+
+    pending_gap = LETTER_GAP_UNITS;
+  }
+
+  if (timeline.length == 0) {
+    return true;
+  }
+
+  if (!internal::Append(timeline, false, WORD_GAP_UNITS)) {
+    timeline.length = 0;
+    return false;
+  }
+
+  return true;
+}
+
+// Total length of a timeline in units.
+inline uint32_t TotalUnits(const Timeline& timeline) {
+  uint32_t units = 0;
+  for (size_t i = 0; i < timeline.length; ++i) {
+    units += timeline.edges[i].units;
+  }
+
+  return units;
+}
+
+} // timeline
+
+#endif // TIMELINE_H
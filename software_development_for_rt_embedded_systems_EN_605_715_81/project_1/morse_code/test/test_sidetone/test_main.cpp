@@ -0,0 +1,147 @@
+#include <math.h>
+#include <unity.h>
+
+#include "sidetone.h"
+
+// Host tests of the PCM sidetone::Sidetone renders, run with `pio test -e native`.
+
+namespace {
+
+// The board's 8 kHz and 5 ms ramps. 500 Hz makes the tone exactly 16 samples long.
+constexpr uint32_t SAMPLE_RATE_HZ = 8000;
+constexpr uint32_t TONE_HZ = 500;
+constexpr size_t PERIOD_SAMPLES = SAMPLE_RATE_HZ / TONE_HZ;
+constexpr size_t RAMP_SAMPLES = 40;
+
+constexpr double PI = 3.14159265358979323846;
+
+using Generator = sidetone::Sidetone<RAMP_SAMPLES>;
+
+int32_t Deviation(uint16_t sample) {
+  return (int32_t)sample - sidetone::DAC_MIDSCALE;
+}
+
+} // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_silent_at_midscale_until_keyed() {
+  Generator generator(SAMPLE_RATE_HZ, TONE_HZ);
+  uint16_t samples[100];
+  generator.Render(samples, 100);
+
+  TEST_ASSERT_TRUE(generator.IsSilent());
+  for (uint16_t sample : samples) {
+    TEST_ASSERT_EQUAL_UINT16(sidetone::DAC_MIDSCALE, sample);
+  }
+}
+
+// Sample n of the attack is the sine at phase n - 1 scaled by (1 - cos(pi n / RAMP_SAMPLES)) / 2.
+void test_attack_follows_raised_cosine() {
+  Generator generator(SAMPLE_RATE_HZ, TONE_HZ);
+  generator.Key(true);
+  uint16_t samples[RAMP_SAMPLES];
+  generator.Render(samples, RAMP_SAMPLES);
+
+  for (size_t n = 1; n <= RAMP_SAMPLES; ++n) {
+    double envelope = (1 - cos(PI * n / RAMP_SAMPLES)) / 2;
+    double sine = sin(2 * PI * (n - 1) / PERIOD_SAMPLES);
+    TEST_ASSERT_INT32_WITHIN(2, lround(sidetone::AMPLITUDE * sine * envelope),
+                             Deviation(samples[n - 1]));
+  }
+  TEST_ASSERT_FALSE(generator.IsSilent());
+}
+
+void test_release_mirrors_attack_and_ends_at_midscale() {
+  Generator generator(SAMPLE_RATE_HZ, TONE_HZ);
+  generator.Key(true);
+  uint16_t samples[RAMP_SAMPLES * 4];
+  generator.Render(samples, RAMP_SAMPLES * 4);
+
+  generator.Key(false);
+  generator.Render(samples, RAMP_SAMPLES);
+  int32_t previous_peak = sidetone::AMPLITUDE + 1;
+  for (size_t n = 0; n < RAMP_SAMPLES; ++n) {
+    // Peaks of the sine fall a quarter period into every period.
+    if (n % PERIOD_SAMPLES == PERIOD_SAMPLES / 4) {
+      int32_t peak = Deviation(samples[n]);
+      TEST_ASSERT_LESS_THAN(previous_peak, peak);
+      previous_peak = peak;
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT16(sidetone::DAC_MIDSCALE, samples[RAMP_SAMPLES - 1]);
+  TEST_ASSERT_TRUE(generator.IsSilent());
+
+  generator.Render(samples, 10);
+  for (size_t n = 0; n < 10; ++n) {
+    TEST_ASSERT_EQUAL_UINT16(sidetone::DAC_MIDSCALE, samples[n]);
+  }
+}
+
+// At full envelope the tone swings AMPLITUDE either way of midscale and stays within the DAC.
+void test_peak_amplitude() {
+  Generator generator(SAMPLE_RATE_HZ, TONE_HZ);
+  generator.Key(true);
+  uint16_t samples[2000];
+  generator.Render(samples, 2000);
+
+  int32_t highest = -sidetone::DAC_MIDSCALE;
+  int32_t lowest = sidetone::DAC_MIDSCALE;
+  for (size_t n = RAMP_SAMPLES; n < 2000; ++n) {
+    TEST_ASSERT_LESS_THAN(1 << sidetone::DAC_BITS, samples[n]);
+    int32_t deviation = Deviation(samples[n]);
+    highest = deviation > highest ? deviation : highest;
+    lowest = deviation < lowest ? deviation : lowest;
+  }
+  TEST_ASSERT_EQUAL_INT32(sidetone::AMPLITUDE, highest);
+  TEST_ASSERT_EQUAL_INT32(-sidetone::AMPLITUDE, lowest);
+}
+
+void test_tone_period() {
+  Generator generator(SAMPLE_RATE_HZ, TONE_HZ);
+  generator.Key(true);
+  uint16_t samples[SAMPLE_RATE_HZ];
+  generator.Render(samples, SAMPLE_RATE_HZ);
+
+  for (size_t n = RAMP_SAMPLES; n + PERIOD_SAMPLES < SAMPLE_RATE_HZ; ++n) {
+    TEST_ASSERT_EQUAL_UINT16(samples[n], samples[n + PERIOD_SAMPLES]);
+  }
+
+  // A pitch that is no whole number of samples still comes out at its frequency.
+  Generator odd(SAMPLE_RATE_HZ, 700);
+  odd.Key(true);
+  odd.Render(samples, SAMPLE_RATE_HZ);
+  size_t rising = 0;
+  for (size_t n = 1; n < SAMPLE_RATE_HZ; ++n) {
+    rising += Deviation(samples[n - 1]) < 0 && Deviation(samples[n]) >= 0;
+  }
+  TEST_ASSERT_UINT32_WITHIN(1, 700, rising);
+}
+
+// Keying up halfway through the attack ramps down from there, not from full envelope.
+void test_key_up_mid_attack() {
+  Generator generator(SAMPLE_RATE_HZ, TONE_HZ);
+  generator.Key(true);
+  uint16_t samples[RAMP_SAMPLES];
+  generator.Render(samples, RAMP_SAMPLES / 2);
+
+  generator.Key(false);
+  generator.Render(samples, RAMP_SAMPLES / 2 - 1);
+  TEST_ASSERT_FALSE(generator.IsSilent());
+  generator.Render(samples, 1);
+  TEST_ASSERT_TRUE(generator.IsSilent());
+  TEST_ASSERT_EQUAL_UINT16(sidetone::DAC_MIDSCALE, samples[0]);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_silent_at_midscale_until_keyed);
+  RUN_TEST(test_attack_follows_raised_cosine);
+  RUN_TEST(test_release_mirrors_attack_and_ends_at_midscale);
+  RUN_TEST(test_peak_amplitude);
+  RUN_TEST(test_tone_period);
+  RUN_TEST(test_key_up_mid_attack);
+  return UNITY_END();
+}
@@ -0,0 +1,105 @@
+#include <unity.h>
+
+#include "timeline.h"
+
+// Host tests of timeline::Compile, run with `pio test -e native`.
+
+namespace {
+
+struct ExpectedEdge {
+  bool mark;
+  uint16_t units;
+};
+
+constexpr ExpectedEdge DOT = {true, 1};
+constexpr ExpectedEdge DASH = {true, 3};
+constexpr ExpectedEdge ELEMENT_GAP = {false, 1};
+constexpr ExpectedEdge LETTER_GAP = {false, 3};
+constexpr ExpectedEdge WORD_GAP = {false, 7};
+
+timeline::Timeline compiled;
+timeline::Timeline other;
+
+void AssertEdges(const ExpectedEdge* expected, size_t count) {
+  TEST_ASSERT_EQUAL_size_t(count, compiled.length);
+  for (size_t i = 0; i < count; ++i) {
+    TEST_ASSERT_EQUAL(expected[i].mark, compiled.edges[i].mark);
+    TEST_ASSERT_EQUAL_UINT16(expected[i].units, compiled.edges[i].units);
+  }
+}
+
+void AssertSameEdges(const timeline::Timeline& a, const timeline::Timeline& b) {
+  TEST_ASSERT_EQUAL_size_t(a.length, b.length);
+  for (size_t i = 0; i < a.length; ++i) {
+    TEST_ASSERT_EQUAL(a.edges[i].mark, b.edges[i].mark);
+    TEST_ASSERT_EQUAL_UINT16(a.edges[i].units, b.edges[i].units);
+  }
+}
+
+} // namespace
+
+void setUp() {
+  compiled.length = 0;
+  other.length = 0;
+}
+
+void tearDown() {}
+
+// 1 unit between the elements of a letter, 3 between letters, 7 between words and after the last.
+void test_sos_sos_spacing() {
+  const ExpectedEdge expected[] = {
+      DOT, ELEMENT_GAP, DOT, ELEMENT_GAP, DOT, LETTER_GAP,
+      DASH, ELEMENT_GAP, DASH, ELEMENT_GAP, DASH, LETTER_GAP,
+      DOT, ELEMENT_GAP, DOT, ELEMENT_GAP, DOT, WORD_GAP,
+      DOT, ELEMENT_GAP, DOT, ELEMENT_GAP, DOT, LETTER_GAP,
+      DASH, ELEMENT_GAP, DASH, ELEMENT_GAP, DASH, LETTER_GAP,
+      DOT, ELEMENT_GAP, DOT, ELEMENT_GAP, DOT, WORD_GAP,
+  };
+
+  TEST_ASSERT_TRUE(timeline::Compile("SOS SOS", compiled));
+  AssertEdges(expected, sizeof(expected) / sizeof(expected[0]));
+}
+
+// "PARIS " is the standard word of 50 units that words per minute are measured with.
+void test_paris_is_fifty_units() {
+  TEST_ASSERT_TRUE(timeline::Compile("PARIS", compiled));
+  TEST_ASSERT_EQUAL_UINT32(50, timeline::TotalUnits(compiled));
+}
+
+// Leading, repeated and trailing spaces collapse into the single word gaps of "SOS SOS".
+void test_extra_spaces_collapse() {
+  TEST_ASSERT_TRUE(timeline::Compile("SOS SOS", compiled));
+  TEST_ASSERT_TRUE(timeline::Compile("  SOS   SOS ", other));
+  AssertSameEdges(compiled, other);
+}
+
+void test_unmapped_characters_are_skipped() {
+  TEST_ASSERT_TRUE(timeline::Compile("SOS", compiled));
+  TEST_ASSERT_TRUE(timeline::Compile("S#O~S", other));
+  AssertSameEdges(compiled, other);
+
+  TEST_ASSERT_TRUE(timeline::Compile("  #", compiled));
+  TEST_ASSERT_EQUAL_size_t(0, compiled.length);
+}
+
+// Seven element codes, 14 edges a letter, overflow MAX_EDGES well before the end.
+void test_message_too_long_leaves_timeline_empty() {
+  char message[timeline::MAX_EDGES / 7 + 2];
+  for (size_t i = 0; i + 1 < sizeof(message); ++i) {
+    message[i] = '$';
+  }
+  message[sizeof(message) - 1] = '\0';
+
+  TEST_ASSERT_FALSE(timeline::Compile(message, compiled));
+  TEST_ASSERT_EQUAL_size_t(0, compiled.length);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sos_sos_spacing);
+  RUN_TEST(test_paris_is_fifty_units);
+  RUN_TEST(test_extra_spaces_collapse);
+  RUN_TEST(test_unmapped_characters_are_skipped);
+  RUN_TEST(test_message_too_long_leaves_timeline_empty);
+  return UNITY_END();
+}
@@ -0,0 +1,131 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// Collects samples so several of them can share one datagram. Every datagram costs a transaction
+// with the WiFi bridge, a radio wakeup and UDP_IP_OVERHEAD bytes of headers on top of its payload,
+// which dominates at higher sample rates. A batch is flushed once it holds the configured number of
+// samples or its oldest sample reaches the configured age, whichever comes first. With a limit of
+// one sample every reading goes out on its own as a plain sample frame.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace batch {
+
+// IPv4 and UDP headers added to every datagram.
+inline constexpr size_t UDP_IP_OVERHEAD = 28;
+
+// Running totals of what has been sent, used to compare batched against unbatched transmission.
+struct TransmitStats {
+  unsigned long datagrams = 0;
+  unsigned long samples = 0;
+  unsigned long payload_bytes = 0;
+
+  void Record(size_t length, size_t sample_count) {
+    ++datagrams;
+    samples += sample_count;
+    payload_bytes += length;
+  }
+
+  // Bytes on the wire per sample, including the UDP and IP headers.
+  float BytesPerSample() const {
+    if (samples == 0) {
+      return 0;
+    }
+    return (float)(payload_bytes + datagrams * UDP_IP_OVERHEAD) / samples;
+  }
+
+  // Datagrams per second over `elapsed_ms`.
+  float PacketsPerSecond(unsigned long elapsed_ms) const {
+    if (elapsed_ms == 0) {
+      return 0;
+    }
+    return datagrams * 1000.0f / elapsed_ms;
+  }
+};
+
+class Batcher {
+ public:
+  // Sets the flush limits. `max_samples` is clamped to 1 - MAX_BATCH_SAMPLES.
+  void Configure(size_t max_samples, uint32_t max_age_ms) {
+    if (max_samples < 1) {
+      max_samples = 1;
+    } else if (max_samples > telemetry::MAX_BATCH_SAMPLES) {
+      max_samples = telemetry::MAX_BATCH_SAMPLES;
+    }
+
+    max_samples_ = max_samples;
+    max_age_ms_ = max_age_ms;
+  }
+
+  // Adds a sample taken at `now_ms`. Returns true if the batch is now due to be flushed.
+  bool Add(const telemetry::Sample& sample, unsigned long now_ms, bool heartbeat = false) {
+    if (count_ == 0) {
+      first_ms_ = now_ms;
+      heartbeats_ = 0;
+    }
+
+    samples_[count_++] = sample;
+    heartbeats_ += heartbeat;
+    return IsDue(now_ms);
+  }
+
+  // Whether the batch is full or its oldest sample has reached the age limit.
+  bool IsDue(unsigned long now_ms) const {
+    if (count_ == 0) {
+      return false;
+    }
+    return count_ >= max_samples_ || now_ms - first_ms_ >= max_age_ms_;
+  }
+
+  bool IsEmpty() const {
+    return count_ == 0;
+  }
+
+  size_t Size() const {
+    return count_;
+  }
+
+  // The pending samples, oldest first.
+  const telemetry::Sample* Samples() const {
+    return samples_;
+  }
+
+  // Empties the batch without encoding it.
+  void Clear() {
+    count_ = 0;
+  }
+
+  // Encodes the pending samples into `buffer`, which must hold MAX_BATCH_FRAME_SIZE bytes, and
+  // empties the batch. A single sample is sent as a plain sample frame. The frame is flagged as a
+  // heartbeat if every sample was added as one. Returns the number of bytes written, 0 if the batch
+  // was empty.
+  size_t Flush(uint8_t* buffer, uint8_t node_id, uint32_t sequence) {
+    size_t length = 0;
+    uint8_t flags = heartbeats_ == count_ ? telemetry::FLAG_HEARTBEAT : 0;
+    if (count_ == 1) {
+      length = telemetry::EncodeSample(buffer, node_id, sequence, samples_[0], flags);
+    } else if (count_ > 1) {
+      length = telemetry::EncodeBatch(buffer, node_id, sequence, samples_, count_, flags);
+    }
+
+    count_ = 0;
+    return length;
+  }
+
+ private:
+  telemetry::Sample samples_[telemetry::MAX_BATCH_SAMPLES];
+  size_t count_ = 0;
+  size_t heartbeats_ = 0;
+  size_t max_samples_ = 1;
+  uint32_t max_age_ms_ = 0;
+  unsigned long first_ms_ = 0;
+};
+
+} // batch
+
+#endif // BATCH_H
@@ -6,6 +6,48 @@ namespace config {
 inline constexpr char* SSID =  "your_internet";
 inline constexpr char* PASSWORD = "your_pwd";
 inline constexpr int PORT = 1234;
+// Identifies this node in every telemetry frame it sends.
+inline constexpr uint8_t NODE_ID = 1;
+// Reported by the GET_VERSION command.
+inline constexpr uint8_t FIRMWARE_VERSION_MAJOR = 2;
+inline constexpr uint8_t FIRMWARE_VERSION_MINOR = 0;
+inline constexpr uint8_t FIRMWARE_VERSION_PATCH = 0;
+
+// Range accepted for the transmit interval, in seconds.
+inline constexpr int MIN_TRANSMIT_INTERVAL_S = 1;
+inline constexpr int MAX_TRANSMIT_INTERVAL_S = 60;
+// Shortest time between two readings the DHT11 allows, in seconds. Oversampling reads at this rate.
+inline constexpr int SENSOR_MIN_PERIOD_S = 1;
+
+// Samples sent together in one datagram. 1 sends every reading on its own, up to
+// telemetry::MAX_BATCH_SAMPLES batches them. src/host/batch_bench.cc measures the trade: sending
+// every reading once a second, batches of 8 cut 46 bytes a sample to 13 and 1 datagram a second
+// to 0.125 for at most 7 s of delay. With the default deadband only one reading in a few hundred
+// is sent, a batch never fills before BATCH_MAX_AGE_MS and saves about 3% of the bytes while every
+// sample waits a minute, so batching stays off unless the deadband is turned off.
+inline constexpr size_t BATCH_MAX_SAMPLES = 1;
+// A batch is flushed once its oldest sample is this old, even if it is not full.
+inline constexpr uint32_t BATCH_MAX_AGE_MS = 60000;
+// Send every telemetry frame once to a multicast group instead of to each subscriber. Clients then
+// join the group rather than subscribe, and rate dividers do not apply.
+inline constexpr bool MULTICAST_ENABLED = false;
+inline constexpr uint8_t MULTICAST_GROUP[4] = {239, 255, 0, 1};
+inline constexpr int MULTICAST_PORT = 12345;
+
+// Deadband compression, see deadband.h. A sample is only sent when it moved more than DEADBAND_F
+// away from the last one sent, or after HEARTBEAT_MS without sending. A deadband of 0 sends every
+// sample.
+inline constexpr float DEADBAND_F = 0.5f;
+inline constexpr unsigned long HEARTBEAT_MS = 300000;
+
+// While nobody is subscribed samples are kept in the flash log, see flash_log.h. Once a subscriber
+// is back a batch of REPLAY_BATCH_SAMPLES logged samples, at most telemetry::MAX_BATCH_SAMPLES, is
+// replayed every REPLAY_INTERVAL_MS, so the backlog drains quickly while live samples get through.
+inline constexpr size_t REPLAY_BATCH_SAMPLES = 32;
+inline constexpr unsigned long REPLAY_INTERVAL_MS = 100;
+
+// How often the transmit and task timing statistics are printed to Serial.
+inline constexpr unsigned long STATS_REPORT_MS = 60000;
 
 }  // namespace config
 
@@ -0,0 +1,73 @@
+#include <Arduino.h>
+
+#include "dht_sensor.h"
+
+namespace dht_sensor {
+
+volatile unsigned long Sensor::edges_us_[MAX_EDGES];
+volatile size_t Sensor::edge_count_ = 0;
+
+bool Sensor::Begin(int pin) {
+  if (digitalPinToInterrupt(pin) < 0) {
+    return false;
+  }
+
+  pin_ = pin;
+  phase_ = Phase::IDLE;
+  pinMode(pin_, INPUT_PULLUP);
+  return true;
+}
+
+bool Sensor::Start(unsigned long now_ms) {
+  if (pin_ < 0 || IsBusy()) {
+    return false;
+  }
+
+  pinMode(pin_, OUTPUT);
+  digitalWrite(pin_, LOW);
+  phase_ = Phase::START_PULSE;
+  phase_start_ms_ = now_ms;
+  return true;
+}
+
+bool Sensor::Poll(unsigned long now_ms, Reading& reading) {
+  switch (phase_) {
+    case Phase::IDLE:
+      return false;
+
+    case Phase::START_PULSE:
+      if (now_ms - phase_start_ms_ < START_PULSE_MS) {
+        return false;
+      }
+
+      edge_count_ = 0;
+      pinMode(pin_, INPUT_PULLUP);
+      attachInterrupt(digitalPinToInterrupt(pin_), OnFallingEdge, FALLING);
+      phase_ = Phase::RECEIVING;
+      phase_start_ms_ = now_ms;
+      return false;
+
+    case Phase::RECEIVING:
+      // Poll() may run late, but the edges are timestamped by the ISR so that does not matter.
+      if (now_ms - phase_start_ms_ < RESPONSE_WINDOW_MS) {
+        return false;
+      }
+
+      detachInterrupt(digitalPinToInterrupt(pin_));
+      phase_ = Phase::IDLE;
+      reading = Decode((const unsigned long*)edges_us_, edge_count_);
+      return true;
+  }
+
+  return false;
+}
+
+void Sensor::OnFallingEdge() {
+  size_t count = edge_count_;
+  if (count < MAX_EDGES) {
+    edges_us_[count] = micros();
+    edge_count_ = count + 1;
+  }
+}
+
+} // dht_sensor
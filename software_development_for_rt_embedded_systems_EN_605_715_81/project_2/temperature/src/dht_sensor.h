@@ -0,0 +1,115 @@
+#ifndef DHT_SENSOR_H
+#define DHT_SENSOR_H
+
+#include <Arduino.h>
+
+// Non-blocking DHT11 driver. The library driver bit-bangs the whole exchange with interrupts
+// disabled for several milliseconds, so a reading is instead run as a state machine advanced from
+// loop():
+//
+//   START_PULSE  the data line is driven low for START_PULSE_MS to wake the sensor up
+//   RECEIVING    the line is released and a pin change interrupt timestamps every falling edge
+//   IDLE         after RESPONSE_WINDOW_MS the edges are decoded and the reading is published
+//
+// Every bit the sensor sends starts with a falling edge, a 50us low and then a high that lasts
+// ~27us for a 0 and ~70us for a 1. The time between two falling edges therefore is ~77us or ~120us
+// and is compared against BIT_THRESHOLD_US. The ISR only stores micros(), nothing is disabled.
+
+namespace dht_sensor {
+
+// The DHT11 needs at least 18ms.
+inline constexpr unsigned long START_PULSE_MS = 20;
+// The whole response takes a little over 5ms.
+inline constexpr unsigned long RESPONSE_WINDOW_MS = 8;
+inline constexpr unsigned long BIT_THRESHOLD_US = 100;
+
+inline constexpr size_t DATA_BITS = 40;
+// A falling edge before every bit and one after the last. The edge of the sensor's response signal
+// may be missed while the interrupt is being attached, so only these are required.
+inline constexpr size_t DATA_EDGES = DATA_BITS + 1;
+inline constexpr size_t MAX_EDGES = DATA_EDGES + 4;
+
+enum class Status {
+  OK,
+  // Fewer than DATA_EDGES edges arrived, e.g. the sensor is disconnected.
+  TIMEOUT,
+  CHECKSUM,
+};
+
+struct Reading {
+  Status status;
+  float humidity;
+  float temperature_c;
+
+  float TemperatureF() const {
+    return temperature_c * 9 / 5 + 32;
+  }
+};
+
+// Decodes the last DATA_EDGES of `count` falling edge timestamps into a reading.
+inline Reading Decode(const unsigned long* edges_us, size_t count) {
+  Reading reading = {Status::TIMEOUT, 0, 0};
+  if (count < DATA_EDGES) {
+    return reading;
+  }
+
+  const unsigned long* bit_edges = edges_us + count - DATA_EDGES;
+  uint8_t bytes[DATA_BITS / 8] = {};
+  for (size_t i = 0; i < DATA_BITS; ++i) {
+    bool one = bit_edges[i + 1] - bit_edges[i] > BIT_THRESHOLD_US;
+    bytes[i / 8] = (bytes[i / 8] << 1) | one;
+  }
+
+  if ((uint8_t)(bytes[0] + bytes[1] + bytes[2] + bytes[3]) != bytes[4]) {
+    reading.status = Status::CHECKSUM;
+    return reading;
+  }
+
+  reading.status = Status::OK;
+  reading.humidity = bytes[0] + bytes[1] * 0.1f;
+  reading.temperature_c = bytes[2] + (bytes[3] & 0x7F) * 0.1f;
+  if (bytes[3] & 0x80) {
+    reading.temperature_c = -reading.temperature_c;
+  }
+
+  return reading;
+}
+
+class Sensor {
+ public:
+  // Configures `pin`, which has to support attachInterrupt(). Returns false if it does not. Only
+  // one sensor can exist since the interrupt handler is shared.
+  bool Begin(int pin);
+
+  // Starts a reading. Returns false if one is already in progress.
+  bool Start(unsigned long now_ms);
+
+  // Advances the reading. Call on every pass through loop(). Returns true once a reading has
+  // completed, with `reading` holding the result or why it failed.
+  bool Poll(unsigned long now_ms, Reading& reading);
+
+  bool IsBusy() const {
+    return phase_ != Phase::IDLE;
+  }
+
+ private:
+  enum class Phase {
+    IDLE,
+    START_PULSE,
+    RECEIVING,
+  };
+
+  static void OnFallingEdge();
+
+  int pin_ = -1;
+  Phase phase_ = Phase::IDLE;
+  unsigned long phase_start_ms_ = 0;
+
+  // Written by the ISR only while RECEIVING, read by Poll() after the interrupt is detached.
+  static volatile unsigned long edges_us_[MAX_EDGES];
+  static volatile size_t edge_count_;
+};
+
+} // dht_sensor
+
+#endif // DHT_SENSOR_H
@@ -0,0 +1,88 @@
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+// Events driving the node's state machine and the queue that carries them from the timer ISR and
+// from UDP arrivals to loop(), which dispatches them against the transition table in main.cpp.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace events {
+
+enum class Type : uint8_t {
+  // The sample timer fired, value is unused.
+  TICK,
+  // A transmit interval elapsed, value is unused.
+  TRANSMIT_DUE,
+  // A client sent a SET_CLOCK command, value is the epoch.
+  CLOCK_RECEIVED,
+  // A client sent a START command.
+  START,
+  // A client sent a STOP command.
+  END,
+};
+
+struct Event {
+  Type type;
+  uint32_t value;
+  // Sender of the packet behind the event, 0 for timer events.
+  uint32_t address;
+  uint16_t port;
+  // Request id of the command behind the event, acked once the event is dispatched.
+  uint32_t request_id;
+};
+
+inline constexpr size_t QUEUE_CAPACITY = 16;
+
+// Bounded FIFO with any number of producers and loop() as the only consumer. A producer reserves a
+// slot by advancing the tail with a compare and swap and then fills it. On a single core that is
+// safe without disabling interrupts: an ISR runs to completion before loop() continues, and loop()
+// never pops while one of its own pushes is half done, so the consumer only ever sees filled slots.
+class Queue {
+ public:
+  // Returns false and counts the event as dropped if the queue is full.
+  bool Push(const Event& event) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    do {
+      if (tail - head_.load(std::memory_order_acquire) == QUEUE_CAPACITY) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel,
+                                          std::memory_order_relaxed));
+
+    slots_[tail % QUEUE_CAPACITY] = event;
+    return true;
+  }
+
+  // Called from loop() only.
+  bool Pop(Event& event) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    event = slots_[head % QUEUE_CAPACITY];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Events lost to a full queue since startup.
+  uint32_t Dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  Event slots_[QUEUE_CAPACITY];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> dropped_{0};
+};
+
+} // events
+
+#endif // EVENTS_H
@@ -0,0 +1,354 @@
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// Store and forward log for samples taken while nobody is subscribed. Samples are appended to a
+// circular log in flash and replayed once a subscriber is back, oldest first.
+//
+// The log is a ring of BLOCK_COUNT erase blocks written strictly in order, so every block is erased
+// once per trip around the ring and wear is spread evenly. Each block starts with a header:
+//
+//   offset  size  field
+//   0       4     magic         BLOCK_MAGIC
+//   4       4     sequence      incremented for every block started, orders the blocks
+//   8       4     base epoch    seconds since the epoch the records of the block are relative to
+//   12      3     reserved
+//   15      1     crc           CRC-8 of bytes 0 - 14
+//   16      4     consumed      CONSUMED_MAGIC once every record of the block was replayed
+//   20      4     sequence      copy of the sequence, written together with consumed
+//
+// followed by RECORDS_PER_BLOCK records:
+//
+//   0       4     offset        milliseconds since the base epoch
+//   4       3     value         signed fixed point, value * telemetry::VALUE_SCALE
+//   7       1     crc           CRC-8 of bytes 0 - 6
+//
+// Flash is never programmed twice between erases, and since erased data flash does not read back
+// as a fixed pattern, the magic numbers and CRCs are what tells written bytes from erased ones. The
+// replay position is only kept in RAM. After a reset the oldest block that is not marked consumed
+// is replayed from its start, so a block that was partly replayed before the reset repeats. Once
+// the log is drained the block being written is marked consumed too, even if it is not full, and
+// the next sample starts a new block instead of being added to a consumed one.
+//
+// `Device` is a block device with mbed's interface: read(), program() and erase() taking an address
+// and size and returning 0 on success, e.g. DataFlashBlockDevice on the UNO R4. Nothing in here
+// depends on Arduino, so it can be compiled and checked on the host against a RAM device.
+
+namespace flash_log {
+
+inline constexpr size_t BLOCK_SIZE = 1024;
+inline constexpr size_t BLOCK_COUNT = 8;
+inline constexpr size_t BLOCK_HEADER_SIZE = 24;
+inline constexpr size_t RECORD_SIZE = 8;
+inline constexpr size_t RECORDS_PER_BLOCK = (BLOCK_SIZE - BLOCK_HEADER_SIZE) / RECORD_SIZE;
+inline constexpr size_t CAPACITY = RECORDS_PER_BLOCK * BLOCK_COUNT;
+inline constexpr uint32_t BLOCK_MAGIC = 0x474F4C46;
+inline constexpr uint32_t CONSUMED_MAGIC = 0x44414552;
+// Largest magnitude of a fixed point value a record can hold.
+inline constexpr int32_t MAX_RECORD_VALUE = 0x7FFFFF;
+
+// CRC-8 with polynomial 0x07.
+inline uint8_t Crc8(const uint8_t* data, size_t length) {
+  uint8_t crc = 0;
+  for (size_t i = 0; i < length; ++i) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = crc & 0x80 ? (uint8_t)(crc << 1 ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+template <typename Device>
+class Log {
+ public:
+  // The log occupies BLOCK_COUNT * BLOCK_SIZE bytes of `device` from `start_address`, which has to
+  // be aligned to the device's erase blocks.
+  Log(Device& device, uint32_t start_address) : device_(device), start_address_(start_address) {}
+
+  // Recovers the log left in flash by a previous run. Returns false if the device cannot be read.
+  bool Begin() {
+    bool found = false;
+    for (size_t block = 0; block < BLOCK_COUNT; ++block) {
+      BlockHeader header;
+      if (!ReadHeader(block, header)) {
+        return false;
+      }
+
+      if (header.valid && (!found || (int32_t)(header.sequence - sequence_) > 0)) {
+        write_block_ = block;
+        sequence_ = header.sequence;
+        write_base_epoch_ = header.base_epoch;
+        found = true;
+      }
+    }
+
+    if (!found) {
+      started_ = false;
+      return true;
+    }
+
+    started_ = true;
+    counts_[write_block_] = CountRecords(write_block_, write_base_epoch_);
+
+    // The blocks before the newest one still belong to the log as long as their sequence numbers
+    // run on without a gap and they have not been replayed.
+    read_block_ = write_block_;
+    read_base_epoch_ = write_base_epoch_;
+    uint32_t sequence = sequence_;
+    for (size_t i = 1; i < BLOCK_COUNT; ++i) {
+      size_t block = (write_block_ + BLOCK_COUNT - i) % BLOCK_COUNT;
+      BlockHeader header;
+      if (!ReadHeader(block, header) || !header.valid || header.consumed ||
+          header.sequence != sequence - 1) {
+        break;
+      }
+
+      read_block_ = block;
+      read_base_epoch_ = header.base_epoch;
+      counts_[block] = CountRecords(block, header.base_epoch);
+      sequence = header.sequence;
+    }
+
+    read_record_ = 0;
+    BlockHeader header;
+    if (read_block_ == write_block_ && ReadHeader(write_block_, header) && header.consumed) {
+      read_record_ = counts_[write_block_];
+    }
+
+    pending_ = 0;
+    for (size_t block = read_block_;; block = (block + 1) % BLOCK_COUNT) {
+      pending_ += counts_[block];
+      if (block == write_block_) {
+        break;
+      }
+    }
+    pending_ -= read_record_;
+    return true;
+  }
+
+  // Appends a sample. A sample older than the current block's base epoch, e.g. after the clock was
+  // stepped back, starts a new block. When the log is full the oldest block that has not been
+  // replayed is overwritten and its samples are counted in Overwritten(). Returns false if the
+  // flash write failed.
+  bool Append(const telemetry::Sample& sample) {
+    if (!started_ || counts_[write_block_] == RECORDS_PER_BLOCK || WriteBlockConsumed() ||
+        (int32_t)(sample.epoch - write_base_epoch_) < 0 ||
+        sample.epoch - write_base_epoch_ >= UINT32_MAX / 1000 - 1) {
+      if (!StartBlock(sample.epoch)) {
+        return false;
+      }
+    }
+
+    int32_t value = telemetry::ToFixedPoint(sample.value);
+    if (value > MAX_RECORD_VALUE) {
+      value = MAX_RECORD_VALUE;
+    } else if (value < -MAX_RECORD_VALUE) {
+      value = -MAX_RECORD_VALUE;
+    }
+
+    uint8_t record[RECORD_SIZE];
+    telemetry::PutU32(record, (sample.epoch - write_base_epoch_) * 1000 + sample.millis);
+    record[4] = (uint8_t)value;
+    record[5] = (uint8_t)(value >> 8);
+    record[6] = (uint8_t)(value >> 16);
+    record[7] = Crc8(record, RECORD_SIZE - 1);
+    size_t address = RecordAddress(write_block_, counts_[write_block_]);
+    if (device_.program(record, address, RECORD_SIZE) != 0) {
+      return false;
+    }
+
+    ++counts_[write_block_];
+    ++pending_;
+    return true;
+  }
+
+  bool IsEmpty() const {
+    return pending_ == 0;
+  }
+
+  // Samples waiting to be replayed.
+  size_t Pending() const {
+    return pending_;
+  }
+
+  // Samples lost because the log was full, since startup.
+  uint32_t Overwritten() const {
+    return overwritten_;
+  }
+
+  // Reads up to `max_count` of the oldest samples that have not been replayed into `samples` and
+  // advances past them. A block is marked consumed in flash once all of its samples were read.
+  // Returns the number of samples read.
+  size_t Read(telemetry::Sample* samples, size_t max_count) {
+    size_t count = 0;
+    while (count < max_count && pending_ > 0) {
+      if (read_record_ == counts_[read_block_]) {
+        MarkConsumed(read_block_);
+        read_block_ = (read_block_ + 1) % BLOCK_COUNT;
+        read_record_ = 0;
+        BlockHeader header;
+        ReadHeader(read_block_, header);
+        read_base_epoch_ = header.base_epoch;
+      }
+
+      // A record that does not read back is skipped rather than stalling the replay.
+      if (ReadRecord(read_block_, read_base_epoch_, read_record_, samples[count])) {
+        ++count;
+      }
+      ++read_record_;
+      --pending_;
+    }
+
+    if (pending_ == 0 && read_record_ > 0) {
+      MarkConsumed(read_block_);
+    }
+    return count;
+  }
+
+ private:
+  struct BlockHeader {
+    bool valid;
+    bool consumed;
+    uint32_t sequence;
+    uint32_t base_epoch;
+  };
+
+  uint32_t BlockAddress(size_t block) const {
+    return start_address_ + block * BLOCK_SIZE;
+  }
+
+  uint32_t RecordAddress(size_t block, size_t record) const {
+    return BlockAddress(block) + BLOCK_HEADER_SIZE + record * RECORD_SIZE;
+  }
+
+  bool ReadHeader(size_t block, BlockHeader& header) {
+    uint8_t bytes[BLOCK_HEADER_SIZE];
+    header.valid = false;
+    header.consumed = false;
+    if (device_.read(bytes, BlockAddress(block), BLOCK_HEADER_SIZE) != 0) {
+      return false;
+    }
+
+    header.sequence = telemetry::GetU32(bytes + 4);
+    header.base_epoch = telemetry::GetU32(bytes + 8);
+    header.valid = telemetry::GetU32(bytes) == BLOCK_MAGIC && Crc8(bytes, 15) == bytes[15];
+    header.consumed = telemetry::GetU32(bytes + 16) == CONSUMED_MAGIC &&
+                      telemetry::GetU32(bytes + 20) == header.sequence;
+    return true;
+  }
+
+  bool ReadRecord(size_t block, uint32_t base_epoch, size_t record, telemetry::Sample& sample) {
+    uint8_t bytes[RECORD_SIZE];
+    if (device_.read(bytes, RecordAddress(block, record), RECORD_SIZE) != 0 ||
+        Crc8(bytes, RECORD_SIZE - 1) != bytes[7]) {
+      return false;
+    }
+
+    uint32_t offset_ms = telemetry::GetU32(bytes);
+    // Sign extends the 24 bit value.
+    int32_t value = (int32_t)((uint32_t)bytes[4] << 8 | (uint32_t)bytes[5] << 16 |
+                              (uint32_t)bytes[6] << 24) >> 8;
+    sample.epoch = base_epoch + offset_ms / 1000;
+    sample.millis = offset_ms % 1000;
+    sample.value = (float)value / telemetry::VALUE_SCALE;
+    return true;
+  }
+
+  bool StartBlock(uint32_t base_epoch) {
+    size_t block = started_ ? (write_block_ + 1) % BLOCK_COUNT : 0;
+    if (started_ && block == read_block_ && pending_ > 0) {
+      // The ring is full, the oldest block makes room.
+      size_t lost = counts_[read_block_] - read_record_;
+      overwritten_ += lost;
+      pending_ -= lost;
+      read_block_ = (read_block_ + 1) % BLOCK_COUNT;
+      read_record_ = 0;
+      BlockHeader header;
+      ReadHeader(read_block_, header);
+      read_base_epoch_ = header.base_epoch;
+    }
+
+    if (device_.erase(BlockAddress(block), BLOCK_SIZE) != 0) {
+      return false;
+    }
+
+    uint8_t bytes[16] = {};
+    telemetry::PutU32(bytes, BLOCK_MAGIC);
+    telemetry::PutU32(bytes + 4, sequence_ + 1);
+    telemetry::PutU32(bytes + 8, base_epoch);
+    bytes[15] = Crc8(bytes, 15);
+    if (device_.program(bytes, BlockAddress(block), sizeof(bytes)) != 0) {
+      return false;
+    }
+
+    if (pending_ == 0) {
+      read_block_ = block;
+      read_record_ = 0;
+      read_base_epoch_ = base_epoch;
+    }
+
+    ++sequence_;
+    write_block_ = block;
+    counts_[block] = 0;
+    write_base_epoch_ = base_epoch;
+    started_ = true;
+    return true;
+  }
+
+  // Records of a block, which ends at the first record that does not read back. Blocks are only
+  // left partly filled when a sample starts a new block early.
+  size_t CountRecords(size_t block, uint32_t base_epoch) {
+    for (size_t record = 0; record < RECORDS_PER_BLOCK; ++record) {
+      telemetry::Sample sample;
+      if (!ReadRecord(block, base_epoch, record, sample)) {
+        return record;
+      }
+    }
+
+    return RECORDS_PER_BLOCK;
+  }
+
+  // Whether every record of the block being written was replayed, so it is or will be marked
+  // consumed, including a block found consumed by Begin().
+  bool WriteBlockConsumed() const {
+    return read_block_ == write_block_ && read_record_ > 0 &&
+           read_record_ == counts_[write_block_];
+  }
+
+  void MarkConsumed(size_t block) {
+    BlockHeader header;
+    if (!ReadHeader(block, header) || !header.valid || header.consumed) {
+      return;
+    }
+
+    uint8_t bytes[8];
+    telemetry::PutU32(bytes, CONSUMED_MAGIC);
+    telemetry::PutU32(bytes + 4, header.sequence);
+    device_.program(bytes, BlockAddress(block) + 16, sizeof(bytes));
+  }
+
+  Device& device_;
+  uint32_t start_address_;
+
+  bool started_ = false;
+  uint32_t sequence_ = 0;
+  size_t write_block_ = 0;
+  // Records written to each block of the log.
+  size_t counts_[BLOCK_COUNT] = {};
+  uint32_t write_base_epoch_ = 0;
+  size_t read_block_ = 0;
+  size_t read_record_ = 0;
+  uint32_t read_base_epoch_ = 0;
+  size_t pending_ = 0;
+  uint32_t overwritten_ = 0;
+};
+
+} // flash_log
+
+#endif // FLASH_LOG_H
@@ -0,0 +1,153 @@
+// Host benchmark of batch::Batcher, built by the native environment:
+//
+//   pio run -e native
+//   .pio/build/native/program [--interval S] [--hours N] [--max-age MS] [--seed N]
+//
+// Feeds a day of synthetic readings taken every --interval seconds through the deadband filter
+// and batcher the way RecordTemperature and ServiceSensor do, once with the configured deadband
+// and once sending every reading, for every batch size from 1 to telemetry::MAX_BATCH_SAMPLES.
+// Prints the datagrams per second and bytes on the wire per sample that come out, including the
+// UDP and IP headers, and how long samples waited in the batch.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <vector>
+
+#include "batch.h"
+#include "configurations.h"
+#include "deadband.h"
+#include "telemetry.h"
+
+namespace {
+
+// An indoor day: a few degrees of daily swing, slow drift and sensor noise, in the DHT's 0.1 steps.
+std::vector<float> Readings(size_t count, uint32_t interval_s, uint32_t seed) {
+  std::mt19937 random(seed);
+  std::normal_distribution<float> noise(0, 0.1f);
+  std::normal_distribution<float> drift(0, 0.002f);
+  std::vector<float> readings(count);
+  float offset = 0;
+  for (size_t i = 0; i < count; ++i) {
+    double day = (double)i * interval_s / 86400;
+    offset += drift(random);
+    float value = 21 + 3 * (float)sin(2 * M_PI * day) + offset + noise(random);
+    readings[i] = roundf(value * 10) / 10;
+  }
+  return readings;
+}
+
+struct Result {
+  batch::TransmitStats stats;
+  double mean_wait_s = 0;
+  double max_wait_s = 0;
+};
+
+// Runs `readings` through a deadband of `deadband` and batches of up to `max_samples`.
+Result Run(const std::vector<float>& readings, uint32_t interval_s, float deadband,
+           size_t max_samples, uint32_t max_age_ms) {
+  deadband::Filter filter;
+  filter.Configure(deadband, config::HEARTBEAT_MS);
+  batch::Batcher batcher;
+  batcher.Configure(max_samples, max_age_ms);
+
+  Result result;
+  uint8_t frame[telemetry::MAX_BATCH_FRAME_SIZE];
+  uint32_t sequence = 0;
+  double wait_sum_ms = 0;
+  std::vector<unsigned long> added_ms;
+
+  auto flush = [&](unsigned long now_ms) {
+    size_t count = batcher.Size();
+    size_t length = batcher.Flush(frame, config::NODE_ID, sequence++);
+    if (length == 0) {
+      return;
+    }
+    result.stats.Record(length, count);
+    for (unsigned long added : added_ms) {
+      double wait_ms = now_ms - added;
+      wait_sum_ms += wait_ms;
+      result.max_wait_s = wait_ms / 1000 > result.max_wait_s ? wait_ms / 1000 : result.max_wait_s;
+    }
+    added_ms.clear();
+  };
+
+  // The sensor task runs every millisecond, checking the age limit in between readings is enough
+  // at the granularity of the age limit itself.
+  unsigned long step_ms = max_age_ms < interval_s * 1000UL ? max_age_ms : interval_s * 1000UL;
+  unsigned long now_ms = 0;
+  for (size_t i = 0; i < readings.size(); ++i) {
+    unsigned long reading_ms = (unsigned long)i * interval_s * 1000;
+    for (; now_ms < reading_ms; now_ms += step_ms) {
+      if (batcher.IsDue(now_ms)) {
+        flush(now_ms);
+      }
+    }
+    now_ms = reading_ms;
+
+    telemetry::Sample sample = {(uint32_t)(reading_ms / 1000), 0, readings[i]};
+    deadband::Decision decision = filter.Check(readings[i], reading_ms);
+    if (decision == deadband::Decision::SUPPRESS) {
+      continue;
+    }
+    added_ms.push_back(reading_ms);
+    if (batcher.Add(sample, reading_ms, decision == deadband::Decision::HEARTBEAT)) {
+      flush(reading_ms);
+    }
+  }
+  flush(now_ms);
+
+  if (result.stats.samples > 0) {
+    result.mean_wait_s = wait_sum_ms / result.stats.samples / 1000;
+  }
+  return result;
+}
+
+const char* Option(int argc, char** argv, const char* name) {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (strcmp(argv[i], name) == 0) {
+      return argv[i + 1];
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const char* interval_option = Option(argc, argv, "--interval");
+  const char* hours_option = Option(argc, argv, "--hours");
+  const char* age_option = Option(argc, argv, "--max-age");
+  const char* seed_option = Option(argc, argv, "--seed");
+  int interval_s = interval_option != nullptr ? atoi(interval_option)
+                                             : config::MIN_TRANSMIT_INTERVAL_S;
+  double hours = hours_option != nullptr ? atof(hours_option) : 24;
+  long max_age_ms = age_option != nullptr ? atol(age_option) : config::BATCH_MAX_AGE_MS;
+  uint32_t seed = seed_option != nullptr ? (uint32_t)atoi(seed_option) : 1;
+  if (interval_s < config::MIN_TRANSMIT_INTERVAL_S ||
+      interval_s > config::MAX_TRANSMIT_INTERVAL_S || hours <= 0 || max_age_ms <= 0) {
+    fprintf(stderr, "usage: program [--interval S] [--hours N] [--max-age MS] [--seed N]\n");
+    return 2;
+  }
+
+  size_t count = (size_t)(hours * 3600 / interval_s);
+  std::vector<float> readings = Readings(count, interval_s, seed);
+  printf("%zu readings, one every %d s, batches flushed after %ld ms at the latest\n", count,
+         interval_s, max_age_ms);
+
+  const float deadbands[] = {0, config::DEADBAND_F};
+  for (float deadband : deadbands) {
+    printf("\ndeadband %.1f\n", deadband);
+    printf("batch  samples  datagrams  packets/s  bytes/sample  mean wait s  max wait s\n");
+    for (size_t size = 1; size <= telemetry::MAX_BATCH_SAMPLES; size *= 2) {
+      Result result = Run(readings, interval_s, deadband, size, (uint32_t)max_age_ms);
+      printf("%5zu  %7lu  %9lu  %9.4f  %12.1f  %11.1f  %10.1f\n", size, result.stats.samples,
+             result.stats.datagrams, result.stats.PacketsPerSecond((unsigned long)(hours * 3.6e6)),
+             result.stats.BytesPerSample(), result.mean_wait_s, result.max_wait_s);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,10 @@
+#include <Arduino.h>
+
+#include "latency.h"
+
+namespace latency {
+
+Recorder timer_jitter;
+Recorder interrupts_off;
+
+} // latency
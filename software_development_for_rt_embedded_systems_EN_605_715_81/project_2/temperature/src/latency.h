@@ -0,0 +1,78 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <Arduino.h>
+
+#include "telemetry.h"
+
+// Instrumentation of interrupt timing, reported to clients in a STATS frame. Two histograms are
+// kept: how far each timer interrupt lands from one period after the previous one, and how long
+// loop() runs with interrupts disabled inside a CriticalSection.
+
+namespace latency {
+
+// Histogram of microsecond durations with power of two buckets. Written from a single context
+// only, either one ISR or loop().
+class Recorder {
+ public:
+  void Record(uint32_t us) {
+    ++histogram_.count;
+    if (us > histogram_.max_us) {
+      histogram_.max_us = us;
+    }
+    ++histogram_.buckets[BucketOf(us)];
+  }
+
+  // Copy of the histogram. Taken without disabling interrupts, so a value recorded by an ISR while
+  // copying may be only partly included.
+  telemetry::Histogram Snapshot() const {
+    return histogram_;
+  }
+
+  void Reset() {
+    histogram_ = telemetry::Histogram();
+  }
+
+  static size_t BucketOf(uint32_t us) {
+    if (us == 0) {
+      return 0;
+    }
+
+    size_t bucket = 32 - __builtin_clz(us);
+    return bucket < telemetry::HISTOGRAM_BUCKETS ? bucket : telemetry::HISTOGRAM_BUCKETS - 1;
+  }
+
+ private:
+  telemetry::Histogram histogram_ = {};
+};
+
+// Timer ISR entry jitter, recorded by timer_callback.
+extern Recorder timer_jitter;
+// Time spent in CriticalSections.
+extern Recorder interrupts_off;
+
+// Disables interrupts for its lifetime and records for how long into interrupts_off. Only for use
+// in loop(), never in an ISR.
+class CriticalSection {
+ public:
+  CriticalSection() {
+    noInterrupts();
+    start_us_ = micros();
+  }
+
+  ~CriticalSection() {
+    uint32_t elapsed_us = micros() - start_us_;
+    interrupts();
+    interrupts_off.Record(elapsed_us);
+  }
+
+  CriticalSection(const CriticalSection&) = delete;
+  CriticalSection& operator=(const CriticalSection&) = delete;
+
+ private:
+  uint32_t start_us_;
+};
+
+} // latency
+
+#endif // LATENCY_H
@@ -1,25 +1,58 @@
 #define DHTPIN 11
-#define DHTTYPE DHT11
 
 #include <Arduino.h>
-#include <DHT.h>
+#include <DataFlashBlockDevice.h>
 #include <WiFiS3.h>
 
+#include "batch.h"
 #include "configurations.h"
-#include "RTC.h"
+#include "deadband.h"
+#include "dht_sensor.h"
+#include "events.h"
+#include "flash_log.h"
+#include "latency.h"
+#include "node_clock.h"
+#include "oversampling.h"
+#include "retransmit.h"
+#include "rollup.h"
 #include "rtc_config.h"
+#include "scheduler.h"
+#include "state.h"
+#include "telemetry.h"
 #include "transmit.h"
 #include "wifi_setup.h"
 #include "FspTimer.h"
 
 const int PORT = 12345;
 
-volatile bool readyToReadTemp = false;
-volatile bool stableTemp = false;
-volatile uint8_t tickCount = 0;
+volatile uint32_t tickCount = 0;
+// Sensor readings per transmitted sample, 1 unless oversampling.
+volatile uint32_t ticksPerTransmit = 1;
+// Timer period and the micros() of the previous tick, 0 until the first tick at that period.
+volatile uint32_t tickPeriodUs = 0;
+volatile uint32_t lastTickUs = 0;
+int applied_interval = 0;
+bool applied_oversampling = false;
+// Set when a transmit interval elapsed, until its value is transmitted.
+bool transmit_pending = false;
+uint32_t frame_sequence = 0;
+unsigned long stats_start_ms = 0;
+size_t last_subscriber_count = 0;
+// Units of every sampled value, Fahrenheit unless a client changed them.
+telemetry::Units units = telemetry::Units::FAHRENHEIT;
 
 state::AppState app_state;
-DHT dht(DHTPIN, DHTTYPE);
+events::Queue event_queue;
+batch::Batcher batcher;
+batch::TransmitStats transmit_stats;
+subscribers::Table subscriber_table;
+retransmit::Window retransmit_window;
+rollup::Store rollups;
+// Uses the whole 8 KB data flash.
+flash_log::Log<DataFlashBlockDevice> sample_log(DataFlashBlockDevice::getInstance(), 0);
+oversampling::Averager averager;
+deadband::Filter deadband_filter;
+dht_sensor::Sensor dht;
 FspTimer temp_timer;
 WiFiUDP udp;
 
@@ -36,11 +69,20 @@ wifi_utils::WiFiConfigurations wifi_configs = {
     }
 };
 
+// Fires once per sensor reading.
 void timer_callback(timer_callback_args_t __attribute__((unused)) *p_args) {
+  uint32_t now_us = micros();
+  if (lastTickUs != 0) {
+    int32_t jitter_us = (int32_t)(now_us - lastTickUs - tickPeriodUs);
+    latency::timer_jitter.Record(jitter_us < 0 ? -jitter_us : jitter_us);
+  }
+  lastTickUs = now_us;
+
+  event_queue.Push({events::Type::TICK, 0, 0, 0, 0});
   tickCount++;
-  if (tickCount >= 10) {
+  if (tickCount >= ticksPerTransmit) {
     tickCount = 0;
-    readyToReadTemp = true;
+    event_queue.Push({events::Type::TRANSMIT_DUE, 0, 0, 0, 0});
   }
 }
 
@@ -65,62 +107,532 @@ bool BeginTimer(float rate_hz) {
   return true;
 }
 
+// Reprograms the timer for the transmit interval and oversampling mode held in app_state. Without
+// oversampling the timer fires once per interval, otherwise at the sensor's maximum rate with every
+// reading of an interval averaged into the transmitted value.
+void ApplySampleRate() {
+  int interval = app_state.GetTransmitInterval();
+  bool oversampling = app_state.IsOversampling();
+  if (interval == applied_interval && oversampling == applied_oversampling) {
+    return;
+  }
 
-void setup() {
-  if (app_state.GetState() == state::States::UNINITIALIZED) {
-    Serial.begin(9600);
-    dht.begin();
+  int period_s = interval;
+  uint32_t ticks = 1;
+  if (oversampling) {
+    period_s = config::SENSOR_MIN_PERIOD_S;
+    ticks = interval / config::SENSOR_MIN_PERIOD_S;
+  }
 
-    while (wifi_utils::SetupWiFi(wifi_configs)) {
-      Serial.println("Unable to connect to Wifi..."
-      "You are currently trapped in an infinite loop!!!");
-    }
+  {
+    latency::CriticalSection critical_section;
+    ticksPerTransmit = ticks;
+    tickCount = 0;
+    tickPeriodUs = period_s * 1000000UL;
+    lastTickUs = 0;
+  }
 
-    udp.begin(PORT);
-    Serial.print("UDP Server started on port: ");
-    Serial.println(PORT);
+  if (!temp_timer.set_frequency(1.0f / period_s)) {
+    Serial.println("Failed to change timer frequency");
+    return;
+  }
+
+  // Readings of the old rate are not mixed into the new one.
+  averager.Reset();
+  applied_interval = interval;
+  applied_oversampling = oversampling;
+}
 
-    if (!BeginTimer(1.0)) {
-    Serial.println("Timer failed to start");
+// Whether a sent sample reaches anyone, otherwise it is kept in the flash log.
+bool HasListeners() {
+  return config::MULTICAST_ENABLED || subscriber_table.Count() > 0;
+}
+
+void LogSample(const telemetry::Sample& sample) {
+  if (!sample_log.Append(sample)) {
+    Serial.println("Failed to write the sample log");
+  }
+}
+
+void FlushBatch() {
+  if (!HasListeners()) {
+    for (size_t i = 0; i < batcher.Size(); ++i) {
+      LogSample(batcher.Samples()[i]);
     }
+    batcher.Clear();
+    return;
   }
 
-  rtc_config::WaitForClockConfiguration(udp, app_state, state::States::CONNECTED);
+  size_t sample_count = batcher.Size();
+  uint8_t frame[telemetry::MAX_BATCH_FRAME_SIZE];
+  size_t frame_length = batcher.Flush(frame, config::NODE_ID, frame_sequence);
+  if (frame_length == 0) {
+    return;
+  }
 
+  frame_sequence++;
+  transmit::Publish(udp, subscriber_table, frame, frame_length);
+  retransmit_window.Store(frame, frame_length);
+  transmit_stats.Record(frame_length, sample_count);
 }
 
-void loop() {
+void RecordTemperature(float temperature) {
+  Serial.print(units == telemetry::Units::CELSIUS ? "tempC " : "tempF ");
+  Serial.println(temperature);
+
+  telemetry::Sample sample;
+  node_clock::Now(sample.epoch, sample.millis);
+  sample.value = temperature;
+  rollups.Add(sample.epoch, temperature);
+
+  deadband::Decision decision = deadband_filter.Check(temperature, millis());
+  if (decision == deadband::Decision::SUPPRESS) {
+    return;
+  }
+
+  if (!HasListeners()) {
+    LogSample(sample);
+  } else if (batcher.Add(sample, millis(), decision == deadband::Decision::HEARTBEAT)) {
+    FlushBatch();
+  }
+}
 
-  if (state::ReadyToTransmitOptions(app_state)) {
-    app_state.UpdateState(state::States::READY);
-    transmit::TransmitOptions(udp);
+// Sends the next batch of logged samples, flagged as replayed, once per REPLAY_INTERVAL_MS.
+void ReplayLog() {
+  if (sample_log.IsEmpty() || !HasListeners()) {
     return;
   }
 
-  if (state::ReadyToTransmitTemp(app_state)) {
-    transmit::ListenForOption(udp, app_state);
+  static_assert(config::REPLAY_BATCH_SAMPLES <= telemetry::MAX_BATCH_SAMPLES);
+  telemetry::Sample samples[config::REPLAY_BATCH_SAMPLES];
+  size_t count = sample_log.Read(samples, config::REPLAY_BATCH_SAMPLES);
+  if (count == 0) {
+    return;
+  }
+
+  uint8_t frame[telemetry::MAX_BATCH_FRAME_SIZE];
+  size_t frame_length = telemetry::EncodeBatch(frame, config::NODE_ID, frame_sequence, samples,
+                                               count, telemetry::FLAG_REPLAY);
+  frame_sequence++;
+  transmit::Publish(udp, subscriber_table, frame, frame_length, true);
+  retransmit_window.Store(frame, frame_length);
+  if (sample_log.IsEmpty()) {
+    Serial.println("Sample log replayed");
+  }
+}
+
+void PrintTaskStats();
+
+void ReportStats() {
+  PrintTaskStats();
+  if (app_state.GetState() != state::States::TRANSMITTING) {
     return;
   }
 
-  if (state::ClientSignaledDone(app_state)) {
-    setup();
+  unsigned long now = millis();
+  Serial.print("Sent ");
+  Serial.print(transmit_stats.samples);
+  Serial.print(" samples in ");
+  Serial.print(transmit_stats.datagrams);
+  Serial.print(" datagrams, ");
+  Serial.print(transmit_stats.PacketsPerSecond(now - stats_start_ms), 3);
+  Serial.print(" packets/s, ");
+  Serial.print(transmit_stats.BytesPerSample(), 1);
+  Serial.print(" bytes/sample, compression ");
+  Serial.print(deadband_filter.CompressionRatio(), 1);
+  Serial.print(":1, ");
+  Serial.print(sample_log.Pending());
+  Serial.print(" samples logged, ");
+  Serial.print(sample_log.Overwritten());
+  Serial.println(" overwritten");
+}
+
+
+void OnClockReceived(const events::Event& event) {
+  node_clock::SetCoarse(event.value, event.address, event.port);
+}
+
+void OnStart(const events::Event& event) {
+  // The client that starts transmission is subscribed for one default lease, which it renews with
+  // subscribe messages.
+  uint16_t granted_s;
+  subscriber_table.Subscribe(event.address, event.port, 0, 1, millis(), granted_s);
+
+  // Statistics and averages cover one session.
+  transmit_stats = batch::TransmitStats();
+  deadband_filter.ResetCounts();
+  stats_start_ms = millis();
+  averager.Reset();
+  transmit_pending = false;
+
+  Serial.println("Transmission started");
+}
+
+void OnEnd(const events::Event&) {
+  FlushBatch();
+  Serial.println("Transmission ended");
+}
+
+void OnTick(const events::Event&) {
+  dht.Start(millis());
+}
+
+void OnTransmitDue(const events::Event&) {
+  transmit_pending = true;
+}
+
+using state::States;
+using EventType = events::Type;
+
+// Every event that is not listed for the current state is ignored, and rejected with
+// INVALID_STATE if a command caused it. The clock can be set again in any state, and a session
+// ended with STOP restarts with START straight from DONE.
+const state::Transition TRANSITIONS[] = {
+  {States::UNINITIALIZED, EventType::CLOCK_RECEIVED, States::READY, OnClockReceived},
+  {States::READY, EventType::CLOCK_RECEIVED, States::READY, OnClockReceived},
+  {States::READY, EventType::START, States::TRANSMITTING, OnStart},
+  {States::READY, EventType::END, States::DONE, OnEnd},
+  {States::TRANSMITTING, EventType::CLOCK_RECEIVED, States::TRANSMITTING, OnClockReceived},
+  {States::TRANSMITTING, EventType::TICK, States::TRANSMITTING, OnTick},
+  {States::TRANSMITTING, EventType::TRANSMIT_DUE, States::TRANSMITTING, OnTransmitDue},
+  {States::TRANSMITTING, EventType::END, States::DONE, OnEnd},
+  {States::DONE, EventType::CLOCK_RECEIVED, States::READY, OnClockReceived},
+  {States::DONE, EventType::START, States::TRANSMITTING, OnStart},
+};
+
+// The command each packet event came from, for its ack.
+telemetry::Opcode CommandOf(events::Type type) {
+  switch (type) {
+    case EventType::CLOCK_RECEIVED:
+      return telemetry::Opcode::SET_CLOCK;
+    case EventType::START:
+      return telemetry::Opcode::START;
+    default:
+      return telemetry::Opcode::STOP;
+  }
+}
+
+// Fills the GET_COUNTERS result. Samples and datagrams are counted since the session started.
+size_t PutCounters(uint8_t* result) {
+  using telemetry::Counter;
+  uint32_t counters[(size_t)Counter::COUNT] = {};
+  counters[(size_t)Counter::UPTIME_S] = millis() / 1000;
+  counters[(size_t)Counter::SAMPLES_TAKEN] = deadband_filter.Taken();
+  counters[(size_t)Counter::SAMPLES_SENT] = transmit_stats.samples;
+  counters[(size_t)Counter::DATAGRAMS_SENT] = transmit_stats.datagrams;
+  counters[(size_t)Counter::EVENTS_DROPPED] = event_queue.Dropped();
+  counters[(size_t)Counter::LOG_PENDING] = sample_log.Pending();
+  counters[(size_t)Counter::LOG_OVERWRITTEN] = sample_log.Overwritten();
+  counters[(size_t)Counter::SUBSCRIBERS] = subscriber_table.Count();
+
+  uint8_t* cursor = result;
+  *cursor++ = (uint8_t)Counter::COUNT;
+  for (uint32_t counter : counters) {
+    cursor = telemetry::PutU32(cursor, counter);
+  }
+  return cursor - result;
+}
+
+// Switches between Celsius and Fahrenheit. Refused while logged samples in the old units wait to be
+// replayed, since frames do not say which units their values are in. Everything aggregated in the
+// old units is dropped.
+telemetry::CommandStatus SetUnits(telemetry::Units new_units) {
+  if (new_units != telemetry::Units::CELSIUS && new_units != telemetry::Units::FAHRENHEIT) {
+    return telemetry::CommandStatus::INVALID_ARGUMENT;
+  }
+  if (!sample_log.IsEmpty()) {
+    return telemetry::CommandStatus::INVALID_STATE;
+  }
+
+  if (new_units != units) {
+    FlushBatch();
+    units = new_units;
+    rollups.Clear();
+    averager.Reset();
+    deadband_filter.Reset();
+  }
+  return telemetry::CommandStatus::OK;
+}
+
+// Commands that change the session become events and are acked once dispatched, all others take
+// effect and are acked right away.
+void HandleCommand(const telemetry::Command& command, uint32_t address, uint16_t port) {
+  using telemetry::CommandStatus;
+  using telemetry::Opcode;
+
+  const uint8_t* args = command.args;
+  uint8_t result[telemetry::MAX_COMMAND_ACK_SIZE];
+  size_t result_length = 0;
+  CommandStatus status = CommandStatus::OK;
+
+  switch (command.opcode) {
+    case Opcode::SET_CLOCK:
+    case Opcode::START:
+    case Opcode::STOP: {
+      events::Event event = {EventType::END, 0, address, port, command.request_id};
+      if (command.opcode == Opcode::SET_CLOCK) {
+        event.type = EventType::CLOCK_RECEIVED;
+        event.value = telemetry::GetU32(args);
+        if (!rtc_config::IsValidEpoch(event.value)) {
+          status = CommandStatus::INVALID_ARGUMENT;
+          break;
+        }
+      } else if (command.opcode == Opcode::START) {
+        event.type = EventType::START;
+      }
+
+      if (event_queue.Push(event)) {
+        return;
+      }
+      status = CommandStatus::BUSY;
+      break;
+    }
+
+    case Opcode::SET_INTERVAL: {
+      uint32_t interval_ms = telemetry::GetU32(args);
+      if (interval_ms % 1000 != 0 || interval_ms < config::MIN_TRANSMIT_INTERVAL_S * 1000UL ||
+          interval_ms > config::MAX_TRANSMIT_INTERVAL_S * 1000UL) {
+        status = CommandStatus::INVALID_ARGUMENT;
+        break;
+      }
+
+      app_state.UpdateTransmitInterval(interval_ms / 1000);
+      Serial.print("Transmit interval set to ");
+      Serial.println(interval_ms / 1000);
+      break;
+    }
+
+    case Opcode::SET_OVERSAMPLING:
+      if (args[0] > 1) {
+        status = CommandStatus::INVALID_ARGUMENT;
+        break;
+      }
+
+      app_state.UpdateOversampling(args[0] != 0);
+      Serial.println(args[0] != 0 ? "Oversampling enabled" : "Oversampling disabled");
+      break;
+
+    case Opcode::SET_BATCH: {
+      uint32_t max_age_ms = telemetry::GetU32(args + 1);
+      if (args[0] < 1 || args[0] > telemetry::MAX_BATCH_SAMPLES || max_age_ms == 0) {
+        status = CommandStatus::INVALID_ARGUMENT;
+        break;
+      }
+
+      // Samples batched under the old limits go out first.
+      FlushBatch();
+      batcher.Configure(args[0], max_age_ms);
+      break;
+    }
+
+    case Opcode::SET_DEADBAND: {
+      float threshold = telemetry::FromFixedPoint((int32_t)telemetry::GetU32(args));
+      uint32_t heartbeat_ms = telemetry::GetU32(args + 4);
+      if (threshold < 0 || heartbeat_ms == 0) {
+        status = CommandStatus::INVALID_ARGUMENT;
+        break;
+      }
+
+      deadband_filter.Configure(threshold, heartbeat_ms);
+      deadband_filter.Reset();
+      break;
+    }
+
+    case Opcode::SET_UNITS:
+      status = SetUnits((telemetry::Units)args[0]);
+      break;
+
+    case Opcode::ADD_SUBSCRIBER: {
+      uint16_t granted_s;
+      if (subscriber_table.Subscribe(telemetry::GetU32(args), telemetry::GetU16(args + 4),
+                                     telemetry::GetU16(args + 6), args[8], millis(),
+                                     granted_s) != telemetry::SubscribeStatus::OK) {
+        status = CommandStatus::INVALID_STATE;
+        break;
+      }
+
+      result_length = telemetry::PutU16(result, granted_s) - result;
+      break;
+    }
+
+    case Opcode::REMOVE_SUBSCRIBER:
+      if (subscriber_table.Unsubscribe(telemetry::GetU32(args), telemetry::GetU16(args + 4)) !=
+          telemetry::SubscribeStatus::OK) {
+        status = CommandStatus::INVALID_STATE;
+      }
+      break;
+
+    case Opcode::GET_COUNTERS:
+      result_length = PutCounters(result);
+      break;
+
+    case Opcode::GET_VERSION:
+      result[0] = telemetry::PROTOCOL_VERSION;
+      result[1] = config::FIRMWARE_VERSION_MAJOR;
+      result[2] = config::FIRMWARE_VERSION_MINOR;
+      result[3] = config::FIRMWARE_VERSION_PATCH;
+      result[4] = (uint8_t)units;
+      result_length = 5;
+      break;
+
+    default:
+      status = CommandStatus::UNKNOWN_OPCODE;
+      break;
+  }
+
+  transmit::SendCommandAck(udp, address, port, command.request_id, command.opcode, status, result,
+                           result_length);
+}
+
+// Reads packets, runs the state machine on the events they and the timer raised and keeps the
+// subscriber table current.
+void ServiceNetwork() {
+  transmit::ListenForPacket(udp, subscriber_table, retransmit_window, rollups, HandleCommand);
+  node_clock::Poll(udp);
+
+  events::Event event;
+  while (event_queue.Pop(event)) {
+    bool dispatched = state::Dispatch(app_state, TRANSITIONS, event);
+    if (event.port == 0) {
+      continue;
+    }
+
+    if (!dispatched) {
+      Serial.print("Current state: ");
+      Serial.print(app_state.GetStateString());
+      Serial.println(" is not valid for this request");
+    }
+    transmit::SendCommandAck(udp, event.address, event.port, event.request_id,
+                             CommandOf(event.type),
+                             dispatched ? telemetry::CommandStatus::OK
+                                        : telemetry::CommandStatus::INVALID_STATE);
+  }
+
+  if (subscriber_table.Expire(millis()) != 0) {
+    Serial.print("Subscriber lease expired, subscribers: ");
+    Serial.println(subscriber_table.Count());
+  }
+
+  // A subscriber that just joined gets the current value right away instead of after the next
+  // change or heartbeat.
+  size_t subscriber_count = subscriber_table.Count();
+  if (subscriber_count > last_subscriber_count) {
+    deadband_filter.Reset();
+  }
+  last_subscriber_count = subscriber_count;
+}
+
+// Advances the DHT reading and sends the value of every elapsed transmit interval.
+void ServiceSensor() {
+  if (app_state.GetState() != state::States::TRANSMITTING) {
     return;
   }
 
-  if (app_state.GetState() == state::States::TRANSMITTING) {
-    if (readyToReadTemp) {
-      readyToReadTemp = false;
+  ApplySampleRate();
 
-      // Setting readTemperature to true automatically converts temperature from C to F
-      float tempF = dht.readTemperature(true);
-      Serial.print("tempF ");
-      Serial.println(tempF);
+  dht_sensor::Reading reading;
+  if (dht.Poll(millis(), reading)) {
+    if (reading.status == dht_sensor::Status::OK) {
+      averager.Add(units == telemetry::Units::CELSIUS ? reading.temperature_c
+                                                      : reading.TemperatureF());
+    } else {
+      Serial.println(reading.status == dht_sensor::Status::TIMEOUT ? "DHT read timed out"
+                                                                   : "DHT checksum mismatch");
+    }
+  }
 
-      RTCTime curr_time;
-      RTC.getTime(curr_time);
-      auto payload = curr_time.toString() + ", " + String(tempF, 2);
-      
-      transmit::Transmit(udp, {payload.c_str()});
+  // Waits for a reading started on the same tick so it is part of the transmitted value.
+  if (transmit_pending && !dht.IsBusy()) {
+    transmit_pending = false;
+    if (!averager.IsEmpty()) {
+      RecordTemperature(averager.TakeMean());
     }
   }
+
+  if (batcher.IsDue(millis())) {
+    FlushBatch();
+  }
+}
+
+// The sensor's edges are timestamped by its ISR, so polling it every millisecond is plenty. Every
+// packet poll is a round trip to the WiFi module that can take a few milliseconds, so packets are
+// polled every 5 ms, which still keeps time responses timestamped close to their arrival.
+scheduler::Task tasks[] = {
+  {"network", ServiceNetwork, 5000, 0},
+  {"sensor", ServiceSensor, 1000, 1},
+  {"replay", ReplayLog, config::REPLAY_INTERVAL_MS * 1000, 2},
+  {"stats", ReportStats, config::STATS_REPORT_MS * 1000, 3},
+};
+scheduler::Scheduler task_scheduler;
+
+// Task timing over the last report interval.
+void PrintTaskStats() {
+  Serial.print("Load ");
+  Serial.print(task_scheduler.Load() * 100, 1);
+  Serial.println("%");
+  for (size_t i = 0; i < task_scheduler.Count(); ++i) {
+    const scheduler::Task& task = task_scheduler.GetTask(i);
+    Serial.print("  ");
+    Serial.print(task.name);
+    Serial.print(": ");
+    Serial.print(task.stats.runs);
+    Serial.print(" runs, mean ");
+    Serial.print(task.stats.MeanRunUs());
+    Serial.print(" us, max ");
+    Serial.print(task.stats.max_run_us);
+    Serial.print(" us, jitter max ");
+    Serial.print(task.stats.max_jitter_us);
+    Serial.print(" us, missed ");
+    Serial.println(task.stats.missed);
+  }
+  task_scheduler.ResetStats();
+}
+
+void setup() {
+  Serial.begin(9600);
+  if (!dht.Begin(DHTPIN)) {
+    Serial.println("DHT pin does not support interrupts");
+  }
+  batcher.Configure(config::BATCH_MAX_SAMPLES, config::BATCH_MAX_AGE_MS);
+  deadband_filter.Configure(config::DEADBAND_F, config::HEARTBEAT_MS);
+
+  if (DataFlashBlockDevice::getInstance().init() != 0 || !sample_log.Begin()) {
+    Serial.println("Sample log unavailable");
+  } else {
+    Serial.print("Samples waiting in the sample log: ");
+    Serial.println(sample_log.Pending());
+  }
+
+  while (wifi_utils::SetupWiFi(wifi_configs)) {
+    Serial.println("Unable to connect to Wifi..."
+    "You are currently trapped in an infinite loop!!!");
+  }
+
+  udp.begin(PORT);
+  Serial.print("UDP Server started on port: ");
+  Serial.println(PORT);
+
+  // Started at the lowest rate so the timer's clock divider can also hold the longest period,
+  // then reprogrammed to the configured one.
+  if (!BeginTimer(1.0f / config::MAX_TRANSMIT_INTERVAL_S)) {
+  Serial.println("Timer failed to start");
+  }
+  ApplySampleRate();
+
+  task_scheduler.Begin(tasks, sizeof(tasks) / sizeof(tasks[0]),
+                       []() -> uint32_t { return micros(); });
+  Serial.println("Waiting for SET_CLOCK command...");
+}
+
+// Runs due tasks one at a time and sleeps until the next interrupt once none is due. The 1 ms
+// system tick bounds the sleep, the sample timer, the DHT and the WiFi module wake the core
+// earlier.
+void loop() {
+  if (task_scheduler.RunNext()) {
+    return;
+  }
+
+  uint32_t sleep_start_us = micros();
+  __WFI();
+  task_scheduler.AddIdle(micros() - sleep_start_us);
 }
@@ -0,0 +1,98 @@
+#include <Arduino.h>
+#include <WiFiS3.h>
+
+#include "configurations.h"
+#include "node_clock.h"
+#include "rtc_config.h"
+#include "telemetry.h"
+#include "time_sync.h"
+
+namespace node_clock {
+namespace {
+
+time_sync::Clock wall_clock;
+time_sync::Synchronizer synchronizer;
+uint32_t server_address = 0;
+uint16_t server_port = 0;
+int64_t next_sync_us = 0;
+
+} // namespace
+
+void SetCoarse(uint32_t epoch_s, uint32_t address, uint16_t port) {
+  int64_t now_us = wall_clock.Local(micros());
+  wall_clock.SetCoarse(epoch_s, now_us);
+  rtc_config::SetClock(epoch_s);
+
+  server_address = address;
+  server_port = port;
+  synchronizer.Start(now_us);
+}
+
+void Poll(WiFiUDP& udp) {
+  int64_t now_us = wall_clock.Local(micros());
+  if (server_port == 0) {
+    return;
+  }
+
+  if (!synchronizer.IsRunning() && now_us >= next_sync_us) {
+    synchronizer.Start(now_us);
+  }
+
+  uint32_t sequence;
+  uint32_t t1_us;
+  switch (synchronizer.Poll(now_us, sequence, t1_us)) {
+    case time_sync::Step::NONE:
+      return;
+
+    case time_sync::Step::SEND_REQUEST: {
+      uint8_t request[telemetry::TIME_REQUEST_SIZE];
+      size_t request_length =
+          telemetry::EncodeTimeRequest(request, config::NODE_ID, sequence, t1_us);
+      udp.beginPacket(IPAddress(server_address), server_port);
+      udp.write(request, request_length);
+      udp.endPacket();
+      return;
+    }
+
+    case time_sync::Step::FINISHED:
+      if (!synchronizer.Succeeded()) {
+        Serial.println("Time sync got no response");
+        next_sync_us = now_us + time_sync::RETRY_INTERVAL_US;
+        return;
+      }
+
+      wall_clock.Apply(synchronizer.Best());
+      rtc_config::SetClock(wall_clock.EpochMicros(now_us) / 1000000);
+      next_sync_us = now_us + time_sync::RESYNC_INTERVAL_US;
+
+      Serial.print("Time synced, round trip ");
+      Serial.print((long)synchronizer.Best().delay_us);
+      Serial.print(" us, drift ");
+      Serial.print(wall_clock.DriftPpb());
+      Serial.println(" ppb");
+      return;
+  }
+}
+
+bool HandleMessage(const uint8_t* packet, size_t length, uint32_t received_us) {
+  telemetry::Header header;
+  uint32_t t1_us;
+  int64_t t2_us;
+  int64_t t3_us;
+  if (!telemetry::DecodeHeader(packet, length, header) ||
+      header.type != telemetry::FrameType::TIME_RESPONSE ||
+      !telemetry::DecodeTimeResponse(packet, length, t1_us, t2_us, t3_us)) {
+    return false;
+  }
+
+  synchronizer.OnResponse(header.sequence, t1_us, t2_us, t3_us, wall_clock.Local(received_us));
+  return true;
+}
+
+void Now(uint32_t& epoch_s, uint16_t& millis) {
+  int64_t epoch_ms = wall_clock.EpochMicros(wall_clock.Local(micros())) / 1000;
+  epoch_s = epoch_ms / 1000;
+  millis = epoch_ms % 1000;
+}
+
+} // node_clock
@@ -0,0 +1,30 @@
+#ifndef NODE_CLOCK_H
+#define NODE_CLOCK_H
+
+#include <Arduino.h>
+#include <WiFiS3.h>
+
+// The node's wall clock. It starts from the whole second epoch a client sends and is then kept
+// synchronized with that client by the exchange in time_sync.h, which is repeated periodically to
+// estimate and correct the drift of micros(). Sample timestamps come from here and are accurate to
+// the millisecond. The RTC is set on every sync as well.
+
+namespace node_clock {
+
+// Sets the clock from a whole second epoch sent by the client at `address`:`port`, which is asked
+// for the time from then on, and starts a sync with it.
+void SetCoarse(uint32_t epoch_s, uint32_t address, uint16_t port);
+
+// Sends due time requests, applies finished syncs and starts resyncs. Call on every pass through
+// loop().
+void Poll(WiFiUDP& udp);
+
+// Takes a time response received at `received_us`. Returns false if `packet` is not one.
+bool HandleMessage(const uint8_t* packet, size_t length, uint32_t received_us);
+
+// Current time as seconds since the epoch and milliseconds within the second.
+void Now(uint32_t& epoch_s, uint16_t& millis);
+
+} // node_clock
+
+#endif // NODE_CLOCK_H
@@ -0,0 +1,47 @@
+#ifndef OVERSAMPLING_H
+#define OVERSAMPLING_H
+
+#include <stddef.h>
+
+// Decimation for the oversampling mode. The sensor is read at its maximum rate and every reading of
+// a transmit interval is averaged into the one value that gets transmitted.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace oversampling {
+
+class Averager {
+ public:
+  void Add(float value) {
+    sum_ += value;
+    ++count_;
+  }
+
+  bool IsEmpty() const {
+    return count_ == 0;
+  }
+
+  size_t Count() const {
+    return count_;
+  }
+
+  // Mean of the values added since the last call. Only valid while not empty.
+  float TakeMean() {
+    float mean = sum_ / count_;
+    Reset();
+    return mean;
+  }
+
+  void Reset() {
+    sum_ = 0;
+    count_ = 0;
+  }
+
+ private:
+  float sum_ = 0;
+  size_t count_ = 0;
+};
+
+} // oversampling
+
+#endif // OVERSAMPLING_H
@@ -0,0 +1,211 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+// Rolling aggregates of every sample a node takes, so a client can fetch hours or weeks of history
+// in a few datagrams instead of the raw stream. Each tier splits time into buckets of a fixed
+// period aligned to the epoch and keeps the most recent TIER_BUCKETS of them in a ring. A bucket
+// holds the count, min, max, mean and the sum of squared deviations from the mean, all updated
+// with Welford's method in O(1) per sample and tier, so no samples are kept.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace rollup {
+
+inline constexpr size_t TIER_COUNT = 3;
+// 10 minutes of 10 s buckets, an hour of 1 min buckets and a week of 1 h buckets.
+inline constexpr uint32_t TIER_PERIODS_S[TIER_COUNT] = {10, 60, 3600};
+inline constexpr size_t TIER_BUCKETS[TIER_COUNT] = {60, 60, 168};
+
+inline constexpr size_t TOTAL_BUCKETS = TIER_BUCKETS[0] + TIER_BUCKETS[1] + TIER_BUCKETS[2];
+
+struct Bucket {
+  uint32_t start_epoch;
+  uint32_t count;
+  float min;
+  float max;
+  float mean;
+  float m2;
+
+  // Sample variance, 0 for fewer than two samples.
+  float Variance() const {
+    return count > 1 ? m2 / (count - 1) : 0;
+  }
+};
+
+class Tier {
+ public:
+  void Begin(Bucket* buckets, size_t capacity, uint32_t period_s) {
+    buckets_ = buckets;
+    capacity_ = capacity;
+    period_s_ = period_s;
+    newest_ = 0;
+    size_ = 0;
+  }
+
+  void Add(uint32_t epoch, float value) {
+    uint32_t start = epoch - epoch % period_s_;
+    // A sample from before the newest bucket, after the clock was stepped back, is counted in the
+    // newest bucket rather than reordering the ring.
+    if (size_ == 0 || (int32_t)(start - buckets_[newest_].start_epoch) > 0) {
+      newest_ = size_ == 0 ? 0 : (newest_ + 1) % capacity_;
+      if (size_ < capacity_) {
+        ++size_;
+      }
+
+      Bucket& bucket = buckets_[newest_];
+      bucket.start_epoch = start;
+      bucket.count = 0;
+      bucket.min = value;
+      bucket.max = value;
+      bucket.mean = 0;
+      bucket.m2 = 0;
+    }
+
+    Bucket& bucket = buckets_[newest_];
+    ++bucket.count;
+    float delta = value - bucket.mean;
+    bucket.mean += delta / bucket.count;
+    bucket.m2 += delta * (value - bucket.mean);
+    if (value < bucket.min) {
+      bucket.min = value;
+    }
+    if (value > bucket.max) {
+      bucket.max = value;
+    }
+  }
+
+  void Clear() {
+    newest_ = 0;
+    size_ = 0;
+  }
+
+  uint32_t Period() const {
+    return period_s_;
+  }
+
+  size_t Size() const {
+    return size_;
+  }
+
+  // The i-th bucket, 0 being the oldest.
+  const Bucket& At(size_t i) const {
+    return buckets_[(newest_ + capacity_ - size_ + 1 + i) % capacity_];
+  }
+
+ private:
+  Bucket* buckets_ = nullptr;
+  size_t capacity_ = 0;
+  uint32_t period_s_ = 1;
+  size_t newest_ = 0;
+  size_t size_ = 0;
+};
+
+class Store {
+ public:
+  Store() {
+    Bucket* buckets = buckets_;
+    for (size_t i = 0; i < TIER_COUNT; ++i) {
+      tiers_[i].Begin(buckets, TIER_BUCKETS[i], TIER_PERIODS_S[i]);
+      buckets += TIER_BUCKETS[i];
+    }
+  }
+
+  void Add(uint32_t epoch, float value) {
+    for (Tier& tier : tiers_) {
+      tier.Add(epoch, value);
+    }
+  }
+
+  // Drops every bucket, e.g. once the values are sampled in different units.
+  void Clear() {
+    for (Tier& tier : tiers_) {
+      tier.Clear();
+    }
+  }
+
+  const Tier& GetTier(size_t tier) const {
+    return tiers_[tier];
+  }
+
+ private:
+  Bucket buckets_[TOTAL_BUCKETS];
+  Tier tiers_[TIER_COUNT];
+};
+
+inline uint8_t* PutBucket(uint8_t* buffer, const Bucket& bucket) {
+  float variance = bucket.Variance();
+  uint32_t variance_bits;
+  memcpy(&variance_bits, &variance, sizeof(variance_bits));
+
+  buffer = telemetry::PutU32(buffer, bucket.start_epoch);
+  buffer = telemetry::PutU32(buffer, bucket.count);
+  buffer = telemetry::PutU32(buffer, (uint32_t)telemetry::ToFixedPoint(bucket.min));
+  buffer = telemetry::PutU32(buffer, (uint32_t)telemetry::ToFixedPoint(bucket.max));
+  buffer = telemetry::PutU32(buffer, (uint32_t)telemetry::ToFixedPoint(bucket.mean));
+  return telemetry::PutU32(buffer, variance_bits);
+}
+
+// Answers a rollup request by calling `send(frame, length)` for each rollup frame, at least one
+// even if no bucket matches. Returns false if `message` is not a rollup request.
+template <typename Send>
+bool HandleRequest(const Store& store, const uint8_t* message, size_t length, uint8_t node_id,
+                   Send send) {
+  telemetry::Header header;
+  uint8_t tier_index;
+  uint32_t since_epoch;
+  if (!telemetry::DecodeHeader(message, length, header) ||
+      header.type != telemetry::FrameType::ROLLUP_REQUEST ||
+      !telemetry::DecodeRollupRequest(message, length, tier_index, since_epoch)) {
+    return false;
+  }
+
+  uint32_t period_s = 0;
+  size_t first = 0;
+  size_t end = 0;
+  if (tier_index < TIER_COUNT) {
+    const Tier& tier = store.GetTier(tier_index);
+    period_s = tier.Period();
+    end = tier.Size();
+    while (first < end && (int32_t)(tier.At(first).start_epoch - since_epoch) < 0) {
+      ++first;
+    }
+  }
+
+  size_t frames = 1;
+  if (end - first > telemetry::MAX_ROLLUP_BUCKETS) {
+    frames = (end - first + telemetry::MAX_ROLLUP_BUCKETS - 1) / telemetry::MAX_ROLLUP_BUCKETS;
+  }
+
+  uint8_t frame[telemetry::MAX_ROLLUP_FRAME_SIZE];
+  for (size_t remaining = frames; remaining-- > 0;) {
+    size_t count = end - first;
+    if (count > telemetry::MAX_ROLLUP_BUCKETS) {
+      count = telemetry::MAX_ROLLUP_BUCKETS;
+    }
+
+    uint8_t* cursor = telemetry::PutHeader(frame, telemetry::FrameType::ROLLUP, node_id, 0,
+                                           header.sequence);
+    *cursor++ = tier_index;
+    *cursor++ = (uint8_t)remaining;
+    cursor = telemetry::PutU32(cursor, period_s);
+    *cursor++ = (uint8_t)count;
+    for (size_t i = 0; i < count; ++i) {
+      cursor = PutBucket(cursor, store.GetTier(tier_index).At(first + i));
+    }
+
+    first += count;
+    send(frame, (size_t)(cursor - frame));
+  }
+
+  return true;
+}
+
+} // rollup
+
+#endif // ROLLUP_H
@@ -2,16 +2,17 @@
 #define RTC_CONFIG_H
 
 #include <Arduino.h>
-#include <WiFiS3.h>
 
 #include "RTC.h"
-#include "state.h"
 
 namespace rtc_config {
 
-void WaitForClockConfiguration(WiFiUDP& udp,
-                    state::AppState& app_state, state::States transition_state);
+// Whether `epoch`, sent by a client, is a plausible time to set the clock to.
+bool IsValidEpoch(uint32_t epoch);
+
+// Sets the RTC to `epoch`.
+void SetClock(time_t epoch);
 
 } // rtc_config
 
-#endif RTC_CONFIG_H
\ No newline at end of file
+#endif RTC_CONFIG_H
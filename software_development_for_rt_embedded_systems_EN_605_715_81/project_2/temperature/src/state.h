@@ -3,55 +3,56 @@
 
 #include <Arduino.h>
 
+#include <atomic>
+
+#include "events.h"
+
 namespace state {
 
+// UNINITIALIZED waits for a client to set the clock, READY for a client to start a session and
+// DONE is between sessions, which can restart from there without setting the clock again.
 enum class States {
     UNKNOWN,
     UNINITIALIZED,
     TRANSMITTING,
-    CONNECTED,
     READY,
     DONE,
 };
 
+// The state, transmit interval and oversampling flag are packed into one word that is read and
+// written atomically, so the getters polled from loop() never mask interrupts and a reader always
+// sees a consistent combination. The Cortex-M4 does a 32 bit load or store in one instruction, and
+// updates of a single field go through a compare and swap.
 class AppState {
   public:
    explicit AppState() = default;
 
    void UpdateState(States state) {
-    noInterrupts();
-    state_ = state;
-    interrupts();
+    Update(STATE_SHIFT, STATE_MASK, (uint32_t)state);
    }
 
    void UpdateTransmitInterval(int interval) {
-    noInterrupts();
-    transmit_interval_ = interval;
-    interrupts();
+    Update(INTERVAL_SHIFT, INTERVAL_MASK, (uint32_t)interval);
    }
 
    int GetTransmitInterval() const {
-    int curr_interval;
-    noInterrupts();
-    curr_interval = transmit_interval_;
-    interrupts();
+    return (packed_.load(std::memory_order_acquire) >> INTERVAL_SHIFT) & INTERVAL_MASK;
+   }
 
-    return curr_interval;
+   void UpdateOversampling(bool oversampling) {
+    Update(OVERSAMPLING_SHIFT, OVERSAMPLING_MASK, oversampling);
    }
 
-   States GetState() {
-    States return_state;
-    noInterrupts();
-    return_state = state_;
-    interrupts();
+   bool IsOversampling() const {
+    return (packed_.load(std::memory_order_acquire) >> OVERSAMPLING_SHIFT) & OVERSAMPLING_MASK;
+   }
 
-    return return_state;
+   States GetState() const {
+    return (States)((packed_.load(std::memory_order_acquire) >> STATE_SHIFT) & STATE_MASK);
    }
 
    static char* GetStateString(States state) {
     switch (state) {
-      case States::CONNECTED:
-        return "CONNECTED";
       case States::DONE:
         return "DONE";
       case States::READY:
@@ -65,25 +66,67 @@ class AppState {
     }
    }
 
-   char* GetStateString() {
+   char* GetStateString() const {
     return GetStateString(GetState());
    }
 
  private:
-  States state_ = States::UNINITIALIZED;
-  int transmit_interval_ = 10;
+  static constexpr uint32_t STATE_SHIFT = 0;
+  static constexpr uint32_t STATE_MASK = 0xFF;
+  // Seconds between transmitted samples.
+  static constexpr uint32_t INTERVAL_SHIFT = 8;
+  static constexpr uint32_t INTERVAL_MASK = 0xFFFF;
+  // Read the sensor as fast as it allows and transmit the average of each interval.
+  static constexpr uint32_t OVERSAMPLING_SHIFT = 24;
+  static constexpr uint32_t OVERSAMPLING_MASK = 0x1;
+
+  static constexpr uint32_t Pack(States state, uint32_t interval, bool oversampling) {
+    return (uint32_t)state << STATE_SHIFT | interval << INTERVAL_SHIFT |
+           (uint32_t)oversampling << OVERSAMPLING_SHIFT;
+  }
+
+  void Update(uint32_t shift, uint32_t mask, uint32_t value) {
+    uint32_t current = packed_.load(std::memory_order_relaxed);
+    uint32_t desired;
+    do {
+      desired = (current & ~(mask << shift)) | (value & mask) << shift;
+    } while (!packed_.compare_exchange_weak(current, desired, std::memory_order_acq_rel,
+                                            std::memory_order_relaxed));
+  }
+
+  std::atomic<uint32_t> packed_{Pack(States::UNINITIALIZED, 10, false)};
+  static_assert(std::atomic<uint32_t>::is_always_lock_free, "AppState must not need a lock");
 };
 
-inline bool ReadyToTransmitOptions(AppState& app_state) {
-  return app_state.GetState() == States::CONNECTED;
-};
+using Action = void (*)(const events::Event& event);
 
-inline bool ReadyToTransmitTemp(AppState& app_state) {
-  return app_state.GetState() == States::READY;
+// One row of a transition table: in state `from`, `event` runs `action`, if any, and then moves to
+// state `to`.
+struct Transition {
+  States from;
+  events::Type event;
+  States to;
+  Action action;
 };
 
-inline bool ClientSignaledDone(AppState& app_state) {
-  return app_state.GetState() == States::DONE;
+// Runs the first transition of `table` that matches the current state and `event`. Returns false if
+// there is none, in which case the event is ignored and the state left as is.
+template <size_t N>
+bool Dispatch(AppState& app_state, const Transition (&table)[N], const events::Event& event) {
+  States current = app_state.GetState();
+  for (const Transition& transition : table) {
+    if (transition.from != current || transition.event != event.type) {
+      continue;
+    }
+
+    if (transition.action != nullptr) {
+      transition.action(event);
+    }
+    app_state.UpdateState(transition.to);
+    return true;
+  }
+
+  return false;
 }
 
 } // state
@@ -0,0 +1,515 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed layout binary frames sent to the client in place of "<date>, <value>" CSV strings. Every
+// field is little endian and the layout is mirrored by the Python client in data_handler.py.
+//
+// Sample frame (SAMPLE_FRAME_SIZE bytes):
+//   offset  size  field
+//   0       1     version       PROTOCOL_VERSION
+//   1       1     type          FrameType::SAMPLE
+//   2       1     node id       identifies the sending node
+//   3       1     flags         FLAG_* bits, 0 for a live sample
+//   4       4     sequence      incremented for every frame a node sends
+//   8       4     epoch         seconds since 1970-01-01 UTC
+//   12      2     milliseconds  0 - 999 within the epoch second
+//   14      4     value         signed fixed point, value * VALUE_SCALE
+//
+// Batch frame (BatchFrameSize(count) bytes), several samples in one datagram:
+//   0       8     header        as above with FrameType::BATCH
+//   8       4     epoch         of the first sample
+//   12      2     milliseconds  of the first sample
+//   14      1     count         number of samples that follow, at most MAX_BATCH_SAMPLES
+//   15      8 * count           per sample: u32 milliseconds since the first sample, i32 value
+//
+// Subscribe message (SUBSCRIBE_SIZE bytes), client to node. Subscribing again renews the lease:
+//   0       8     header        FrameType::SUBSCRIBE, node id 0, sequence chosen by the client
+//   8       2     lease         seconds until the subscription expires unless renewed
+//   10      1     rate divider  only every n-th frame is sent to the subscriber, at least 1
+//
+// Unsubscribe message (HEADER_SIZE bytes), client to node: the header with FrameType::UNSUBSCRIBE.
+//
+// Subscribe ack (SUBSCRIBE_ACK_SIZE bytes), node to client, answering either message:
+//   0       8     header        FrameType::SUBSCRIBE_ACK, sequence of the message it answers
+//   8       1     status        SubscribeStatus
+//   9       2     lease         seconds granted, 0 after unsubscribing
+//
+// Stats request (HEADER_SIZE bytes), client to node: the header with FrameType::STATS.
+//
+// Stats frame (STATS_FRAME_SIZE bytes), node to client, two histograms of microsecond durations:
+//   0       8     header        FrameType::STATS, sequence of the request it answers
+//   8       72    histogram     timer ISR entry jitter
+//   80      72    histogram     time spent with interrupts disabled
+// Each histogram is a u32 count, the u32 maximum and HISTOGRAM_BUCKETS u32 bucket counts. Bucket 0
+// holds 0us, bucket i holds [2^(i-1), 2^i) and the last bucket everything above.
+//
+// Time request (TIME_REQUEST_SIZE bytes), node to client, see time_sync.h:
+//   0       8     header        FrameType::TIME_REQUEST, sequence identifies the round
+//   8       4     t1            node's local time in microseconds, low 32 bits
+//
+// Time response (TIME_RESPONSE_SIZE bytes), client to node:
+//   0       8     header        FrameType::TIME_RESPONSE, sequence of the request
+//   8       4     t1            copied from the request
+//   12      8     t2            client time the request was received, microseconds since the epoch
+//   20      8     t3            client time the response was sent, microseconds since the epoch
+//
+// Nack (NACK_SIZE bytes), client to node, asks for sample and batch frames it missed again:
+//   0       8     header        FrameType::NACK, sequence chosen by the client
+//   8       4     first         sequence of the first missing frame
+//   12      4     bitmap        bit i set if frame first + i is missing, bit 0 is always set
+//
+// Rollup request (ROLLUP_REQUEST_SIZE bytes), client to node, see rollup.h:
+//   0       8     header        FrameType::ROLLUP_REQUEST, sequence chosen by the client
+//   8       1     tier          index of the rollup tier, 0 is the shortest period
+//   9       4     since         epoch seconds, only buckets starting at or after it are sent
+//
+// Rollup frame (RollupFrameSize(count) bytes), node to client, as many as the buckets need:
+//   0       8     header        FrameType::ROLLUP, sequence of the request it answers
+//   8       1     tier          as requested
+//   9       1     remaining     rollup frames that still follow for the request
+//   10      4     period        seconds covered by each bucket, 0 for an unknown tier
+//   14      1     count         buckets that follow, at most MAX_ROLLUP_BUCKETS
+//   15      24 * count          per bucket, oldest first: u32 start epoch, u32 sample count,
+//                               i32 min, i32 max, i32 mean, all fixed point like a sample's
+//                               value, and the f32 sample variance in value units squared
+//
+// Command (HEADER_SIZE + 1 + CommandArgsSize(opcode) bytes), client to node, configures the node
+// at runtime. Every command is answered with a command ack:
+//   0       8     header        FrameType::COMMAND, sequence is the request id
+//   8       1     opcode        Opcode
+//   9       ...   arguments     per opcode:
+//     SET_CLOCK          u32 epoch seconds, the sender becomes the node's time server
+//     START, STOP        none, start and end a session on nodes that have sessions
+//     SET_INTERVAL       u32 milliseconds between samples
+//     SET_OVERSAMPLING   u8 0 or 1
+//     SET_BATCH          u8 samples per datagram, u32 maximum batch age in milliseconds
+//     SET_DEADBAND       i32 fixed point threshold, u32 heartbeat interval in milliseconds
+//     SET_UNITS          u8 Units
+//     ADD_SUBSCRIBER     4 byte IPv4 address in network order, u16 port, u16 lease seconds,
+//                        u8 rate divider, subscribes any client, not just the sender
+//     REMOVE_SUBSCRIBER  4 byte IPv4 address, u16 port
+//     GET_COUNTERS       none
+//     GET_VERSION        none
+//
+// Command ack (COMMAND_ACK_HEADER_SIZE + result bytes), node to client:
+//   0       8     header        FrameType::COMMAND_ACK, sequence is the request id it answers
+//   8       1     opcode        as in the command
+//   9       1     status        CommandStatus, the result is only present for OK
+//   10      ...   result        per opcode:
+//     ADD_SUBSCRIBER     u16 lease seconds granted
+//     GET_COUNTERS       u8 count, then count u32 values indexed by Counter
+//     GET_VERSION        u8 protocol version, u8 firmware major, minor and patch, u8 Units
+//     others             none
+//
+// Sample and batch frames share one sequence counter per node, so a gap in it is a lost frame. The
+// node keeps its last frames in a retransmit window (see retransmit.h) and sends the ones a nack
+// asks for again, unchanged except for FLAG_RETRANSMIT. Samples replayed from the flash log (see
+// flash_log.h) are sent as regular sample and batch frames with FLAG_REPLAY set, so the client can
+// tell them from live ones. With deadband compression (see deadband.h) a frame whose samples were
+// only sent because the heartbeat interval ran out has FLAG_HEARTBEAT set.
+//
+// Frames are encoded into a caller provided stack buffer and sent with a single write, so no heap
+// is used and the WiFi bridge sees one transaction per frame.
+
+namespace telemetry {
+
+inline constexpr uint8_t PROTOCOL_VERSION = 1;
+inline constexpr int32_t VALUE_SCALE = 100;
+
+// Header flag bits.
+inline constexpr uint8_t FLAG_REPLAY = 0x01;
+inline constexpr uint8_t FLAG_RETRANSMIT = 0x02;
+inline constexpr uint8_t FLAG_HEARTBEAT = 0x04;
+
+enum class FrameType : uint8_t {
+  SAMPLE = 1,
+  BATCH = 2,
+  SUBSCRIBE = 3,
+  UNSUBSCRIBE = 4,
+  SUBSCRIBE_ACK = 5,
+  STATS = 6,
+  TIME_REQUEST = 7,
+  TIME_RESPONSE = 8,
+  NACK = 9,
+  ROLLUP_REQUEST = 10,
+  ROLLUP = 11,
+  COMMAND = 12,
+  COMMAND_ACK = 13,
+};
+
+enum class Opcode : uint8_t {
+  SET_CLOCK = 1,
+  START = 2,
+  STOP = 3,
+  SET_INTERVAL = 4,
+  SET_OVERSAMPLING = 5,
+  SET_BATCH = 6,
+  SET_DEADBAND = 7,
+  SET_UNITS = 8,
+  ADD_SUBSCRIBER = 9,
+  REMOVE_SUBSCRIBER = 10,
+  GET_COUNTERS = 11,
+  GET_VERSION = 12,
+};
+
+enum class CommandStatus : uint8_t {
+  OK = 0,
+  UNKNOWN_OPCODE = 1,
+  // The arguments are the wrong length or out of range.
+  INVALID_ARGUMENT = 2,
+  // Not possible in the node's current state, e.g. stopping a session that was never started.
+  INVALID_STATE = 3,
+  // The node does not have the setting, e.g. oversampling on a node without it.
+  UNSUPPORTED = 4,
+  // A command that got no room in the node's queue, retry it.
+  BUSY = 5,
+};
+
+enum class Units : uint8_t {
+  CELSIUS = 1,
+  FAHRENHEIT = 2,
+};
+
+// Order of the GET_COUNTERS result. Counters a node does not keep are 0.
+enum class Counter : uint8_t {
+  UPTIME_S,
+  SAMPLES_TAKEN,
+  SAMPLES_SENT,
+  DATAGRAMS_SENT,
+  EVENTS_DROPPED,
+  LOG_PENDING,
+  LOG_OVERWRITTEN,
+  SUBSCRIBERS,
+  COUNT,
+};
+
+enum class SubscribeStatus : uint8_t {
+  OK = 0,
+  TABLE_FULL = 1,
+  NOT_SUBSCRIBED = 2,
+};
+
+struct Header {
+  uint8_t version;
+  FrameType type;
+  uint8_t node_id;
+  uint8_t flags;
+  uint32_t sequence;
+};
+
+inline constexpr size_t HEADER_SIZE = 8;
+inline constexpr size_t SAMPLE_FRAME_SIZE = HEADER_SIZE + 10;
+
+inline constexpr size_t MAX_BATCH_SAMPLES = 32;
+inline constexpr size_t BATCH_HEADER_SIZE = HEADER_SIZE + 7;
+inline constexpr size_t BATCH_SAMPLE_SIZE = 8;
+
+constexpr size_t BatchFrameSize(size_t count) {
+  return BATCH_HEADER_SIZE + count * BATCH_SAMPLE_SIZE;
+}
+
+inline constexpr size_t MAX_BATCH_FRAME_SIZE = BatchFrameSize(MAX_BATCH_SAMPLES);
+
+inline constexpr size_t SUBSCRIBE_SIZE = HEADER_SIZE + 3;
+inline constexpr size_t SUBSCRIBE_ACK_SIZE = HEADER_SIZE + 3;
+
+inline constexpr size_t TIME_REQUEST_SIZE = HEADER_SIZE + 4;
+inline constexpr size_t TIME_RESPONSE_SIZE = HEADER_SIZE + 20;
+
+inline constexpr size_t NACK_SIZE = HEADER_SIZE + 8;
+inline constexpr size_t NACK_BITMAP_FRAMES = 32;
+
+inline constexpr size_t ROLLUP_REQUEST_SIZE = HEADER_SIZE + 5;
+inline constexpr size_t ROLLUP_HEADER_SIZE = HEADER_SIZE + 7;
+inline constexpr size_t ROLLUP_BUCKET_SIZE = 24;
+// Keeps a rollup frame below 1 KB.
+inline constexpr size_t MAX_ROLLUP_BUCKETS = 40;
+
+constexpr size_t RollupFrameSize(size_t count) {
+  return ROLLUP_HEADER_SIZE + count * ROLLUP_BUCKET_SIZE;
+}
+
+inline constexpr size_t MAX_ROLLUP_FRAME_SIZE = RollupFrameSize(MAX_ROLLUP_BUCKETS);
+
+inline constexpr size_t COMMAND_HEADER_SIZE = HEADER_SIZE + 1;
+inline constexpr size_t COMMAND_ACK_HEADER_SIZE = HEADER_SIZE + 2;
+inline constexpr size_t MAX_COMMAND_ACK_SIZE =
+    COMMAND_ACK_HEADER_SIZE + 1 + 4 * (size_t)Counter::COUNT;
+
+inline constexpr size_t HISTOGRAM_BUCKETS = 16;
+inline constexpr size_t HISTOGRAM_SIZE = (2 + HISTOGRAM_BUCKETS) * 4;
+inline constexpr size_t STATS_FRAME_SIZE = HEADER_SIZE + 2 * HISTOGRAM_SIZE;
+
+struct Histogram {
+  uint32_t count;
+  uint32_t max_us;
+  uint32_t buckets[HISTOGRAM_BUCKETS];
+};
+
+struct Command {
+  uint32_t request_id;
+  Opcode opcode;
+  // Points into the received message, CommandArgsSize(opcode) bytes.
+  const uint8_t* args;
+};
+
+struct Sample {
+  uint32_t epoch;
+  uint16_t millis;
+  float value;
+};
+
+inline uint8_t* PutU16(uint8_t* buffer, uint16_t value) {
+  buffer[0] = value & 0xFF;
+  buffer[1] = value >> 8;
+  return buffer + 2;
+}
+
+inline uint8_t* PutU32(uint8_t* buffer, uint32_t value) {
+  buffer[0] = value & 0xFF;
+  buffer[1] = (value >> 8) & 0xFF;
+  buffer[2] = (value >> 16) & 0xFF;
+  buffer[3] = value >> 24;
+  return buffer + 4;
+}
+
+inline uint8_t* PutU64(uint8_t* buffer, uint64_t value) {
+  buffer = PutU32(buffer, (uint32_t)value);
+  return PutU32(buffer, (uint32_t)(value >> 32));
+}
+
+inline uint16_t GetU16(const uint8_t* buffer) {
+  return buffer[0] | (uint16_t)buffer[1] << 8;
+}
+
+inline uint32_t GetU32(const uint8_t* buffer) {
+  return buffer[0] | (uint32_t)buffer[1] << 8 | (uint32_t)buffer[2] << 16 |
+         (uint32_t)buffer[3] << 24;
+}
+
+inline uint64_t GetU64(const uint8_t* buffer) {
+  return GetU32(buffer) | (uint64_t)GetU32(buffer + 4) << 32;
+}
+
+// Converts a reading to the fixed point representation carried on the wire, rounding to nearest.
+inline int32_t ToFixedPoint(float value) {
+  float scaled = value * VALUE_SCALE;
+  return (int32_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+inline float FromFixedPoint(int32_t value) {
+  return (float)value / VALUE_SCALE;
+}
+
+inline uint8_t* PutHeader(uint8_t* buffer, FrameType type, uint8_t node_id, uint8_t flags,
+                          uint32_t sequence) {
+  buffer[0] = PROTOCOL_VERSION;
+  buffer[1] = (uint8_t)type;
+  buffer[2] = node_id;
+  buffer[3] = flags;
+  return PutU32(buffer + 4, sequence);
+}
+
+// Decodes the header of a received message. Returns false if it is too short or of another
+// protocol version, e.g. a text message.
+inline bool DecodeHeader(const uint8_t* buffer, size_t length, Header& header) {
+  if (length < HEADER_SIZE || buffer[0] != PROTOCOL_VERSION) {
+    return false;
+  }
+
+  header.version = buffer[0];
+  header.type = (FrameType)buffer[1];
+  header.node_id = buffer[2];
+  header.flags = buffer[3];
+  header.sequence = GetU32(buffer + 4);
+  return true;
+}
+
+// Decodes the body of a subscribe message. Returns false if it is too short.
+inline bool DecodeSubscribe(const uint8_t* buffer, size_t length, uint16_t& lease_s,
+                            uint8_t& rate_divider) {
+  if (length < SUBSCRIBE_SIZE) {
+    return false;
+  }
+
+  lease_s = GetU16(buffer + HEADER_SIZE);
+  rate_divider = buffer[HEADER_SIZE + 2];
+  return true;
+}
+
+inline size_t EncodeSubscribeAck(uint8_t* buffer, uint8_t node_id, uint32_t sequence,
+                                 SubscribeStatus status, uint16_t lease_s) {
+  uint8_t* cursor = PutHeader(buffer, FrameType::SUBSCRIBE_ACK, node_id, 0, sequence);
+  *cursor++ = (uint8_t)status;
+  cursor = PutU16(cursor, lease_s);
+  return cursor - buffer;
+}
+
+inline uint8_t* PutHistogram(uint8_t* buffer, const Histogram& histogram) {
+  buffer = PutU32(buffer, histogram.count);
+  buffer = PutU32(buffer, histogram.max_us);
+  for (uint32_t bucket : histogram.buckets) {
+    buffer = PutU32(buffer, bucket);
+  }
+  return buffer;
+}
+
+inline size_t EncodeStats(uint8_t* buffer, uint8_t node_id, uint32_t sequence,
+                          const Histogram& timer_jitter, const Histogram& interrupts_off) {
+  uint8_t* cursor = PutHeader(buffer, FrameType::STATS, node_id, 0, sequence);
+  cursor = PutHistogram(cursor, timer_jitter);
+  cursor = PutHistogram(cursor, interrupts_off);
+  return cursor - buffer;
+}
+
+inline size_t EncodeTimeRequest(uint8_t* buffer, uint8_t node_id, uint32_t sequence,
+                                uint32_t t1_us) {
+  uint8_t* cursor = PutHeader(buffer, FrameType::TIME_REQUEST, node_id, 0, sequence);
+  cursor = PutU32(cursor, t1_us);
+  return cursor - buffer;
+}
+
+// Decodes the body of a time response. Returns false if it is too short.
+inline bool DecodeTimeResponse(const uint8_t* buffer, size_t length, uint32_t& t1_us,
+                               int64_t& t2_us, int64_t& t3_us) {
+  if (length < TIME_RESPONSE_SIZE) {
+    return false;
+  }
+
+  t1_us = GetU32(buffer + HEADER_SIZE);
+  t2_us = (int64_t)GetU64(buffer + HEADER_SIZE + 4);
+  t3_us = (int64_t)GetU64(buffer + HEADER_SIZE + 12);
+  return true;
+}
+
+inline bool DecodeNack(const uint8_t* buffer, size_t length, uint32_t& first, uint32_t& bitmap) {
+  if (length < NACK_SIZE) {
+    return false;
+  }
+
+  first = GetU32(buffer + HEADER_SIZE);
+  bitmap = GetU32(buffer + HEADER_SIZE + 4);
+  return true;
+}
+
+inline bool DecodeRollupRequest(const uint8_t* buffer, size_t length, uint8_t& tier,
+                                uint32_t& since_epoch) {
+  if (length < ROLLUP_REQUEST_SIZE) {
+    return false;
+  }
+
+  tier = buffer[HEADER_SIZE];
+  since_epoch = GetU32(buffer + HEADER_SIZE + 1);
+  return true;
+}
+
+// Size of the arguments of `opcode`, or -1 for an unknown opcode.
+inline int CommandArgsSize(Opcode opcode) {
+  switch (opcode) {
+    case Opcode::START:
+    case Opcode::STOP:
+    case Opcode::GET_COUNTERS:
+    case Opcode::GET_VERSION:
+      return 0;
+    case Opcode::SET_OVERSAMPLING:
+    case Opcode::SET_UNITS:
+      return 1;
+    case Opcode::SET_CLOCK:
+    case Opcode::SET_INTERVAL:
+      return 4;
+    case Opcode::SET_BATCH:
+      return 5;
+    case Opcode::REMOVE_SUBSCRIBER:
+      return 6;
+    case Opcode::SET_DEADBAND:
+      return 8;
+    case Opcode::ADD_SUBSCRIBER:
+      return 9;
+  }
+
+  return -1;
+}
+
+// Decodes a command. Returns false if `buffer` is not a command. A command with an unknown opcode
+// or arguments of the wrong length decodes with `status` set to the error to answer with.
+inline bool DecodeCommand(const uint8_t* buffer, size_t length, Command& command,
+                          CommandStatus& status) {
+  Header header;
+  if (!DecodeHeader(buffer, length, header) || header.type != FrameType::COMMAND ||
+      length < COMMAND_HEADER_SIZE) {
+    return false;
+  }
+
+  command.request_id = header.sequence;
+  command.opcode = (Opcode)buffer[HEADER_SIZE];
+  command.args = buffer + COMMAND_HEADER_SIZE;
+  int args_size = CommandArgsSize(command.opcode);
+  if (args_size < 0) {
+    status = CommandStatus::UNKNOWN_OPCODE;
+  } else if (length != COMMAND_HEADER_SIZE + args_size) {
+    status = CommandStatus::INVALID_ARGUMENT;
+  } else {
+    status = CommandStatus::OK;
+  }
+  return true;
+}
+
+// Encodes a command ack with `result_length` bytes of result, which are only sent for OK. `buffer`
+// must hold MAX_COMMAND_ACK_SIZE bytes. Returns the number of bytes written.
+inline size_t EncodeCommandAck(uint8_t* buffer, uint8_t node_id, uint32_t request_id,
+                               Opcode opcode, CommandStatus status, const uint8_t* result,
+                               size_t result_length) {
+  uint8_t* cursor = PutHeader(buffer, FrameType::COMMAND_ACK, node_id, 0, request_id);
+  *cursor++ = (uint8_t)opcode;
+  *cursor++ = (uint8_t)status;
+  if (status == CommandStatus::OK) {
+    for (size_t i = 0; i < result_length; ++i) {
+      *cursor++ = result[i];
+    }
+  }
+  return cursor - buffer;
+}
+
+// Encodes a sample frame into `buffer`, which must hold at least SAMPLE_FRAME_SIZE bytes. Returns
+// the number of bytes written.
+inline size_t EncodeSample(uint8_t* buffer, uint8_t node_id, uint32_t sequence,
+                           const Sample& sample, uint8_t flags = 0) {
+  uint8_t* cursor = PutHeader(buffer, FrameType::SAMPLE, node_id, flags, sequence);
+  cursor = PutU32(cursor, sample.epoch);
+  cursor = PutU16(cursor, sample.millis);
+  cursor = PutU32(cursor, (uint32_t)ToFixedPoint(sample.value));
+  return cursor - buffer;
+}
+
+// Milliseconds from `first` to `sample`.
+inline uint32_t MillisBetween(const Sample& first, const Sample& sample) {
+  return (sample.epoch - first.epoch) * 1000 + sample.millis - first.millis;
+}
+
+// Encodes up to MAX_BATCH_SAMPLES samples into one batch frame. `buffer` must hold at least
+// BatchFrameSize(count) bytes. Returns the number of bytes written.
+inline size_t EncodeBatch(uint8_t* buffer, uint8_t node_id, uint32_t sequence,
+                          const Sample* samples, size_t count, uint8_t flags = 0) {
+  if (count > MAX_BATCH_SAMPLES) {
+    count = MAX_BATCH_SAMPLES;
+  }
+
+  uint8_t* cursor = PutHeader(buffer, FrameType::BATCH, node_id, flags, sequence);
+  cursor = PutU32(cursor, count ? samples[0].epoch : 0);
+  cursor = PutU16(cursor, count ? samples[0].millis : 0);
+  *cursor++ = (uint8_t)count;
+
+  for (size_t i = 0; i < count; ++i) {
+    cursor = PutU32(cursor, MillisBetween(samples[0], samples[i]));
+    cursor = PutU32(cursor, (uint32_t)ToFixedPoint(samples[i].value));
+  }
+
+  return cursor - buffer;
+}
+
+} // namespace telemetry
+
+#endif // TELEMETRY_H
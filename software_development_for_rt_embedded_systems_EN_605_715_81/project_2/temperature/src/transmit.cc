@@ -1,65 +1,125 @@
 #include <Arduino.h>
 #include <WiFiS3.h>
 
-#include "state.h"
+#include "configurations.h"
+#include "latency.h"
+#include "node_clock.h"
+#include "retransmit.h"
+#include "rollup.h"
+#include "subscribers.h"
+#include "telemetry.h"
+#include "transmit.h"
 
 namespace transmit {
 
-void Transmit(WiFiUDP& udp, std::initializer_list<const char*> messages) {
+// Sends an already encoded binary frame as one datagram with a single write.
+void Transmit(WiFiUDP& udp, const uint8_t* data, size_t length) {
     udp.beginPacket(udp.remoteIP(), udp.remotePort());
-    for (const char* msg : messages) {
-        udp.print(msg);
-    }
+    udp.write(data, length);
     udp.endPacket();
 }
 
-void TransmitOptions(WiFiUDP& udp) {
-    Serial.println("Transmitting options");
-    Transmit(udp, {"Menu Options:\n",
-                  "1. Start Temperature Transmission\n",
-                  "2. End Temperature Transmission\n"});
-};
+// Sends an encoded telemetry frame to every subscriber it is due for, or once to the multicast
+// group when that is enabled. Replayed frames go to every subscriber, rate dividers only thin out
+// live samples.
+void Publish(WiFiUDP& udp, subscribers::Table& subscribers, const uint8_t* data, size_t length,
+             bool replay) {
+    if (config::MULTICAST_ENABLED) {
+        const uint8_t* group = config::MULTICAST_GROUP;
+        udp.beginPacket(IPAddress(group[0], group[1], group[2], group[3]), config::MULTICAST_PORT);
+        udp.write(data, length);
+        udp.endPacket();
+        return;
+    }
+
+    auto send = [&](const subscribers::Subscriber& subscriber) {
+        udp.beginPacket(IPAddress(subscriber.address), subscriber.port);
+        udp.write(data, length);
+        udp.endPacket();
+    };
+    if (replay) {
+        subscribers.ForEach(send);
+    } else {
+        subscribers.ForEachDue(send);
+    }
+}
+
+void SendCommandAck(WiFiUDP& udp, uint32_t address, uint16_t port, uint32_t request_id,
+                    telemetry::Opcode opcode, telemetry::CommandStatus status,
+                    const uint8_t* result, size_t result_length) {
+    uint8_t ack[telemetry::MAX_COMMAND_ACK_SIZE];
+    size_t ack_length = telemetry::EncodeCommandAck(ack, config::NODE_ID, request_id, opcode,
+                                                    status, result, result_length);
+    udp.beginPacket(IPAddress(address), port);
+    udp.write(ack, ack_length);
+    udp.endPacket();
+}
 
-void ListenForOption(WiFiUDP& udp, state::AppState& app_state) {
-    state::States curr_state = app_state.GetState();
-    if (curr_state != state::States::READY) {
-        Serial.print("Current state: ");
-        Serial.print(app_state.GetStateString(curr_state));
-        Serial.println(" is not valid state for listening for options");
+void ListenForPacket(WiFiUDP& udp, subscribers::Table& subscribers,
+                     retransmit::Window& retransmit_window, const rollup::Store& rollups,
+                     CommandHandler handle_command) {
+    uint8_t udp_packet[256];
 
+    if (!udp.parsePacket()) {
         return;
     }
+    uint32_t received_us = micros();
 
-    char udp_packet[256];
+    int dataLen = udp.read(udp_packet, sizeof(udp_packet));
+    if (dataLen < 0) {
+        return;
+    }
 
-    if (udp.parsePacket()) {
-        int dataLen = udp.available();
-        udp.read(udp_packet, 255);
-        udp_packet[dataLen] = '\0';
+    if (node_clock::HandleMessage(udp_packet, dataLen, received_us)) {
+        return;
+    }
 
-        Serial.print("Received option ");
-        Serial.println(udp_packet);
+    uint8_t ack[telemetry::SUBSCRIBE_ACK_SIZE];
+    size_t ack_length = subscribers::HandleMessage(subscribers, udp_packet, dataLen,
+                                                   (uint32_t)udp.remoteIP(), udp.remotePort(),
+                                                   config::NODE_ID, millis(), ack);
+    if (ack_length != 0) {
+        Transmit(udp, ack, ack_length);
+        Serial.print("Subscribers: ");
+        Serial.println(subscribers.Count());
+        return;
+    }
 
-        char* end_ptr;
-        unsigned int option = strtol(udp_packet, &end_ptr, 10);
+    auto reply = [&](const uint8_t* frame, size_t length) {
+        Transmit(udp, frame, length);
+    };
+    if (retransmit::HandleNack(retransmit_window, udp_packet, dataLen, reply) ||
+        rollup::HandleRequest(rollups, udp_packet, dataLen, config::NODE_ID, reply)) {
+        return;
+    }
 
-        if (option == 1) {
-            app_state.UpdateState(state::States::TRANSMITTING);
-            Transmit(udp, {"Option 1 Accepted"});
-            Serial.println("Option 1 Selected");
-            return;
-        }
+    telemetry::Header header;
+    if (telemetry::DecodeHeader(udp_packet, dataLen, header) &&
+        header.type == telemetry::FrameType::STATS) {
+        uint8_t stats[telemetry::STATS_FRAME_SIZE];
+        size_t stats_length = telemetry::EncodeStats(
+            stats, config::NODE_ID, header.sequence, latency::timer_jitter.Snapshot(),
+            latency::interrupts_off.Snapshot());
+        Transmit(udp, stats, stats_length);
+        return;
+    }
 
-        if (option == 2) {
-            app_state.UpdateState(state::States::DONE);
-            Transmit(udp, {"Option 2 Accepted"});
-            Serial.println("Option 2 Selected");
-            return;
-        }
+    telemetry::Command command;
+    telemetry::CommandStatus status;
+    if (!telemetry::DecodeCommand(udp_packet, dataLen, command, status)) {
+        Serial.println("Ignoring unknown packet");
+        return;
+    }
 
-        Transmit(udp, {"Invalid option provided: ", udp_packet});
+    Serial.print("Received command ");
+    Serial.println((int)command.opcode);
+    if (status != telemetry::CommandStatus::OK) {
+        SendCommandAck(udp, (uint32_t)udp.remoteIP(), udp.remotePort(), command.request_id,
+                       command.opcode, status);
         return;
     }
-};
 
-} // transmit
\ No newline at end of file
+    handle_command(command, (uint32_t)udp.remoteIP(), udp.remotePort());
+}
+
+} // transmit
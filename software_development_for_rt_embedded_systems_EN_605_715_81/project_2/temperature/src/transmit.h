@@ -1,12 +1,32 @@
 #ifndef TRANSMIT_H
 #define TRANSMIT_H
 
+#include "retransmit.h"
+#include "rollup.h"
+#include "subscribers.h"
+#include "telemetry.h"
+
 namespace transmit {
 
-void TransmitOptions(WiFiUDP& udp);
+// Carries out a well formed command from `address`:`port` and acks it with SendCommandAck(), right
+// away or once the state machine handled it.
+using CommandHandler = void (*)(const telemetry::Command& command, uint32_t address,
+                                uint16_t port);
 
-void ListenForOption(WiFiUDP& udp, state::AppState& app_state);
-void Transmit(WiFiUDP& udp, std::initializer_list<const char*> messages);
+// Reads at most one packet. Time responses go to node_clock. Subscribe, unsubscribe and stats
+// messages, nacks for frames in `retransmit_window` and requests for `rollups` are answered right
+// away. Commands go to `handle_command`, those with an unknown opcode or malformed arguments are
+// rejected here.
+void ListenForPacket(WiFiUDP& udp, subscribers::Table& subscribers,
+                     retransmit::Window& retransmit_window, const rollup::Store& rollups,
+                     CommandHandler handle_command);
+void Transmit(WiFiUDP& udp, const uint8_t* data, size_t length);
+// Acks the command `request_id` to `address`:`port`. `result` is only sent with CommandStatus::OK.
+void SendCommandAck(WiFiUDP& udp, uint32_t address, uint16_t port, uint32_t request_id,
+                    telemetry::Opcode opcode, telemetry::CommandStatus status,
+                    const uint8_t* result = nullptr, size_t result_length = 0);
+void Publish(WiFiUDP& udp, subscribers::Table& subscribers, const uint8_t* data, size_t length,
+             bool replay = false);
 
 } // namespace transmit
 
@@ -7,25 +7,57 @@ import matplotlib.pyplot as plt
 from matplotlib.animation import FuncAnimation
 
 
-from data_handler import DataManager
-from networking import setup_socket, send_unix_time, receive_data
+from data_handler import (DataManager, encode_command_line, encode_rollup_request,
+                          encode_stats_request, format_link_stats)
+from networking import (setup_socket, send_unix_time, send_command_line, receive_data,
+                        join_multicast, keep_subscribed)
 from plotting import setup_plot, update_plot
 
 # NOTE: SET THE IP ADDRESS TO WHATEVER THE MICROCONTROLLER OUTPUTS
 HOST = "192.168.1.37"
 PORT = 12345
 PLOT_INTERVAL_MS = 1000
+# Seconds the node keeps sending without a renewal, and to receive only every n-th frame.
+SUBSCRIPTION_LEASE_S = 60
+RATE_DIVIDER = 1
+# Set to the node's group when it is built with MULTICAST_ENABLED.
+MULTICAST_GROUP = None
 
 stop_receiving = threading.Event() # Use a thread-safe Event for stopping
 user_input_value = None 
 
-def input_thread(stop_event):
-    """Thread to get user input (e.g., '2' to stop) without blocking the plot."""
+def request_rollups(my_socket, command):
+    """Asks the node for a rollup tier, 'r <tier> [hours]' with tier 0 - 2 for 10 s, 1 min and
+    1 h buckets. Without hours every bucket the node keeps is sent."""
+    fields = command.split()
+    try:
+        tier = int(fields[1]) if len(fields) > 1 else 0
+        hours = float(fields[2]) if len(fields) > 2 else None
+    except ValueError:
+        print("Usage: r <tier> [hours]")
+        return
+
+    since_epoch = int(time.time() - hours * 3600) if hours is not None else 0
+    my_socket.sendto(encode_rollup_request(0, tier, since_epoch), (HOST, PORT))
+
+def input_thread(my_socket, stop_event):
+    """Thread to send commands (e.g., 'i 5' for a 5 s interval, '2' to stop) to the node without
+    blocking the plot. See encode_command_line for every command."""
     global user_input_value
     print("\n--- Input Thread Started ---")
     while not stop_event.is_set():
         try:
             user_input_value = input().strip()
+            if user_input_value == "s":
+                my_socket.sendto(encode_stats_request(0), (HOST, PORT))
+            elif user_input_value.startswith("r"):
+                request_rollups(my_socket, user_input_value)
+            elif user_input_value:
+                try:
+                    if not send_command_line(my_socket, HOST, PORT, user_input_value):
+                        print(encode_command_line.__doc__)
+                except ValueError as e:
+                    print(f"Invalid command: {e}")
             if user_input_value == "2":
                 stop_event.set()
                 print("Stopping data reception and closing plot.")
@@ -41,7 +73,8 @@ def input_thread(stop_event):
 
 def main():
     # 1. Initialize data manager (handles lists and lock)
-    data_manager = DataManager()
+    # A rate divider skips frames on purpose, which must not be mistaken for loss.
+    data_manager = DataManager(track_gaps=RATE_DIVIDER == 1)
     
     # 2. Setup socket
     my_socket = setup_socket(PORT)
@@ -58,26 +91,24 @@ def main():
             print("Retrying time sync...")
             time.sleep(2)
 
-    print("Waiting for menu options from server...")
-    my_socket.settimeout(None) # Temporarily block until menu is received
-    try:
-        data, _ = my_socket.recvfrom(1024)
-        response = data.decode().strip()
-        print(f"Received response from server: {response}")
-    except Exception as e:
-        print(f"Error receiving menu: {e}")
-        my_socket.close()
-        return
-        
-    my_socket.settimeout(1) # Restore timeout
-
-    option_input = input("Provide option choice (e.g., '1' for data, '2' to exit): ").strip()
-    my_socket.sendto(option_input.encode(), (HOST, PORT))
-    if option_input == "2":
+    option_input = input("Provide option choice ('1' to start, '2' to exit): ").strip()
+    if option_input != "1":
         my_socket.close()
         return
+    # The ack is printed by the receiver thread.
+    send_command_line(my_socket, HOST, PORT, option_input)
 
     # 4. Start threads
+    if MULTICAST_GROUP:
+        join_multicast(my_socket, MULTICAST_GROUP)
+    else:
+        subscription_thread = threading.Thread(
+            target=keep_subscribed,
+            args=(my_socket, HOST, PORT, stop_receiving, SUBSCRIPTION_LEASE_S, RATE_DIVIDER),
+            daemon=True
+        )
+        subscription_thread.start()
+
     receiver_thread = threading.Thread(
         target=receive_data, 
         args=(my_socket, data_manager, stop_receiving), 
@@ -87,7 +118,7 @@ def main():
 
     input_thread_obj = threading.Thread(
         target=input_thread, 
-        args=(stop_receiving,), 
+        args=(my_socket, stop_receiving), 
         daemon=True
     )
     input_thread_obj.start()
@@ -97,6 +128,11 @@ def main():
 
     print("\n--- Real-time Plotting Started ---")
     print(f"Receiving data from {HOST}:{PORT}. Type '2' + Enter to stop.")
+    print("Type 'i <seconds>' to change the interval, 'o 1' or 'o 0' to toggle oversampling,")
+    print("'b <samples> <seconds>' to batch, 'd <degrees> <seconds>' to set the deadband,")
+    print("'u C' or 'u F' for the units, 'c' for the node's counters and 'v' for its version.")
+    print("Type 's' to print the node's interrupt timing histograms.")
+    print("Type 'r <tier> [hours]' for the node's 10 s, 1 min or 1 h rollups (tier 0, 1 or 2).")
     
     # 6. Start animation
     # Use lambda to pass data_manager into the update_plot function
@@ -115,6 +151,16 @@ def main():
     finally:
         stop_receiving.set()
         print("Plotting ended. Cleaning up resources.")
+        packets_per_second, bytes_per_sample = data_manager.get_transfer_stats()
+        print(f"Received {packets_per_second:.3f} packets/s, {bytes_per_sample:.1f} bytes/sample")
+        print(format_link_stats(data_manager.get_link_stats()))
+        samples, heartbeats = data_manager.get_heartbeats()
+        print(f"Received {samples} samples, {heartbeats} of them deadband heartbeats")
+        replayed = data_manager.get_replayed()
+        if replayed:
+            print(f"Received {len(replayed)} replayed samples from "
+                  f"{replayed[0].timestamp:%Y-%m-%d %H:%M:%S} to "
+                  f"{replayed[-1].timestamp:%Y-%m-%d %H:%M:%S}")
         if receiver_thread.is_alive():
             receiver_thread.join(timeout=2)
         my_socket.close()
@@ -1,45 +1,575 @@
 # data_handler.py
 
+import struct
 import threading
-from datetime import datetime
+import time
+from collections import deque, namedtuple
+from datetime import datetime, timezone
+
+# Mirrors the frames in telemetry.h on the node. All fields are little endian.
+# Every frame starts with a header: version, type, node id, flags and sequence.
+PROTOCOL_VERSION = 1
+FRAME_TYPE_SAMPLE = 1
+FRAME_TYPE_BATCH = 2
+FRAME_TYPE_SUBSCRIBE = 3
+FRAME_TYPE_UNSUBSCRIBE = 4
+FRAME_TYPE_SUBSCRIBE_ACK = 5
+FRAME_TYPE_STATS = 6
+FRAME_TYPE_TIME_REQUEST = 7
+FRAME_TYPE_TIME_RESPONSE = 8
+FRAME_TYPE_NACK = 9
+FRAME_TYPE_ROLLUP_REQUEST = 10
+FRAME_TYPE_ROLLUP = 11
+FRAME_TYPE_COMMAND = 12
+FRAME_TYPE_COMMAND_ACK = 13
+# Header flag set on samples the node replays from its flash log, taken while nobody subscribed.
+FLAG_REPLAY = 0x01
+# Header flag set on frames the node sends again in answer to a nack.
+FLAG_RETRANSMIT = 0x02
+# Header flag set on frames only sent because the node's deadband heartbeat interval ran out, see
+# deadband.h on the node. Their values stayed within the deadband of the previous sample.
+FLAG_HEARTBEAT = 0x04
+HEADER = struct.Struct("<BBBBI")
+# Sample frame: header, epoch seconds, milliseconds and the value as signed fixed point.
+SAMPLE_FRAME = struct.Struct("<BBBBIIHi")
+# Batch frame: header, epoch seconds and milliseconds of the first sample and the sample count,
+# followed by count times the milliseconds since the first sample and the value.
+BATCH_HEADER = struct.Struct("<BBBBIIHB")
+BATCH_SAMPLE = struct.Struct("<Ii")
+# Subscribe message: header, lease seconds and rate divider. Unsubscribe is the header alone.
+SUBSCRIBE = struct.Struct("<BBBBIHB")
+# Subscribe ack: header, status and granted lease seconds.
+SUBSCRIBE_ACK = struct.Struct("<BBBBIBH")
+SUBSCRIBE_STATUS = {0: "OK", 1: "TABLE_FULL", 2: "NOT_SUBSCRIBED"}
+# Stats frame: header, then the timer ISR jitter and the interrupts disabled histograms, each a
+# count, a maximum and HISTOGRAM_BUCKETS bucket counts of microsecond durations. Bucket 0 holds 0us,
+# bucket i holds [2^(i-1), 2^i) and the last bucket everything above.
+HISTOGRAM_BUCKETS = 16
+HISTOGRAM = struct.Struct(f"<II{HISTOGRAM_BUCKETS}I")
+STATS_FRAME_SIZE = HEADER.size + 2 * HISTOGRAM.size
+
+# Time request: header and the node's local time t1 in microseconds.
+TIME_REQUEST = struct.Struct("<BBBBII")
+# Time response: header, t1 copied from the request and this client's receive time t2 and send time
+# t3 in microseconds since the epoch.
+TIME_RESPONSE = struct.Struct("<BBBBIIQQ")
+# Nack: header, sequence of the first missing frame and a bitmap, bit i set if frame first + i is
+# missing.
+NACK = struct.Struct("<BBBBIII")
+NACK_BITMAP_FRAMES = 32
+# Rollup request: header, tier and the epoch seconds the first bucket may start at.
+ROLLUP_REQUEST = struct.Struct("<BBBBIBI")
+# Rollup frame: header, tier, frames still to follow, bucket period in seconds and bucket count,
+# followed by count buckets of start epoch, sample count, fixed point min, max and mean and the
+# float sample variance. See rollup.h on the node.
+ROLLUP_HEADER = struct.Struct("<BBBBIBBIB")
+ROLLUP_BUCKET = struct.Struct("<IIiiif")
+# Bucket periods of the node's tiers, 10 s, 1 min and 1 h.
+ROLLUP_TIERS = 3
+# Command: header with the request id as sequence and the opcode, followed by its arguments.
+# Command ack: header with the request id, opcode and status, followed by the result on success.
+COMMAND_HEADER = struct.Struct("<BBBBIB")
+COMMAND_ACK_HEADER = struct.Struct("<BBBBIBB")
+OPCODE_SET_CLOCK = 1
+OPCODE_START = 2
+OPCODE_STOP = 3
+OPCODE_SET_INTERVAL = 4
+OPCODE_SET_OVERSAMPLING = 5
+OPCODE_SET_BATCH = 6
+OPCODE_SET_DEADBAND = 7
+OPCODE_SET_UNITS = 8
+OPCODE_ADD_SUBSCRIBER = 9
+OPCODE_REMOVE_SUBSCRIBER = 10
+OPCODE_GET_COUNTERS = 11
+OPCODE_GET_VERSION = 12
+# Arguments of each opcode, after the command header.
+COMMAND_ARGS = {
+    OPCODE_SET_CLOCK: struct.Struct("<I"),
+    OPCODE_START: struct.Struct("<"),
+    OPCODE_STOP: struct.Struct("<"),
+    OPCODE_SET_INTERVAL: struct.Struct("<I"),
+    OPCODE_SET_OVERSAMPLING: struct.Struct("<B"),
+    OPCODE_SET_BATCH: struct.Struct("<BI"),
+    OPCODE_SET_DEADBAND: struct.Struct("<iI"),
+    OPCODE_SET_UNITS: struct.Struct("<B"),
+    OPCODE_ADD_SUBSCRIBER: struct.Struct("<4sHHB"),
+    OPCODE_REMOVE_SUBSCRIBER: struct.Struct("<4sH"),
+    OPCODE_GET_COUNTERS: struct.Struct("<"),
+    OPCODE_GET_VERSION: struct.Struct("<"),
+}
+OPCODE_NAMES = {opcode: name[len("OPCODE_"):] for name, opcode in globals().items()
+                if name.startswith("OPCODE_")}
+COMMAND_STATUS = {0: "OK", 1: "UNKNOWN_OPCODE", 2: "INVALID_ARGUMENT", 3: "INVALID_STATE",
+                  4: "UNSUPPORTED", 5: "BUSY"}
+UNITS = {"C": 1, "F": 2}
+UNIT_NAMES = {1: "C", 2: "F"}
+# Order of the GET_COUNTERS result.
+COUNTERS = ["uptime s", "samples taken", "samples sent", "datagrams sent", "events dropped",
+            "log pending", "log overwritten", "subscribers"]
+# Version result: protocol version, firmware major, minor and patch, units.
+VERSION = struct.Struct("<BBBBB")
+
+Histogram = namedtuple("Histogram", ["count", "max_us", "buckets"])
+Rollup = namedtuple("Rollup", ["start", "count", "min", "max", "mean", "variance"])
+VALUE_SCALE = 100
+# IPv4 and UDP headers added to every datagram.
+UDP_IP_OVERHEAD = 28
+
+Sample = namedtuple("Sample",
+                    ["node_id", "sequence", "timestamp", "value", "replayed", "heartbeat"])
+
+def to_timestamp(epoch, millis):
+    return datetime.fromtimestamp(epoch + millis / 1000, tz=timezone.utc)
+
+def encode_subscribe(sequence, lease_s, rate_divider=1):
+    """Encodes a subscribe message, which also renews an existing subscription."""
+    return SUBSCRIBE.pack(PROTOCOL_VERSION, FRAME_TYPE_SUBSCRIBE, 0, 0, sequence, lease_s,
+                          rate_divider)
+
+def encode_unsubscribe(sequence):
+    return HEADER.pack(PROTOCOL_VERSION, FRAME_TYPE_UNSUBSCRIBE, 0, 0, sequence)
+
+def decode_subscribe_ack(payload):
+    """Returns (sequence, status name, granted lease seconds), or None for any other payload."""
+    if (len(payload) != SUBSCRIBE_ACK.size or payload[0] != PROTOCOL_VERSION
+            or payload[1] != FRAME_TYPE_SUBSCRIBE_ACK):
+        return None
+
+    _, _, _, _, sequence, status, lease_s = SUBSCRIBE_ACK.unpack(payload)
+    return sequence, SUBSCRIBE_STATUS.get(status, str(status)), lease_s
+
+def decode_time_request(payload):
+    """Returns (sequence, t1) of a time request, or None for any other payload."""
+    if (len(payload) != TIME_REQUEST.size or payload[0] != PROTOCOL_VERSION
+            or payload[1] != FRAME_TYPE_TIME_REQUEST):
+        return None
+
+    _, _, _, _, sequence, t1_us = TIME_REQUEST.unpack(payload)
+    return sequence, t1_us
+
+def encode_time_response(sequence, t1_us, t2_us, t3_us):
+    return TIME_RESPONSE.pack(PROTOCOL_VERSION, FRAME_TYPE_TIME_RESPONSE, 0, 0, sequence, t1_us,
+                              t2_us, t3_us)
+
+def encode_nack(sequence, first, bitmap):
+    return NACK.pack(PROTOCOL_VERSION, FRAME_TYPE_NACK, 0, 0, sequence, first, bitmap)
+
+def encode_rollup_request(sequence, tier, since_epoch=0):
+    return ROLLUP_REQUEST.pack(PROTOCOL_VERSION, FRAME_TYPE_ROLLUP_REQUEST, 0, 0, sequence, tier,
+                               since_epoch)
+
+def decode_rollup(payload):
+    """Returns (sequence, tier, frames still to follow, period seconds, list of Rollup), or None
+    for any other payload."""
+    if (len(payload) < ROLLUP_HEADER.size or payload[0] != PROTOCOL_VERSION
+            or payload[1] != FRAME_TYPE_ROLLUP):
+        return None
+
+    _, _, _, _, sequence, tier, remaining, period_s, count = ROLLUP_HEADER.unpack_from(payload)
+    if len(payload) != ROLLUP_HEADER.size + count * ROLLUP_BUCKET.size:
+        return None
+
+    rollups = []
+    for start, samples, low, high, mean, variance in ROLLUP_BUCKET.iter_unpack(
+            payload[ROLLUP_HEADER.size:]):
+        rollups.append(Rollup(to_timestamp(start, 0), samples, low / VALUE_SCALE,
+                              high / VALUE_SCALE, mean / VALUE_SCALE, variance))
+    return sequence, tier, remaining, period_s, rollups
+
+def format_rollups(period_s, rollups):
+    """Formats rollup buckets as one line each."""
+    lines = [f"{len(rollups)} buckets of {period_s} s"]
+    for rollup in rollups:
+        lines.append(f"  {rollup.start:%Y-%m-%d %H:%M:%S}  n {rollup.count:>5}  "
+                     f"min {rollup.min:8.2f}  max {rollup.max:8.2f}  mean {rollup.mean:8.2f}  "
+                     f"var {rollup.variance:.3f}")
+    return "\n".join(lines)
+
+def encode_command(request_id, opcode, *args):
+    """Encodes a command, see telemetry.h on the node for the arguments of each opcode."""
+    return (COMMAND_HEADER.pack(PROTOCOL_VERSION, FRAME_TYPE_COMMAND, 0, 0, request_id, opcode)
+            + COMMAND_ARGS[opcode].pack(*args))
+
+def encode_command_line(request_id, line):
+    """Encodes a command typed by the user, or returns None if line is not one. Raises ValueError
+    for malformed arguments.
+
+      1 | 2                            start or stop transmission
+      i <seconds>                      sample interval
+      o <0|1>                          oversampling
+      b <samples> <max age s>          batching
+      d <threshold> <heartbeat s>      deadband
+      u <C|F>                          units
+      a <ip> <port> [lease s] [n]      subscribe another client, to every n-th frame
+      x <ip> <port>                    unsubscribe another client
+      c | v                            counters or version
+    """
+    fields = line.split()
+    if not fields:
+        return None
+
+    name, args = fields[0], fields[1:]
+    if name in ("1", "2", "c", "v") and not args:
+        opcode = {"1": OPCODE_START, "2": OPCODE_STOP, "c": OPCODE_GET_COUNTERS,
+                  "v": OPCODE_GET_VERSION}[name]
+        return encode_command(request_id, opcode)
+    if name == "i" and len(args) == 1:
+        return encode_command(request_id, OPCODE_SET_INTERVAL, round(float(args[0]) * 1000))
+    if name == "o" and len(args) == 1:
+        return encode_command(request_id, OPCODE_SET_OVERSAMPLING, int(args[0]))
+    if name == "b" and len(args) == 2:
+        return encode_command(request_id, OPCODE_SET_BATCH, int(args[0]),
+                              round(float(args[1]) * 1000))
+    if name == "d" and len(args) == 2:
+        return encode_command(request_id, OPCODE_SET_DEADBAND,
+                              round(float(args[0]) * VALUE_SCALE), round(float(args[1]) * 1000))
+    if name == "u" and len(args) == 1:
+        if args[0].upper() not in UNITS:
+            raise ValueError(f"unknown units {args[0]}")
+        return encode_command(request_id, OPCODE_SET_UNITS, UNITS[args[0].upper()])
+    if name in ("a", "x") and len(args) >= 2:
+        address = bytes(int(octet) for octet in args[0].split("."))
+        if len(address) != 4:
+            raise ValueError(f"not an IPv4 address: {args[0]}")
+        if name == "x" and len(args) == 2:
+            return encode_command(request_id, OPCODE_REMOVE_SUBSCRIBER, address, int(args[1]))
+        if name == "a" and len(args) <= 4:
+            lease_s = int(args[2]) if len(args) > 2 else 0
+            rate_divider = int(args[3]) if len(args) > 3 else 1
+            return encode_command(request_id, OPCODE_ADD_SUBSCRIBER, address, int(args[1]),
+                                  lease_s, rate_divider)
+    return None
+
+def decode_command_ack(payload):
+    """Returns (request id, opcode, status name, result bytes), or None for any other payload."""
+    if (len(payload) < COMMAND_ACK_HEADER.size or payload[0] != PROTOCOL_VERSION
+            or payload[1] != FRAME_TYPE_COMMAND_ACK):
+        return None
+
+    _, _, _, _, request_id, opcode, status = COMMAND_ACK_HEADER.unpack_from(payload)
+    return (request_id, opcode, COMMAND_STATUS.get(status, str(status)),
+            payload[COMMAND_ACK_HEADER.size:])
+
+def format_command_ack(ack):
+    """Formats a decoded command ack and its result."""
+    request_id, opcode, status, result = ack
+    text = f"Command {request_id} {OPCODE_NAMES.get(opcode, opcode)}: {status}"
+    if status != "OK" or not result:
+        return text
+
+    if opcode == OPCODE_ADD_SUBSCRIBER and len(result) == 2:
+        return f"{text}, lease {struct.unpack('<H', result)[0]} s"
+    if opcode == OPCODE_GET_VERSION and len(result) == VERSION.size:
+        protocol, major, minor, patch, units = VERSION.unpack(result)
+        return (f"{text}, firmware {major}.{minor}.{patch}, protocol {protocol}, "
+                f"units {UNIT_NAMES.get(units, units)}")
+    if opcode == OPCODE_GET_COUNTERS and len(result) == 1 + 4 * result[0]:
+        values = struct.unpack(f"<{result[0]}I", result[1:])
+        lines = [text]
+        for i, value in enumerate(values):
+            name = COUNTERS[i] if i < len(COUNTERS) else f"counter {i}"
+            lines.append(f"  {name:<16} {value}")
+        return "\n".join(lines)
+    return f"{text}, result {result.hex()}"
+
+def encode_stats_request(sequence):
+    return HEADER.pack(PROTOCOL_VERSION, FRAME_TYPE_STATS, 0, 0, sequence)
+
+def decode_stats(payload):
+    """Returns (timer jitter, interrupts disabled) histograms, or None for any other payload."""
+    if (len(payload) != STATS_FRAME_SIZE or payload[0] != PROTOCOL_VERSION
+            or payload[1] != FRAME_TYPE_STATS):
+        return None
+
+    histograms = []
+    for offset in (HEADER.size, HEADER.size + HISTOGRAM.size):
+        count, max_us, *buckets = HISTOGRAM.unpack_from(payload, offset)
+        histograms.append(Histogram(count, max_us, buckets))
+    return tuple(histograms)
+
+def format_histogram(name, histogram):
+    """Formats a histogram as one line per non-empty bucket."""
+    lines = [f"{name}: {histogram.count} samples, max {histogram.max_us} us"]
+    for i, bucket in enumerate(histogram.buckets):
+        if bucket == 0:
+            continue
+        low = 0 if i == 0 else 1 << (i - 1)
+        high = "" if i == HISTOGRAM_BUCKETS - 1 else f"{max(low, (1 << i) - 1)}"
+        lines.append(f"  {low:>6}-{high:<6} us {bucket}")
+    return "\n".join(lines)
+
+def decode_frame(payload):
+    """Decodes a binary sample or batch frame into a list of samples.
+
+    Returns None if the payload is not a telemetry frame. Samples unpacked from a batch share the
+    sequence number, replay and heartbeat flags of the batch.
+    """
+    if len(payload) < HEADER.size or payload[0] != PROTOCOL_VERSION:
+        return None
+
+    frame_type = payload[1]
+    if frame_type == FRAME_TYPE_SAMPLE:
+        if len(payload) != SAMPLE_FRAME.size:
+            return None
+
+        _, _, node_id, flags, sequence, epoch, millis, value = SAMPLE_FRAME.unpack(payload)
+        return [Sample(node_id, sequence, to_timestamp(epoch, millis), value / VALUE_SCALE,
+                       bool(flags & FLAG_REPLAY), bool(flags & FLAG_HEARTBEAT))]
+
+    if frame_type == FRAME_TYPE_BATCH:
+        if len(payload) < BATCH_HEADER.size:
+            return None
+
+        _, _, node_id, flags, sequence, epoch, millis, count = BATCH_HEADER.unpack_from(payload)
+        if len(payload) != BATCH_HEADER.size + count * BATCH_SAMPLE.size:
+            return None
+
+        samples = []
+        for offset_ms, value in BATCH_SAMPLE.iter_unpack(payload[BATCH_HEADER.size:]):
+            timestamp = to_timestamp(epoch, millis + offset_ms)
+            samples.append(Sample(node_id, sequence, timestamp, value / VALUE_SCALE,
+                                  bool(flags & FLAG_REPLAY), bool(flags & FLAG_HEARTBEAT)))
+        return samples
+
+    return None
+
+class LinkTracker:
+    """Follows the sequence numbers of a node's sample and batch frames to find lost, reordered and
+    duplicate frames, and asks for lost ones again with nacks. Also measures one-way latency, which
+    is meaningful because the node synchronizes its clock to this client.
+
+    With a rate divider above 1 the node skips frames on purpose, so gaps are neither counted nor
+    nacked.
+    """
+    # Seconds between nacks for the same frame, and nacks sent before it counts as lost. The node
+    # only keeps its last few frames, so asking for longer is pointless.
+    NACK_INTERVAL_S = 0.2
+    MAX_NACKS = 3
+    # A jump back further than this is a node that restarted rather than a late frame.
+    RESTART_DISTANCE = 1024
+    # Sequences remembered to spot duplicates, and latencies kept for the percentiles.
+    HISTORY = 1024
+
+    def __init__(self, track_gaps=True):
+        self.track_gaps = track_gaps
+        self.highest = None
+        # Missing sequence -> [time of the last nack, nacks sent].
+        self.missing = {}
+        self.seen = set()
+        self.seen_order = deque()
+        self.latencies_ms = deque(maxlen=self.HISTORY)
+        self.nack_sequence = 0
+        self.received = 0
+        self.lost = 0
+        self.recovered = 0
+        self.reordered = 0
+        self.duplicates = 0
+
+    @staticmethod
+    def _distance(sequence, reference):
+        """Signed distance from reference to sequence, allowing for the u32 wrap."""
+        distance = (sequence - reference) & 0xFFFFFFFF
+        return distance - (1 << 32) if distance >= 1 << 31 else distance
+
+    def _remember(self, sequence):
+        self.seen.add(sequence)
+        self.seen_order.append(sequence)
+        if len(self.seen_order) > self.HISTORY:
+            self.seen.discard(self.seen_order.popleft())
+
+    def on_frame(self, sequence, flags, samples, received_s):
+        """Records a received frame. Returns False if it is a duplicate that should be dropped."""
+        # A restarted node reuses sequence numbers, so the history has to go before it is checked.
+        distance = 1 if self.highest is None else self._distance(sequence, self.highest)
+        if distance < -self.RESTART_DISTANCE:
+            self.missing.clear()
+            self.seen.clear()
+            self.seen_order.clear()
+            distance = 1
+
+        if sequence in self.seen:
+            self.duplicates += 1
+            return False
+
+        if distance > 0:
+            if self.track_gaps and self.highest is not None:
+                for gap in range(1, min(distance, self.RESTART_DISTANCE)):
+                    self.missing[(self.highest + gap) & 0xFFFFFFFF] = [float("-inf"), 0]
+            self.highest = sequence
+        elif self.missing.pop(sequence, None) is not None:
+            if flags & FLAG_RETRANSMIT:
+                self.recovered += 1
+            else:
+                self.reordered += 1
+        else:
+            # Older than the remembered history, or a gap that was already given up on.
+            self.duplicates += 1
+            return False
+
+        self._remember(sequence)
+        self.received += 1
+        if samples and not flags & (FLAG_REPLAY | FLAG_RETRANSMIT):
+            newest = samples[-1].timestamp.timestamp()
+            self.latencies_ms.append((received_s - newest) * 1000)
+        return True
+
+    def due_nacks(self, now):
+        """Returns the nack messages to send now. Frames nacked MAX_NACKS times count as lost."""
+        due = []
+        for sequence, state in list(self.missing.items()):
+            if now - state[0] < self.NACK_INTERVAL_S:
+                continue
+            if state[1] == self.MAX_NACKS:
+                del self.missing[sequence]
+                self.lost += 1
+                continue
+            state[0] = now
+            state[1] += 1
+            due.append(sequence)
+
+        nacks = []
+        for sequence in sorted(due, key=lambda s: self._distance(s, self.highest)):
+            if nacks and self._distance(sequence, nacks[-1][0]) < NACK_BITMAP_FRAMES:
+                nacks[-1][1] |= 1 << self._distance(sequence, nacks[-1][0])
+            else:
+                nacks.append([sequence, 1])
+
+        messages = []
+        for first, bitmap in nacks:
+            messages.append(encode_nack(self.nack_sequence, first, bitmap))
+            self.nack_sequence = (self.nack_sequence + 1) & 0xFFFFFFFF
+        return messages
+
+    def stats(self):
+        """Returns a dict of the counters and the 50th, 95th and 99th latency percentiles in ms."""
+        latencies = sorted(self.latencies_ms)
+        percentiles = {}
+        for p in (50, 95, 99):
+            percentiles[p] = latencies[min(len(latencies) - 1, len(latencies) * p // 100)] \
+                if latencies else None
+
+        expected = self.received + self.lost
+        return {
+            "received": self.received,
+            "lost": self.lost,
+            "loss_rate": self.lost / expected if expected else 0.0,
+            "recovered": self.recovered,
+            "reordered": self.reordered,
+            "duplicates": self.duplicates,
+            "pending": len(self.missing),
+            "latency_ms": percentiles,
+        }
+
+def format_link_stats(stats):
+    latency = stats["latency_ms"]
+    if latency[50] is None:
+        latency_text = "no latency samples"
+    else:
+        latency_text = (f"latency p50 {latency[50]:.1f} ms, p95 {latency[95]:.1f} ms, "
+                        f"p99 {latency[99]:.1f} ms")
+    return (f"Frames: {stats['received']} received, {stats['lost']} lost "
+            f"({stats['loss_rate']:.2%}), {stats['recovered']} recovered by nack, "
+            f"{stats['reordered']} reordered, {stats['duplicates']} duplicates, {latency_text}")
 
 class DataManager:
-    """Manages the shared data points and timestamps in a thread-safe manner."""
-    def __init__(self):
+    """Manages the shared data points and timestamps in a thread-safe manner.
+
+    With deadband compression on the node a sample is only received when the value changed, so the
+    points form a step-wise series: each value holds until the timestamp of the next one.
+    """
+    def __init__(self, track_gaps=True):
         self.data_points = []
         self.timestamps = []
+        # Samples the node logged while nobody was subscribed, kept apart from the live plot.
+        self.replayed_samples = []
+        self.link = LinkTracker(track_gaps)
         self.lock = threading.Lock()
+        self.datagrams = 0
+        self.samples = 0
+        self.heartbeats = 0
+        self.payload_bytes = 0
+        self.first_receive_time = None
+        self.last_receive_time = None
 
-    def parse_and_add(self, csv_string):
-        """Parses the 'date, value' string and adds data to the lists."""
-        try:
-            # 1. Split the string
-            parts = [p.strip() for p in csv_string.split(',')]
-            if len(parts) != 2:
-                print(f"Warning: Data format error. Expected 'DATE, VALUE', got: {csv_string}")
-                return
+    def parse_and_add(self, payload, received_s=None):
+        """Decodes a binary sample or batch frame and adds its data to the lists. Duplicate frames
+        are dropped. received_s is the epoch time the payload arrived, for the latency.
 
-            date_str, value_str = parts[0], parts[1]
-            
-            # 2. Convert value to float
-            numeric_value = float(value_str)
+        Returns False if the payload is not a telemetry frame, e.g. a text reply from the node.
+        """
+        try:
+            samples = decode_frame(payload)
+            if samples is None:
+                return False
 
-            # 3. Parse timestamp and format for graph label
-            dt_object = datetime.fromisoformat(date_str)
-            time_label = dt_object.strftime("%H:%M:%S")
+            now = time.monotonic()
+            _, _, _, flags, sequence = HEADER.unpack_from(payload)
 
             # Acquire lock before modifying shared lists
             with self.lock:
-                self.data_points.append(numeric_value)
-                self.timestamps.append(time_label) 
+                if not self.link.on_frame(sequence, flags, samples,
+                                          received_s if received_s is not None else time.time()):
+                    return True
+
+                if samples and samples[0].replayed:
+                    self.replayed_samples.extend(samples)
+                    return True
+
+                for sample in samples:
+                    self.data_points.append(sample.value)
+                    self.timestamps.append(sample.timestamp)
+
+                self.datagrams += 1
+                self.samples += len(samples)
+                self.heartbeats += sum(sample.heartbeat for sample in samples)
+                self.payload_bytes += len(payload)
+                if self.first_receive_time is None:
+                    self.first_receive_time = now
+                self.last_receive_time = now
 
-        except ValueError as e:
-            print(f"Warning: Data parsing error ({e}). Ignoring message: {csv_string}")
+            return True
+
+        except (struct.error, ValueError, OverflowError) as e:
+            print(f"Warning: Frame decoding error ({e}). Ignoring message: {payload!r}")
         except Exception as e:
              print(f"Unexpected error during data parsing: {e}")
 
+        return False
+
     def get_data(self):
-        """Returns copies of the data lists in a thread-safe manner."""
+        """Returns copies of the values and their datetime timestamps in a thread-safe manner."""
         with self.lock:
             # Return copies to prevent external modification during plot drawing
-            return self.data_points[:], self.timestamps[:]
\ No newline at end of file
+            return self.data_points[:], self.timestamps[:]
+
+    def get_replayed(self):
+        """Returns a copy of the replayed samples, oldest first."""
+        with self.lock:
+            return sorted(self.replayed_samples, key=lambda sample: sample.timestamp)
+
+    def take_nacks(self):
+        """Returns the nack messages due to be sent to the node."""
+        with self.lock:
+            return self.link.due_nacks(time.monotonic())
+
+    def get_heartbeats(self):
+        """Returns (samples received, how many of them were heartbeats)."""
+        with self.lock:
+            return self.samples, self.heartbeats
+
+    def get_link_stats(self):
+        with self.lock:
+            return self.link.stats()
+
+    def get_transfer_stats(self):
+        """Returns datagrams per second and bytes per sample, including UDP/IP headers, received
+        so far. Compares batched against unbatched transmission from the node, so replayed frames
+        are not counted."""
+        with self.lock:
+            if self.samples == 0:
+                return 0.0, 0.0
+
+            elapsed = self.last_receive_time - self.first_receive_time
+            packets_per_second = (self.datagrams - 1) / elapsed if elapsed > 0 else 0.0
+            wire_bytes = self.payload_bytes + self.datagrams * UDP_IP_OVERHEAD
+            return packets_per_second, wire_bytes / self.samples
@@ -1,10 +1,19 @@
 # networking.py
 
+import itertools
 import socket
+import struct
 import time
-from data_handler import DataManager
+from data_handler import (OPCODE_SET_CLOCK, DataManager, decode_command_ack, decode_rollup,
+                          decode_stats, decode_subscribe_ack, decode_time_request,
+                          encode_command, encode_command_line, encode_subscribe,
+                          encode_time_response, encode_unsubscribe, format_command_ack,
+                          format_histogram, format_rollups)
 from datetime import datetime
 
+# Request ids of the commands sent, so each ack can be matched to its command.
+request_ids = itertools.count(1)
+
 def setup_socket(port):
     """Initializes and binds the UDP socket."""
     my_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
@@ -16,36 +25,110 @@ def setup_socket(port):
         print(f"Error binding socket: {e}. Check if port {port} is already in use.")
         return None
 
+def join_multicast(my_socket, group):
+    """Joins a multicast group so frames the node sends to it are received on my_socket."""
+    membership = struct.pack("4s4s", socket.inet_aton(group), socket.inet_aton("0.0.0.0"))
+    my_socket.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+
+def keep_subscribed(my_socket, host, port, stop_event, lease_s=60, rate_divider=1):
+    """Thread to subscribe to the node and renew the lease at half its length until stop_event is
+    set, then unsubscribe. Acks are printed by receive_data."""
+    sequence = 0
+    while not stop_event.is_set():
+        my_socket.sendto(encode_subscribe(sequence, lease_s, rate_divider), (host, port))
+        sequence += 1
+        stop_event.wait(lease_s / 2)
+
+    my_socket.sendto(encode_unsubscribe(sequence), (host, port))
+
+def epoch_micros():
+    return time.time_ns() // 1000
+
+def answer_time_request(my_socket, data, address, received_us):
+    """Answers the node's time request, see time_sync.h on the node. Returns False if data is not
+    a time request."""
+    request = decode_time_request(data)
+    if request is None:
+        return False
+
+    sequence, t1_us = request
+    my_socket.sendto(encode_time_response(sequence, t1_us, received_us, epoch_micros()), address)
+    return True
+
+def send_command_line(my_socket, host, port, line):
+    """Sends a command typed by the user, see encode_command_line. Returns False if line is not a
+    command. Its ack is printed by receive_data."""
+    frame = encode_command_line(next(request_ids), line)
+    if frame is None:
+        return False
+    my_socket.sendto(frame, (host, port))
+    return True
+
 def send_unix_time(my_socket, host, port):
-    """Sends current Unix time to the server for synchronization and waits for 'OK'."""
+    """Sends current Unix time to the server with a SET_CLOCK command and waits for its ack."""
     unix_time = int(time.time())
-    payload = str(unix_time).encode()
+    request_id = next(request_ids)
     print(f"Sending current Unix time: {unix_time}")
-    my_socket.sendto(payload, (host, port))
+    my_socket.sendto(encode_command(request_id, OPCODE_SET_CLOCK, unix_time), (host, port))
 
     try:
-        # Wait for "OK" response from the server
-        data, _ = my_socket.recvfrom(1024)
-        response = data.decode().strip()
-        print(f"Received response from server: {response}")
-        return response == "OK"
+        # The node starts synchronizing its clock as soon as it is set, answer its time requests
+        # while waiting for the ack.
+        while True:
+            data, address = my_socket.recvfrom(1024)
+            if answer_time_request(my_socket, data, address, epoch_micros()):
+                continue
+            ack = decode_command_ack(data)
+            if ack is not None and ack[0] == request_id:
+                print(format_command_ack(ack))
+                return ack[2] == "OK"
     except socket.timeout:
         # This socket.timeout is handled in the calling function (client_app.py)
         return False
 
+def send_nacks(my_socket, data_manager, node_address):
+    """Asks the node again for frames missing from its sequence, see retransmit.h on the node."""
+    if node_address is None:
+        return
+    for nack in data_manager.take_nacks():
+        my_socket.sendto(nack, node_address)
+
 def receive_data(my_socket, data_manager, stop_event):
-    """Thread to continuously receive UDP data and parse the 'date, value' CSV string."""
+    """Thread to continuously receive UDP data and decode the binary sample frames."""
+    node_address = None
     while not stop_event.is_set():
         try:
             # Set a small timeout for the thread to check the stop_event periodically
             my_socket.settimeout(0.1) 
-            data, _ = my_socket.recvfrom(1024)
-            if data:
-                csv_string = data.decode().strip()
-                print(f"[UDP] Received: {csv_string}")
-                data_manager.parse_and_add(csv_string)
+            data, address = my_socket.recvfrom(1024)
+            received_us = epoch_micros()
+            if not data or answer_time_request(my_socket, data, address, received_us):
+                continue
+            if data_manager.parse_and_add(data, received_us / 1e6):
+                node_address = address
+                send_nacks(my_socket, data_manager, node_address)
+                continue
+
+            ack = decode_subscribe_ack(data)
+            command_ack = decode_command_ack(data)
+            stats = decode_stats(data)
+            rollup = decode_rollup(data)
+            if command_ack is not None:
+                print(f"[UDP] {format_command_ack(command_ack)}")
+            elif ack is not None:
+                _, status, lease_s = ack
+                print(f"[UDP] Subscription {status}, lease {lease_s} s")
+            elif stats is not None:
+                print(format_histogram("Timer ISR jitter", stats[0]))
+                print(format_histogram("Interrupts disabled", stats[1]))
+            elif rollup is not None:
+                _, tier, _, period_s, rollups = rollup
+                print(f"[UDP] Rollup tier {tier}: " + format_rollups(period_s, rollups))
+            else:
+                print(f"[UDP] Received: {data.decode(errors='replace').strip()}")
 
         except socket.timeout:
+            send_nacks(my_socket, data_manager, node_address)
             continue
         except Exception as e:
             if not stop_event.is_set():
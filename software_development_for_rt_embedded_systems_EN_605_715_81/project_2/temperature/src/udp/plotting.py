@@ -1,5 +1,6 @@
 # plotting.py
 
+import matplotlib.dates as mdates
 import matplotlib.pyplot as plt
 from data_handler import DataManager # Not strictly needed here, but good practice
 
@@ -7,10 +8,14 @@ def setup_plot():
     """Initializes and configures the Matplotlib plot."""
     fig, ax = plt.subplots(figsize=(15, 8))
     
-    # 'line,' unpacks the single Line2D object returned by ax.plot
-    line, = ax.plot([], [], marker='o', linestyle='-', label='Remote Temp Data') 
+    # 'line,' unpacks the single Line2D object returned by ax.plot. Values hold until the next
+    # sample, which is all the node sends while a value stays within its deadband.
+    line, = ax.plot([], [], marker='o', linestyle='-', drawstyle='steps-post',
+                    label='Remote Temp Data') 
     
     ax.set_xlabel("Time")
+    ax.xaxis_date()
+    ax.xaxis.set_major_formatter(mdates.DateFormatter("%H:%M:%S"))
     ax.set_ylabel("Value")
     ax.set_title("Real-time Temperature")
     ax.legend()
@@ -28,8 +33,9 @@ def update_plot(frame, ax, line, data_manager: DataManager):
     if not data_points:
         return line, 
     
-    # X-data is the index (0, 1, 2, ...), Y-data is the collected values
-    x_data = list(range(len(data_points)))
+    # X-data is the sample time, so points sent after long unchanged stretches sit where they
+    # belong, Y-data is the collected values
+    x_data = mdates.date2num(timestamps)
     y_data = data_points
 
     line.set_data(x_data, y_data)
@@ -37,10 +43,9 @@ def update_plot(frame, ax, line, data_manager: DataManager):
     # Rescale axes automatically
     ax.relim()
     ax.autoscale_view()
-
-    # Update x-axis labels to show timestamps
-    ax.set_xticks(x_data) 
-    ax.set_xticklabels(timestamps, rotation=45, ha='right')
+    for label in ax.get_xticklabels():
+        label.set_rotation(45)
+        label.set_horizontalalignment('right')
 
     # Return the line artist (required by FuncAnimation)
     return line,
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include <string.h>
+#include <unity.h>
+
+#include "flash_log.h"
+
+// Host tests of flash_log::Log against a RAM block device, run with `pio test -e native`.
+
+namespace {
+
+// mbed's block device interface over RAM. Erased bytes read back as 0xFF.
+class RamDevice {
+ public:
+  RamDevice() {
+    memset(bytes_, 0xFF, sizeof(bytes_));
+  }
+
+  int read(void* buffer, uint32_t address, uint32_t size) {
+    memcpy(buffer, bytes_ + address, size);
+    return 0;
+  }
+
+  int program(const void* buffer, uint32_t address, uint32_t size) {
+    memcpy(bytes_ + address, buffer, size);
+    return 0;
+  }
+
+  int erase(uint32_t address, uint32_t size) {
+    memset(bytes_ + address, 0xFF, size);
+    return 0;
+  }
+
+ private:
+  uint8_t bytes_[flash_log::BLOCK_COUNT * flash_log::BLOCK_SIZE];
+};
+
+using Log = flash_log::Log<RamDevice>;
+
+RamDevice device;
+
+telemetry::Sample SampleAt(uint32_t epoch) {
+  return {epoch, 250, 20.5f};
+}
+
+void AppendSamples(Log& log, uint32_t first_epoch, size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    TEST_ASSERT_TRUE(log.Append(SampleAt(first_epoch + i)));
+  }
+}
+
+} // namespace
+
+void setUp() {
+  device = RamDevice();
+}
+
+void tearDown() {}
+
+void test_replays_oldest_first() {
+  Log log(device, 0);
+  TEST_ASSERT_TRUE(log.Begin());
+  AppendSamples(log, 1000, 5);
+
+  telemetry::Sample samples[8];
+  TEST_ASSERT_EQUAL_size_t(5, log.Read(samples, 8));
+  for (size_t i = 0; i < 5; ++i) {
+    TEST_ASSERT_EQUAL_UINT32(1000 + i, samples[i].epoch);
+    TEST_ASSERT_EQUAL_UINT16(250, samples[i].millis);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 20.5f, samples[i].value);
+  }
+  TEST_ASSERT_TRUE(log.IsEmpty());
+}
+
+// A block that is drained before it is full is not replayed again after a reset.
+void test_drained_partial_block_stays_consumed() {
+  Log log(device, 0);
+  TEST_ASSERT_TRUE(log.Begin());
+  AppendSamples(log, 1000, 5);
+  telemetry::Sample samples[8];
+  TEST_ASSERT_EQUAL_size_t(5, log.Read(samples, 8));
+
+  Log restarted(device, 0);
+  TEST_ASSERT_TRUE(restarted.Begin());
+  TEST_ASSERT_TRUE(restarted.IsEmpty());
+  TEST_ASSERT_EQUAL_size_t(0, restarted.Read(samples, 8));
+}
+
+// Samples logged after the log was drained go to a new block and survive a reset.
+void test_append_after_drain_starts_new_block() {
+  Log log(device, 0);
+  TEST_ASSERT_TRUE(log.Begin());
+  AppendSamples(log, 1000, 5);
+  telemetry::Sample samples[8];
+  TEST_ASSERT_EQUAL_size_t(5, log.Read(samples, 8));
+  AppendSamples(log, 2000, 3);
+
+  Log restarted(device, 0);
+  TEST_ASSERT_TRUE(restarted.Begin());
+  TEST_ASSERT_EQUAL_size_t(3, restarted.Pending());
+  TEST_ASSERT_EQUAL_size_t(3, restarted.Read(samples, 8));
+  TEST_ASSERT_EQUAL_UINT32(2000, samples[0].epoch);
+
+  // The same holds for a log that was found drained by Begin().
+  AppendSamples(restarted, 3000, 2);
+  Log again(device, 0);
+  TEST_ASSERT_TRUE(again.Begin());
+  TEST_ASSERT_EQUAL_size_t(2, again.Read(samples, 8));
+  TEST_ASSERT_EQUAL_UINT32(3000, samples[0].epoch);
+}
+
+// The replay position is only in RAM, a partly replayed block repeats from its start.
+void test_partly_replayed_block_repeats_after_reset() {
+  Log log(device, 0);
+  TEST_ASSERT_TRUE(log.Begin());
+  AppendSamples(log, 1000, 5);
+  telemetry::Sample samples[8];
+  TEST_ASSERT_EQUAL_size_t(2, log.Read(samples, 2));
+
+  Log restarted(device, 0);
+  TEST_ASSERT_TRUE(restarted.Begin());
+  TEST_ASSERT_EQUAL_size_t(5, restarted.Read(samples, 8));
+  TEST_ASSERT_EQUAL_UINT32(1000, samples[0].epoch);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_replays_oldest_first);
+  RUN_TEST(test_drained_partial_block_stays_consumed);
+  RUN_TEST(test_append_after_drain_starts_new_block);
+  RUN_TEST(test_partly_replayed_block_repeats_after_reset);
+  return UNITY_END();
+}
@@ -0,0 +1,160 @@
+#include <unity.h>
+
+#include "scheduler.h"
+
+// Host tests of scheduler::Scheduler against a simulated micros(), run with `pio test -e native`.
+
+namespace {
+
+uint32_t now_us;
+
+uint32_t Now() {
+  return now_us;
+}
+
+// How long each task takes, and the start times of its runs.
+uint32_t network_run_us;
+uint32_t sensor_run_us;
+uint32_t network_runs;
+uint32_t sensor_runs;
+uint32_t sensor_starts_us[8];
+
+void Network() {
+  ++network_runs;
+  now_us += network_run_us;
+}
+
+void Sensor() {
+  if (sensor_runs < 8) {
+    sensor_starts_us[sensor_runs] = now_us;
+  }
+  ++sensor_runs;
+  now_us += sensor_run_us;
+}
+
+// Runs the scheduler until `until_us`, idling 100 us whenever nothing is due as loop() would until
+// the next interrupt.
+void RunUntil(scheduler::Scheduler& tasks, uint32_t until_us) {
+  while ((int32_t)(until_us - now_us) > 0) {
+    if (!tasks.RunNext()) {
+      now_us += 100;
+    }
+  }
+}
+
+} // namespace
+
+void setUp() {
+  now_us = 0;
+  network_run_us = 0;
+  sensor_run_us = 0;
+  network_runs = 0;
+  sensor_runs = 0;
+}
+
+void tearDown() {}
+
+// Releases stay on the period grid however late a run starts.
+void test_releases_do_not_drift() {
+  scheduler::Task tasks[] = {{"sensor", Sensor, 10000, 0}};
+  scheduler::Scheduler task_scheduler;
+  task_scheduler.Begin(tasks, 1, Now);
+  sensor_run_us = 2000;
+
+  RunUntil(task_scheduler, 1000);
+  now_us = 13000;
+  RunUntil(task_scheduler, 41000);
+
+  TEST_ASSERT_EQUAL_UINT32(0, sensor_starts_us[0]);
+  TEST_ASSERT_EQUAL_UINT32(13000, sensor_starts_us[1]);
+  TEST_ASSERT_EQUAL_UINT32(20000, sensor_starts_us[2]);
+  TEST_ASSERT_EQUAL_UINT32(30000, sensor_starts_us[3]);
+  TEST_ASSERT_EQUAL_UINT32(40000, sensor_starts_us[4]);
+  TEST_ASSERT_EQUAL_UINT32(3000, tasks[0].stats.max_jitter_us);
+  TEST_ASSERT_EQUAL_UINT32(0, tasks[0].stats.missed);
+}
+
+// A 25 ms run of a 10 ms task misses the releases at 10 and 20 ms and is next released at 30 ms,
+// not at 20 ms straight after the run. Across the micros() wrap as anywhere else.
+void test_overrun_skips_to_next_release_after_run() {
+  const uint32_t start_us = 0xFFFFFFFFu - 5000;
+  now_us = start_us;
+  scheduler::Task tasks[] = {{"sensor", Sensor, 10000, 0}};
+  scheduler::Scheduler task_scheduler;
+  task_scheduler.Begin(tasks, 1, Now);
+
+  sensor_run_us = 25000;
+  TEST_ASSERT_TRUE(task_scheduler.RunNext());
+  TEST_ASSERT_EQUAL_UINT32(start_us + 30000, tasks[0].release_us);
+  TEST_ASSERT_EQUAL_UINT32(2, tasks[0].stats.missed);
+  TEST_ASSERT_FALSE(task_scheduler.RunNext());
+
+  sensor_run_us = 1000;
+  RunUntil(task_scheduler, start_us + 30000);
+  TEST_ASSERT_EQUAL_UINT32(1, sensor_runs);
+  RunUntil(task_scheduler, start_us + 31000);
+  TEST_ASSERT_EQUAL_UINT32(2, sensor_runs);
+  TEST_ASSERT_EQUAL_UINT32(start_us + 30000, sensor_starts_us[1]);
+  TEST_ASSERT_EQUAL_UINT32(2, tasks[0].stats.missed);
+
+  // Ending exactly on a release boundary skips that release too.
+  sensor_run_us = 20000;
+  now_us = start_us + 40000;
+  TEST_ASSERT_TRUE(task_scheduler.RunNext());
+  TEST_ASSERT_EQUAL_UINT32(start_us + 70000, tasks[0].release_us);
+  TEST_ASSERT_EQUAL_UINT32(4, tasks[0].stats.missed);
+}
+
+// A top priority task that takes 3 ms every 1 ms period leaves the lower priority one its runs.
+void test_overrunning_task_does_not_starve_others() {
+  scheduler::Task tasks[] = {
+    {"network", Network, 1000, 0},
+    {"sensor", Sensor, 10000, 1},
+  };
+  scheduler::Scheduler task_scheduler;
+  task_scheduler.Begin(tasks, 2, Now);
+  network_run_us = 3000;
+  sensor_run_us = 100;
+
+  RunUntil(task_scheduler, 1000000);
+  TEST_ASSERT_UINT32_WITHIN(1, 100, sensor_runs);
+  // The network runs every 4 ms, missing 3 of its 4 releases, and gets most of the time.
+  TEST_ASSERT_UINT32_WITHIN(5, 250, network_runs);
+  TEST_ASSERT_UINT32_WITHIN(15, 750, tasks[0].stats.missed);
+  TEST_ASSERT_EQUAL_UINT32(0, tasks[1].stats.missed);
+  TEST_ASSERT_LESS_THAN(4000, tasks[1].stats.max_jitter_us);
+}
+
+// The lower priority number runs first, ties go to the earlier release.
+void test_priority_then_release_order() {
+  scheduler::Task tasks[] = {
+    {"sensor", Sensor, 10000, 1},
+    {"network", Network, 10000, 0},
+  };
+  scheduler::Scheduler task_scheduler;
+  task_scheduler.Begin(tasks, 2, Now);
+  network_run_us = 1000;
+
+  TEST_ASSERT_TRUE(task_scheduler.RunNext());
+  TEST_ASSERT_EQUAL_UINT32(1, network_runs);
+  TEST_ASSERT_EQUAL_UINT32(0, sensor_runs);
+  TEST_ASSERT_TRUE(task_scheduler.RunNext());
+  TEST_ASSERT_EQUAL_UINT32(1, sensor_runs);
+
+  tasks[0].priority = 0;
+  tasks[0].release_us = 5000;
+  tasks[1].release_us = 6000;
+  now_us = 7000;
+  TEST_ASSERT_TRUE(task_scheduler.RunNext());
+  TEST_ASSERT_EQUAL_UINT32(2, sensor_runs);
+  TEST_ASSERT_EQUAL_UINT32(1, network_runs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_releases_do_not_drift);
+  RUN_TEST(test_overrun_skips_to_next_release_after_run);
+  RUN_TEST(test_overrunning_task_does_not_starve_others);
+  RUN_TEST(test_priority_then_release_order);
+  return UNITY_END();
+}
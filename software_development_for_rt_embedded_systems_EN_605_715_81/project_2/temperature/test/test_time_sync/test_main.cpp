@@ -0,0 +1,183 @@
+#include <unity.h>
+
+#include <random>
+#include <vector>
+
+#include "time_sync.h"
+
+// Host tests of the time_sync exchange and clock, run with `pio test -e native`.
+
+namespace {
+
+// Client time at true time 0, somewhere in 2024.
+constexpr int64_t EPOCH_AT_ZERO_US = 1717000000000000LL;
+// The node's crystal runs 40 ppm fast.
+constexpr double CRYSTAL_ERROR = 40e-6;
+constexpr int64_t NODE_START_US = 123456789;
+// Each way of the network takes at least this long plus exponential queueing of this mean.
+constexpr double BASE_DELAY_US = 2000;
+constexpr double QUEUEING_US = 3000;
+// Between the client receiving a request and sending the response.
+constexpr int64_t TURNAROUND_US = 100;
+
+int64_t NodeLocal(double true_us) {
+  return NODE_START_US + (int64_t)(true_us * (1 + CRYSTAL_ERROR));
+}
+
+double TrueFromLocal(int64_t local_us) {
+  return (local_us - NODE_START_US) / (1 + CRYSTAL_ERROR);
+}
+
+struct Response {
+  double arrival_true_us;
+  uint32_t sequence;
+  uint32_t t1_us;
+  int64_t t2_us;
+  int64_t t3_us;
+};
+
+// Simulates the exchange of one sync starting at `start_true_us` over a network with random
+// queueing. Returns the true time the sync finished at.
+double RunSync(time_sync::Synchronizer& synchronizer, double start_true_us, std::mt19937& random) {
+  std::exponential_distribution<double> queueing(1 / QUEUEING_US);
+  std::vector<Response> in_flight;
+  double now_true_us = start_true_us;
+  synchronizer.Start(NodeLocal(now_true_us));
+
+  while (true) {
+    int64_t now_local_us = NodeLocal(now_true_us);
+    for (size_t i = 0; i < in_flight.size();) {
+      if (in_flight[i].arrival_true_us <= now_true_us) {
+        const Response& response = in_flight[i];
+        synchronizer.OnResponse(response.sequence, response.t1_us, response.t2_us, response.t3_us,
+                                now_local_us);
+        in_flight.erase(in_flight.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+
+    uint32_t sequence;
+    uint32_t t1_us;
+    time_sync::Step step = synchronizer.Poll(now_local_us, sequence, t1_us);
+    if (step == time_sync::Step::FINISHED) {
+      break;
+    }
+    if (step == time_sync::Step::SEND_REQUEST) {
+      double received_true_us = now_true_us + BASE_DELAY_US + queueing(random);
+      int64_t t2_us = EPOCH_AT_ZERO_US + (int64_t)received_true_us;
+      int64_t t3_us = t2_us + TURNAROUND_US;
+      double arrival_true_us = received_true_us + TURNAROUND_US + BASE_DELAY_US + queueing(random);
+      in_flight.push_back({arrival_true_us, sequence, t1_us, t2_us, t3_us});
+    }
+    now_true_us += 1000;
+  }
+
+  return now_true_us;
+}
+
+// How far the node's epoch time is from the client's at `true_us`.
+int64_t ClockError(const time_sync::Clock& clock, double true_us) {
+  return clock.EpochMicros(NodeLocal(true_us)) - (EPOCH_AT_ZERO_US + (int64_t)true_us);
+}
+
+} // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_measure_symmetric_path() {
+  // Local clock 1 s behind, 3 ms each way, 1 ms at the client.
+  time_sync::Measurement measurement = time_sync::Measure(0, 1003000, 1004000, 7000);
+  TEST_ASSERT_EQUAL_INT64(1000000, measurement.offset_us);
+  TEST_ASSERT_EQUAL_INT64(6000, measurement.delay_us);
+  TEST_ASSERT_EQUAL_INT64(7000, measurement.local_us);
+}
+
+// The round least delayed sets the offset, responses for other requests are ignored.
+void test_synchronizer_keeps_fastest_round() {
+  time_sync::Synchronizer synchronizer;
+  synchronizer.Start(0);
+  uint32_t sequences[time_sync::ROUNDS];
+  uint32_t t1s[time_sync::ROUNDS];
+  int64_t now_us = 0;
+  for (size_t round = 0; round < time_sync::ROUNDS; ++round) {
+    TEST_ASSERT_TRUE(time_sync::Step::SEND_REQUEST ==
+                     synchronizer.Poll(now_us, sequences[round], t1s[round]));
+    now_us += time_sync::ROUND_INTERVAL_US;
+  }
+
+  // Offset 1 s, round 3 with 1 ms each way, every other with 5 ms out and 1 ms back.
+  for (size_t round = 0; round < time_sync::ROUNDS; ++round) {
+    int64_t out_us = round == 3 ? 1000 : 5000;
+    int64_t t2_us = t1s[round] + 1000000 + out_us;
+    synchronizer.OnResponse(sequences[round], t1s[round], t2_us, t2_us, t1s[round] + out_us + 1000);
+  }
+  // A stale sequence and a mismatched t1 with tiny delays must not win.
+  synchronizer.OnResponse(sequences[0] - 1, t1s[0], t1s[0] + 5000000, t1s[0] + 5000000, t1s[0]);
+  synchronizer.OnResponse(sequences[1], t1s[1] + 1, t1s[1] + 5000000, t1s[1] + 5000000, t1s[1]);
+
+  uint32_t sequence;
+  uint32_t t1_us;
+  TEST_ASSERT_TRUE(time_sync::Step::NONE == synchronizer.Poll(now_us, sequence, t1_us));
+  now_us += time_sync::ROUND_TIMEOUT_US;
+  TEST_ASSERT_TRUE(time_sync::Step::FINISHED == synchronizer.Poll(now_us, sequence, t1_us));
+  TEST_ASSERT_TRUE(synchronizer.Succeeded());
+  TEST_ASSERT_EQUAL_INT64(2000, synchronizer.Best().delay_us);
+  TEST_ASSERT_EQUAL_INT64(1000000, synchronizer.Best().offset_us);
+}
+
+void test_local_extends_across_micros_wrap() {
+  time_sync::Clock clock;
+  int64_t before = clock.Local(0xFFFFF000u);
+  int64_t after = clock.Local(0x00001000u);
+  TEST_ASSERT_EQUAL_INT64(0x2000, after - before);
+  // A reading taken just before the newest one does not move the clock back.
+  TEST_ASSERT_EQUAL_INT64(after - 0x100, clock.Local(0x00000F00u));
+  TEST_ASSERT_EQUAL_INT64(after, clock.Local(0x00001000u));
+}
+
+// A day of syncs every RESYNC_INTERVAL_US. The drift estimate converges on the crystal error, and
+// the clock stays close to the client's just before each resync, when it has drifted the most.
+// Without drift correction it would be 24 ms off by then.
+void test_offset_and_drift_converge() {
+  std::mt19937 random(1);
+  time_sync::Synchronizer synchronizer;
+  time_sync::Clock clock;
+  clock.SetCoarse((uint32_t)(EPOCH_AT_ZERO_US / 1000000), NodeLocal(0));
+  // The whole second epoch is up to a second off.
+  TEST_ASSERT_INT64_WITHIN(1000000, 0, ClockError(clock, 0));
+
+  // Offset is epoch minus local, so a fast crystal shows as a negative drift.
+  const int32_t expected_ppb = (int32_t)(-CRYSTAL_ERROR / (1 + CRYSTAL_ERROR) * 1e9);
+  constexpr int SYNCS = 144;
+  constexpr int SETTLING_SYNCS = 3;
+  double true_us = 0;
+  int64_t drift_sum_ppb = 0;
+  for (int sync = 0; sync < SYNCS; ++sync) {
+    double finished_us = RunSync(synchronizer, true_us, random);
+    TEST_ASSERT_TRUE(synchronizer.Succeeded());
+    clock.Apply(synchronizer.Best());
+    // Right after a sync the error is the path asymmetry of the least delayed round.
+    TEST_ASSERT_INT64_WITHIN(3000, 0, ClockError(clock, finished_us));
+
+    true_us = TrueFromLocal(NodeLocal(true_us) + time_sync::RESYNC_INTERVAL_US);
+    if (sync >= SETTLING_SYNCS) {
+      // Each estimate carries the offset noise of two syncs over 10 minutes, a few ppm.
+      TEST_ASSERT_INT32_WITHIN(5000, expected_ppb, clock.DriftPpb());
+      TEST_ASSERT_INT64_WITHIN(5000, 0, ClockError(clock, true_us));
+      drift_sum_ppb += clock.DriftPpb();
+    }
+  }
+  TEST_ASSERT_INT64_WITHIN(500, expected_ppb, drift_sum_ppb / (SYNCS - SETTLING_SYNCS));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_measure_symmetric_path);
+  RUN_TEST(test_synchronizer_keeps_fastest_round);
+  RUN_TEST(test_local_extends_across_micros_wrap);
+  RUN_TEST(test_offset_and_drift_converge);
+  return UNITY_END();
+}
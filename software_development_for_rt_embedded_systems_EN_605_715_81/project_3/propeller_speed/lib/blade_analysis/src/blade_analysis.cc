@@ -0,0 +1,353 @@
+#include "blade_analysis.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <random>
+
+namespace blade_analysis {
+
+Analyzer::Analyzer(const Config& config)
+    : config_(config),
+      revolution_(config.blades),
+      chunk_timestamps_(CHUNK),
+      chunk_intervals_(CHUNK),
+      chunk_revolutions_(CHUNK),
+      chunk_blades_(CHUNK),
+      chunk_deviations_(CHUNK),
+      chunk_rpm_(CHUNK),
+      deviation_sum_(config.blades),
+      deviation_square_sum_(config.blades),
+      deviation_count_(config.blades),
+      fft_(config.fft_size),
+      window_(config.fft_size),
+      frame_(config.fft_size),
+      fft_re_(config.fft_size),
+      fft_im_(config.fft_size),
+      power_sum_(config.fft_size / 2 + 1) {
+  // Hann, so the edges of a frame do not leak into every order.
+  for (size_t i = 0; i < config_.fft_size; ++i) {
+    window_[i] = (float)(0.5 - 0.5 * cos(2 * M_PI * i / config_.fft_size));
+    window_square_sum_ += window_[i] * window_[i];
+  }
+}
+
+void Analyzer::Restart() {
+  run_intervals_ = 0;
+  revolution_us_ = 0;
+  mean_interval_us_ = 0;
+  std::fill(revolution_.begin(), revolution_.end(), 0.0f);
+  std::fill(deviation_sum_.begin(), deviation_sum_.end(), 0.0);
+  std::fill(deviation_square_sum_.begin(), deviation_square_sum_.end(), 0.0);
+  std::fill(deviation_count_.begin(), deviation_count_.end(), 0);
+  // A frame spanning the stop would mix two runs.
+  frame_fill_ = 0;
+}
+
+void Analyzer::Add(const uint64_t* timestamps, size_t count) {
+  size_t blades = config_.blades;
+  size_t filled = 0;
+  for (size_t i = 0; i < count; ++i) {
+    uint64_t now_us = timestamps[i];
+    ++edges_;
+    if (!has_last_) {
+      has_last_ = true;
+      last_us_ = now_us;
+      continue;
+    }
+
+    uint64_t interval_us = now_us - last_us_;
+    if (interval_us > config_.stall_us) {
+      // Flush first, the chunk belongs to the run that just ended.
+      ProcessChunk(filled);
+      filled = 0;
+      Restart();
+      ++restarts_;
+      last_us_ = now_us;
+      continue;
+    }
+    if (interval_us < config_.glitch_fraction * mean_interval_us_) {
+      ++glitches_;
+      continue;
+    }
+    last_us_ = now_us;
+
+    // Running sum over the last revolution. Kept in double so it does not drift over hours.
+    float interval = (float)interval_us;
+    size_t slot = run_intervals_ % blades;
+    revolution_us_ += interval - revolution_[slot];
+    revolution_[slot] = interval;
+    ++run_intervals_;
+    mean_interval_us_ = run_intervals_ < blades ? interval : (float)revolution_us_ / blades;
+
+    chunk_timestamps_[filled] = now_us;
+    chunk_intervals_[filled] = interval;
+    chunk_revolutions_[filled] = run_intervals_ < blades ? 0.0f : (float)revolution_us_;
+    // Blade 0 is the first pass after the start, the interval belongs to the pass ending it.
+    chunk_blades_[filled] = run_intervals_ % blades;
+    if (++filled == CHUNK) {
+      ProcessChunk(filled);
+      filled = 0;
+    }
+  }
+  ProcessChunk(filled);
+}
+
+void Analyzer::ProcessChunk(size_t count) {
+  if (count == 0) {
+    return;
+  }
+
+  const float* intervals = chunk_intervals_.data();
+  const float* revolutions = chunk_revolutions_.data();
+  float* deviations = chunk_deviations_.data();
+  float* rpm = chunk_rpm_.data();
+  float blades = (float)config_.blades;
+
+  // Intervals before the first full revolution have a revolution of 0 and come out as 0 here,
+  // the branch free select keeps the loop vectorized.
+  for (size_t i = 0; i < count; ++i) {
+    float valid = revolutions[i] > 0 ? 1.0f : 0.0f;
+    float inverse = valid / (revolutions[i] + (1.0f - valid));
+    deviations[i] = valid * (intervals[i] * blades * inverse - 1.0f);
+    rpm[i] = 60e6f * inverse;
+  }
+
+  const uint32_t* chunk_blades = chunk_blades_.data();
+  for (size_t i = 0; i < count; ++i) {
+    if (revolutions[i] > 0) {
+      uint32_t blade = chunk_blades[i];
+      deviation_sum_[blade] += deviations[i];
+      deviation_square_sum_[blade] += (double)deviations[i] * deviations[i];
+      ++deviation_count_[blade];
+    }
+  }
+
+  float rpm_sum = 0;
+  float rpm_min = INFINITY;
+  float rpm_max = 0;
+  size_t passes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    bool valid = rpm[i] > 0;
+    rpm_sum += rpm[i];
+    rpm_min = valid && rpm[i] < rpm_min ? rpm[i] : rpm_min;
+    rpm_max = rpm[i] > rpm_max ? rpm[i] : rpm_max;
+    passes += valid;
+  }
+  if (passes > 0) {
+    speed_.min_rpm = speed_.passes == 0 ? rpm_min : std::min(speed_.min_rpm, (double)rpm_min);
+    speed_.max_rpm = std::max(speed_.max_rpm, (double)rpm_max);
+    speed_.passes += passes;
+    rpm_sum_ += rpm_sum;
+    speed_.mean_rpm = rpm_sum_ / speed_.passes;
+  }
+
+  if (speed_callback_) {
+    for (size_t i = 0; i < count; ++i) {
+      if (rpm[i] > 0) {
+        speed_callback_(chunk_timestamps_[i], rpm[i]);
+      }
+    }
+  }
+
+  AddToSpectrum(intervals, count);
+}
+
+void Analyzer::AddToSpectrum(const float* intervals, size_t count) {
+  size_t size = config_.fft_size;
+  while (count > 0) {
+    size_t taken = std::min(count, size - frame_fill_);
+    std::copy(intervals, intervals + taken, frame_.begin() + frame_fill_);
+    frame_fill_ += taken;
+    intervals += taken;
+    count -= taken;
+    if (frame_fill_ < size) {
+      return;
+    }
+    frame_fill_ = 0;
+
+    double sum = 0;
+    for (size_t i = 0; i < size; ++i) {
+      sum += frame_[i];
+    }
+    float mean = (float)(sum / size);
+
+    float* re = fft_re_.data();
+    float* im = fft_im_.data();
+    const float* frame = frame_.data();
+    const float* window = window_.data();
+    for (size_t i = 0; i < size; ++i) {
+      re[i] = (frame[i] - mean) * window[i];
+      im[i] = 0;
+    }
+    fft_.Forward(re, im);
+
+    double* power = power_sum_.data();
+    for (size_t i = 0; i <= size / 2; ++i) {
+      power[i] += re[i] * re[i] + im[i] * im[i];
+    }
+    frame_mean_sum_ += mean;
+    ++spectrum_frames_;
+  }
+}
+
+std::vector<BladeStats> Analyzer::Blades() const {
+  std::vector<BladeStats> blades(config_.blades);
+  for (size_t i = 0; i < blades.size(); ++i) {
+    uint64_t count = deviation_count_[i];
+    blades[i].intervals = count;
+    if (count == 0) {
+      continue;
+    }
+    double mean = deviation_sum_[i] / count;
+    double variance = deviation_square_sum_[i] / count - mean * mean;
+    blades[i].mean_deviation = mean;
+    blades[i].stddev = variance > 0 ? sqrt(variance) : 0;
+  }
+  return blades;
+}
+
+std::vector<double> Analyzer::PositionErrorsDeg() const {
+  // The interval ending at blade i spans from blade i - 1 to blade i, so the positions are the
+  // running sum of the deviations.
+  std::vector<BladeStats> blades = Blades();
+  std::vector<double> positions(blades.size());
+  double pitch_deg = 360.0 / blades.size();
+  double position = 0;
+  double mean = 0;
+  for (size_t i = 1; i < blades.size(); ++i) {
+    position += blades[i].mean_deviation * pitch_deg;
+    positions[i] = position;
+    mean += position;
+  }
+  mean /= blades.size();
+  for (double& p : positions) {
+    p -= mean;
+  }
+  return positions;
+}
+
+SpeedStats Analyzer::Speed() const {
+  return speed_;
+}
+
+std::vector<OrderBin> Analyzer::Spectrum() const {
+  std::vector<OrderBin> bins;
+  if (spectrum_frames_ == 0) {
+    return bins;
+  }
+
+  // The window spreads a line over the bins next to it, how much depends on where it falls between
+  // two bins. Every bin is therefore added to the line it leaked from, the local maximum it reaches
+  // by climbing towards its stronger neighbour. Climbing never turns, so one pass each way finds
+  // them all.
+  size_t size = config_.fft_size;
+  size_t last = size / 2;
+  auto uphill = [&](size_t i) {
+    size_t next = i;
+    if (i > 1 && power_sum_[i - 1] > power_sum_[next]) {
+      next = i - 1;
+    }
+    if (i < last && power_sum_[i + 1] > power_sum_[next]) {
+      next = i + 1;
+    }
+    return next;
+  };
+  std::vector<size_t> peaks(last + 1);
+  for (size_t i = 1; i <= last; ++i) {
+    size_t next = uphill(i);
+    peaks[i] = next == i ? i : peaks[next];
+  }
+  for (size_t i = last; i >= 1; --i) {
+    if (uphill(i) > i) {
+      peaks[i] = peaks[i + 1];
+    }
+  }
+
+  // By Parseval the bins of a sine of amplitude A add up to (A / 2)^2 * N * window square sum,
+  // wherever it falls. At the Nyquist bin, order blades / 2, the intervals alternate between +A and
+  // -A. That is a single line of A^2 * N * window square sum, which leaks into the bins above
+  // Nyquist as much as into those below. With two blades it is order 1.
+  std::vector<double> line_power(last + 1);
+  for (size_t i = 1; i <= last; ++i) {
+    line_power[peaks[i]] += peaks[i] == last && i != last ? 2 * power_sum_[i] : power_sum_[i];
+  }
+  double mean_interval = frame_mean_sum_ / spectrum_frames_;
+  double full_power = (double)size * window_square_sum_ * spectrum_frames_;
+  for (size_t i = 1; i <= last; ++i) {
+    double order = (double)i * config_.blades / size;
+    double amplitude = sqrt(line_power[i] / full_power) * (i == last ? 1 : 2);
+    bins.push_back({order, amplitude / mean_interval * 100});
+  }
+  return bins;
+}
+
+namespace {
+
+double OffsetDeg(const TraceConfig& config, size_t blade) {
+  return blade < config.blade_offsets_deg.size() ? config.blade_offsets_deg[blade] : 0;
+}
+
+// Angle of pass `i`, radians.
+double PassAngle(const TraceConfig& config, size_t i) {
+  size_t blade = i % config.blades;
+  return 2 * M_PI * ((double)i + OffsetDeg(config, blade) * config.blades / 360) / config.blades;
+}
+
+// Time the shaft takes from angle 0 to `angle`, in units of 1 / speed. For a speed of
+// w (1 + a sin(angle)) this is, to first order in a, angle + a cos(angle) - a.
+double TurnTime(const TraceConfig& config, double angle) {
+  double a = config.once_per_rev_percent / 100;
+  return angle + a * cos(angle) - a;
+}
+
+} // namespace
+
+std::vector<uint64_t> Synthesize(const TraceConfig& config) {
+  double w = config.rpm * 2 * M_PI / 60e6;
+  size_t count = (size_t)(config.seconds * config.rpm / 60 * config.blades);
+
+  std::mt19937 random(config.seed);
+  std::normal_distribution<double> jitter(0, config.jitter_us);
+
+  std::vector<uint64_t> timestamps(count);
+  double start_us = 1000000;
+  for (size_t i = 0; i < count; ++i) {
+    double t = TurnTime(config, PassAngle(config, i)) / w;
+    timestamps[i] = (uint64_t)llround(start_us + t + (config.jitter_us > 0 ? jitter(random) : 0));
+  }
+  return timestamps;
+}
+
+std::vector<double> ExpectedDeviations(const TraceConfig& config) {
+  // Passes blades and blades + 1 are the same as 0 and 1 a revolution later, which takes 2 pi.
+  std::vector<double> deviations(config.blades);
+  for (size_t i = 0; i < config.blades; ++i) {
+    size_t pass = config.blades + i;
+    double interval = TurnTime(config, PassAngle(config, pass)) -
+                      TurnTime(config, PassAngle(config, pass - 1));
+    deviations[i] = interval * config.blades / (2 * M_PI) - 1;
+  }
+  return deviations;
+}
+
+std::vector<OrderBin> ExpectedOrders(const TraceConfig& config) {
+  // The Fourier series of the per blade deviations, one revolution long.
+  std::vector<double> deviations = ExpectedDeviations(config);
+  size_t blades = config.blades;
+  std::vector<OrderBin> orders;
+  for (size_t order = 1; order <= blades / 2; ++order) {
+    double re = 0;
+    double im = 0;
+    for (size_t i = 0; i < blades; ++i) {
+      double angle = 2 * M_PI * order * i / blades;
+      re += deviations[i] * cos(angle);
+      im -= deviations[i] * sin(angle);
+    }
+    double amplitude = sqrt(re * re + im * im) / blades;
+    orders.push_back({(double)order, (2 * order == blades ? amplitude : 2 * amplitude) * 100});
+  }
+  return orders;
+}
+
+} // blade_analysis
@@ -0,0 +1,188 @@
+#ifndef BLADE_ANALYSIS_H
+#define BLADE_ANALYSIS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+#include "fft.h"
+
+// Host side analysis of the raw blade pass timestamps the node streams (see edge_stream.h), live or
+// from a capture. For every interval between two passes it works out
+//
+//   deviation  how much longer or shorter the interval is than its share of the revolution it ends,
+//              averaged per blade. Unevenly spaced or tracking blades show up as a fixed pattern,
+//              an imbalance that slows the rotor once per revolution as a spread in it.
+//   speed      60 / the revolution ending at that pass, so it is updated on every pass.
+//   orders     the spectrum of the intervals against shaft angle rather than time. Intervals are
+//              taken blades times per revolution, so bin j of an N point FFT is order j * blades /
+//              N and orders up to blades / 2 are resolved. Order 1 is once per revolution.
+//
+// Edges are processed in chunks: the order dependent bookkeeping runs once per edge, then the
+// arithmetic runs as plain loops over contiguous float arrays which the compiler vectorizes. The
+// analyzer is incremental, any chunk size can be added at any time, and keeps a fixed amount of
+// state however long the stream runs.
+//
+// Blades are numbered from the first pass after the rotor started, so their numbers only stay the
+// same for as long as it keeps turning. Statistics restart along with the numbering.
+
+namespace blade_analysis {
+
+// The Hann window spreads a line over 4 bins, so spectrum frames must span at least this many
+// revolutions for the lines of two orders to stay apart.
+inline constexpr size_t MIN_FFT_REVOLUTIONS = 4;
+
+struct Config {
+  size_t blades = 2;
+  // Intervals shorter than this share of the mean interval are bounce, the edge is dropped.
+  float glitch_fraction = 0.25f;
+  // A longer gap between passes means the rotor stopped.
+  uint64_t stall_us = 2000000;
+  // Intervals per spectrum frame, a power of two of at least MIN_FFT_REVOLUTIONS * blades.
+  size_t fft_size = 4096;
+};
+
+struct BladeStats {
+  uint64_t intervals = 0;
+  // Interval ending at this blade relative to its share of the revolution, 0 for even spacing.
+  double mean_deviation = 0;
+  double stddev = 0;
+};
+
+struct SpeedStats {
+  uint64_t passes = 0;
+  double mean_rpm = 0;
+  double min_rpm = 0;
+  double max_rpm = 0;
+};
+
+struct OrderBin {
+  double order;
+  // Amplitude of the interval variation at this order, in percent of the mean interval.
+  double amplitude_percent;
+};
+
+// Called for every pass that completes a revolution with the speed at that pass.
+using SpeedCallback = std::function<void(uint64_t timestamp_us, float rpm)>;
+
+class Analyzer {
+ public:
+  explicit Analyzer(const Config& config);
+
+  void SetSpeedCallback(SpeedCallback callback) {
+    speed_callback_ = std::move(callback);
+  }
+
+  // Adds the next passes of the stream, in microseconds.
+  void Add(const uint64_t* timestamps, size_t count);
+
+  // One entry per blade, since the rotor last started turning.
+  std::vector<BladeStats> Blades() const;
+
+  // Blade positions in degrees relative to evenly spaced blades, derived from the mean
+  // deviations, with their mean at 0.
+  std::vector<double> PositionErrorsDeg() const;
+
+  SpeedStats Speed() const;
+
+  // Mean amplitude of every order over the spectrum frames completed so far, empty before the
+  // first one. Bin 0 is left out, the last bin is order blades / 2. The leakage of a line into the
+  // bins around it is added to the line, those bins are 0.
+  std::vector<OrderBin> Spectrum() const;
+
+  uint64_t Edges() const {
+    return edges_;
+  }
+
+  uint64_t Glitches() const {
+    return glitches_;
+  }
+
+  // Times the rotor stopped and started again.
+  uint64_t Restarts() const {
+    return restarts_;
+  }
+
+  uint64_t SpectrumFrames() const {
+    return spectrum_frames_;
+  }
+
+ private:
+  static constexpr size_t CHUNK = 4096;
+
+  void Restart();
+  void ProcessChunk(size_t count);
+  void AddToSpectrum(const float* intervals, size_t count);
+
+  Config config_;
+  SpeedCallback speed_callback_;
+
+  bool has_last_ = false;
+  uint64_t last_us_ = 0;
+  // Intervals since the rotor started turning, the blade of an interval is this modulo blades.
+  uint64_t run_intervals_ = 0;
+  // The last `blades` intervals and their sum, one revolution.
+  std::vector<float> revolution_;
+  double revolution_us_ = 0;
+  float mean_interval_us_ = 0;
+
+  // Chunk being processed, struct of arrays.
+  std::vector<uint64_t> chunk_timestamps_;
+  std::vector<float> chunk_intervals_;
+  std::vector<float> chunk_revolutions_;
+  std::vector<uint32_t> chunk_blades_;
+  std::vector<float> chunk_deviations_;
+  std::vector<float> chunk_rpm_;
+
+  std::vector<double> deviation_sum_;
+  std::vector<double> deviation_square_sum_;
+  std::vector<uint64_t> deviation_count_;
+
+  SpeedStats speed_;
+  double rpm_sum_ = 0;
+
+  Fft fft_;
+  std::vector<float> window_;
+  double window_square_sum_ = 0;
+  std::vector<float> frame_;
+  size_t frame_fill_ = 0;
+  std::vector<float> fft_re_;
+  std::vector<float> fft_im_;
+  std::vector<double> power_sum_;
+  double frame_mean_sum_ = 0;
+  uint64_t spectrum_frames_ = 0;
+
+  uint64_t edges_ = 0;
+  uint64_t glitches_ = 0;
+  uint64_t restarts_ = 0;
+};
+
+// Synthetic pass timestamps of a rotor with known faults, for benchmarks.
+struct TraceConfig {
+  size_t blades = 2;
+  double rpm = 3000;
+  // Angle each blade sits away from even spacing, degrees. Missing blades are at 0.
+  std::vector<double> blade_offsets_deg;
+  // Speed variation once per revolution, percent.
+  double once_per_rev_percent = 0;
+  // Standard deviation of the timestamp noise, microseconds.
+  double jitter_us = 1;
+  double seconds = 10;
+  uint32_t seed = 1;
+};
+
+std::vector<uint64_t> Synthesize(const TraceConfig& config);
+
+// Interval deviations Analyzer::Blades() should find for `config`, one per blade.
+std::vector<double> ExpectedDeviations(const TraceConfig& config);
+
+// Orders 1 to blades / 2 and the amplitudes Analyzer::Spectrum() should find at them for `config`.
+// The deviations repeat every revolution, so the spectrum has lines at whole orders only, carrying
+// both the blade offsets and the once per revolution speed variation.
+std::vector<OrderBin> ExpectedOrders(const TraceConfig& config);
+
+} // blade_analysis
+
+#endif // BLADE_ANALYSIS_H
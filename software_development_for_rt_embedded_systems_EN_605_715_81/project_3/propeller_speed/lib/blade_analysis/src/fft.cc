@@ -0,0 +1,60 @@
+#include "fft.h"
+
+#include <math.h>
+
+#include <utility>
+
+namespace blade_analysis {
+
+Fft::Fft(size_t size) : size_(size), reversed_(size), cos_(size / 2), sin_(size / 2) {
+  size_t bits = 0;
+  while ((size_t)1 << bits < size_) {
+    ++bits;
+  }
+
+  for (size_t i = 0; i < size_; ++i) {
+    size_t reversed = 0;
+    for (size_t bit = 0; bit < bits; ++bit) {
+      reversed |= (i >> bit & 1) << (bits - 1 - bit);
+    }
+    reversed_[i] = reversed;
+  }
+
+  for (size_t i = 0; i < size_ / 2; ++i) {
+    double angle = -2 * M_PI * i / size_;
+    cos_[i] = (float)cos(angle);
+    sin_[i] = (float)sin(angle);
+  }
+}
+
+void Fft::Forward(float* re, float* im) const {
+  for (size_t i = 0; i < size_; ++i) {
+    size_t j = reversed_[i];
+    if (i < j) {
+      std::swap(re[i], re[j]);
+      std::swap(im[i], im[j]);
+    }
+  }
+
+  for (size_t half = 1; half < size_; half *= 2) {
+    size_t stride = size_ / (2 * half);
+    for (size_t start = 0; start < size_; start += 2 * half) {
+      float* re_a = re + start;
+      float* im_a = im + start;
+      float* re_b = re_a + half;
+      float* im_b = im_a + half;
+      for (size_t k = 0; k < half; ++k) {
+        float w_re = cos_[k * stride];
+        float w_im = sin_[k * stride];
+        float t_re = re_b[k] * w_re - im_b[k] * w_im;
+        float t_im = re_b[k] * w_im + im_b[k] * w_re;
+        re_b[k] = re_a[k] - t_re;
+        im_b[k] = im_a[k] - t_im;
+        re_a[k] += t_re;
+        im_a[k] += t_im;
+      }
+    }
+  }
+}
+
+} // blade_analysis
@@ -0,0 +1,33 @@
+#ifndef BLADE_ANALYSIS_FFT_H
+#define BLADE_ANALYSIS_FFT_H
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace blade_analysis {
+
+// In place radix 2 FFT of a fixed power of two size. Twiddles and the bit reversal permutation are
+// computed once, and the real and imaginary parts are kept in separate arrays so every butterfly
+// pass is a straight loop over contiguous floats the compiler can vectorize.
+class Fft {
+ public:
+  explicit Fft(size_t size);
+
+  size_t Size() const {
+    return size_;
+  }
+
+  // Transforms `re` and `im`, each Size() floats, in place.
+  void Forward(float* re, float* im) const;
+
+ private:
+  size_t size_;
+  std::vector<size_t> reversed_;
+  std::vector<float> cos_;
+  std::vector<float> sin_;
+};
+
+} // blade_analysis
+
+#endif // BLADE_ANALYSIS_FFT_H
@@ -0,0 +1,124 @@
+#ifndef BLADE_TIMING_H
+#define BLADE_TIMING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Speed from the period between blade passes instead of passes counted over a window. Counting two
+// blades over one second resolves 30 RPM and lags by that second, while a period measured with
+// micros() resolves a fraction of an RPM and is available after every revolution.
+//
+// The ISR timestamps each pass into an EdgeRecorder, which rejects phototransistor bounce: an edge
+// closer than the debounce time, or than a quarter of the last period, to the previous pass is
+// counted as a glitch and dropped. The speed is the median of the last PERIOD_WINDOW periods, so a
+// single missed or extra edge does not move it. While no edge arrives the open period since the
+// last pass bounds the speed from above, so a slowing rotor reads ever slower until it is declared
+// stalled after the stall time.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace blade_timing {
+
+// Covers a few revolutions at two blades, enough for the median to ride out single glitches.
+inline constexpr size_t PERIOD_WINDOW = 8;
+
+struct Config {
+  uint8_t blades;
+  // Edges closer than this to the last pass are bounce.
+  uint32_t debounce_us;
+  // Longest period still counted as turning. A pass after a longer gap starts a new measurement.
+  uint32_t stall_us;
+};
+
+// Filled from the blade pass ISR and copied out with interrupts disabled, which is a handful of
+// words.
+class EdgeRecorder {
+ public:
+  void OnEdge(const Config& config, uint32_t now_us) {
+    if (edges_ != 0) {
+      uint32_t period_us = now_us - last_us_;
+      if (period_us < config.debounce_us || period_us < last_period_us_ / 4) {
+        ++glitches_;
+        return;
+      }
+
+      if (period_us > config.stall_us) {
+        edges_ = 0;
+      } else {
+        periods_[next_] = period_us;
+        next_ = (next_ + 1) % PERIOD_WINDOW;
+        last_period_us_ = period_us;
+      }
+    }
+
+    if (edges_ == 0) {
+      last_period_us_ = 0;
+    }
+    if (edges_ <= PERIOD_WINDOW) {
+      ++edges_;
+    }
+    last_us_ = now_us;
+  }
+
+  // Periods held, at most PERIOD_WINDOW.
+  size_t Periods() const {
+    return edges_ == 0 ? 0 : edges_ - 1;
+  }
+
+  uint32_t LastEdgeUs() const {
+    return last_us_;
+  }
+
+  // Edges dropped as bounce since startup.
+  uint32_t Glitches() const {
+    return glitches_;
+  }
+
+  // Median of the periods held, 0 without any.
+  uint32_t MedianPeriodUs() const {
+    size_t count = Periods();
+    uint32_t sorted[PERIOD_WINDOW];
+    for (size_t i = 0; i < count; ++i) {
+      // The newest periods sit just before next_.
+      uint32_t period_us = periods_[(next_ + PERIOD_WINDOW - 1 - i) % PERIOD_WINDOW];
+      size_t j = i;
+      for (; j > 0 && sorted[j - 1] > period_us; --j) {
+        sorted[j] = sorted[j - 1];
+      }
+      sorted[j] = period_us;
+    }
+
+    if (count == 0) {
+      return 0;
+    }
+    return count % 2 == 1 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+  }
+
+ private:
+  uint32_t periods_[PERIOD_WINDOW] = {};
+  size_t next_ = 0;
+  // Edges since the rotor last started turning, capped at PERIOD_WINDOW + 1.
+  size_t edges_ = 0;
+  uint32_t last_us_ = 0;
+  uint32_t last_period_us_ = 0;
+  uint32_t glitches_ = 0;
+};
+
+// Revolutions per minute at `now_us` from a copy of the recorder, 0 while stalled or before two
+// passes were seen.
+inline float Rpm(const Config& config, const EdgeRecorder& recorder, uint32_t now_us) {
+  uint32_t period_us = recorder.MedianPeriodUs();
+  uint32_t open_us = now_us - recorder.LastEdgeUs();
+  if (period_us == 0 || open_us > config.stall_us) {
+    return 0;
+  }
+
+  if (open_us > period_us) {
+    period_us = open_us;
+  }
+  return 60e6f / ((float)period_us * config.blades);
+}
+
+} // blade_timing
+
+#endif // BLADE_TIMING_H
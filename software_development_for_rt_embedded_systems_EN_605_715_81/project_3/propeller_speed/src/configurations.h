@@ -8,6 +8,50 @@ namespace wifi_configs {
 inline constexpr char* SSID = "FibreBox_X6-421B57";
 inline constexpr char* PWD = "Enter Your Password Here";
 inline constexpr int PORT = 12345;
+// Identifies this node in every telemetry frame it sends.
+inline constexpr uint8_t NODE_ID = 2;
+// Reported by the GET_VERSION command.
+inline constexpr uint8_t FIRMWARE_VERSION_MAJOR = 2;
+inline constexpr uint8_t FIRMWARE_VERSION_MINOR = 1;
+inline constexpr uint8_t FIRMWARE_VERSION_PATCH = 0;
+
+// Range a client can set the transmit interval to with the SET_INTERVAL command.
+inline constexpr unsigned long MIN_TRANSMIT_INTERVAL_MS = 100;
+inline constexpr unsigned long MAX_TRANSMIT_INTERVAL_MS = 60000;
+
+// Send every telemetry frame once to a multicast group instead of to each subscriber. Clients then
+// join the group rather than subscribe, and rate dividers do not apply.
+inline constexpr bool MULTICAST_ENABLED = false;
+inline constexpr uint8_t MULTICAST_GROUP[4] = {239, 255, 0, 2};
+inline constexpr int MULTICAST_PORT = 12345;
+
+// Deadband compression, see deadband.h. A sample is only sent when it moved more than
+// DEADBAND_RPM away from the last one sent, or after HEARTBEAT_MS without sending. A deadband of 0
+// sends every sample.
+inline constexpr float DEADBAND_RPM = 10.0f;
+inline constexpr unsigned long HEARTBEAT_MS = 60000;
+
+// While nobody is subscribed samples are kept in the flash log, see flash_log.h. Once a subscriber
+// is back a batch of REPLAY_BATCH_SAMPLES logged samples, at most telemetry::MAX_BATCH_SAMPLES, is
+// replayed every REPLAY_INTERVAL_MS, so the backlog drains quickly while live samples get through.
+inline constexpr size_t REPLAY_BATCH_SAMPLES = 32;
+inline constexpr unsigned long REPLAY_INTERVAL_MS = 100;
+
+// Rotors measured by this node, one IR sensor each on the pins listed in main.cpp. With 1 the
+// rotor on pin 3 is measured and sent in sample frames. Up to 4, e.g. for a quadcopter rig, are
+// sent together in channels frames. Only channel 0 is kept in the flash log while nobody is
+// subscribed and rolled up, the other channels are only ever sent live.
+inline constexpr size_t ROTOR_CHANNELS = 1;
+
+// Stream every blade pass timestamp of one channel to the listeners, see edge_stream.h. Edges are
+// sent once EDGE_FRAME_MIN_EDGES are waiting, so frames are well filled at high speed, or at the
+// latest EDGE_FLUSH_INTERVAL_MS after the last frame. One run of the task sends at most
+// EDGE_FRAMES_PER_RUN frames.
+inline constexpr bool EDGE_STREAM_ENABLED = true;
+inline constexpr size_t EDGE_STREAM_CHANNEL = 0;
+inline constexpr size_t EDGE_FRAME_MIN_EDGES = 256;
+inline constexpr unsigned long EDGE_FLUSH_INTERVAL_MS = 100;
+inline constexpr size_t EDGE_FRAMES_PER_RUN = 2;
 
 inline int ConnectToWiFi(const char* ssid = SSID, const char* password = PWD) {
     if (!WiFi.begin(ssid, password)) {
@@ -0,0 +1,86 @@
+#ifndef DEADBAND_H
+#define DEADBAND_H
+
+#include <math.h>
+#include <stdint.h>
+
+// Report on change compression. A sample is only sent when it moved more than the threshold away
+// from the last sent value, or as a heartbeat when nothing was sent for the heartbeat interval.
+// Between two sent samples the value stayed within the threshold of the first, so the client
+// rebuilds the series by holding each value until the next one arrives, and a heartbeat tells it
+// that the node is still there while the value holds.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace deadband {
+
+enum class Decision {
+  SEND,
+  // Send, flagged as a heartbeat since the value did not move beyond the threshold.
+  HEARTBEAT,
+  SUPPRESS,
+};
+
+class Filter {
+ public:
+  // A threshold of 0 sends every sample.
+  void Configure(float threshold, unsigned long heartbeat_ms) {
+    threshold_ = threshold;
+    heartbeat_ms_ = heartbeat_ms;
+  }
+
+  Decision Check(float value, unsigned long now_ms) {
+    ++taken_;
+    Decision decision = Decision::SUPPRESS;
+    if (!has_sent_ || threshold_ <= 0 || fabsf(value - sent_value_) > threshold_) {
+      decision = Decision::SEND;
+    } else if (now_ms - sent_ms_ >= heartbeat_ms_) {
+      decision = Decision::HEARTBEAT;
+    } else {
+      return decision;
+    }
+
+    ++sent_;
+    has_sent_ = true;
+    sent_value_ = value;
+    sent_ms_ = now_ms;
+    return decision;
+  }
+
+  // Sends the next sample whatever its value, e.g. for a subscriber that just joined.
+  void Reset() {
+    has_sent_ = false;
+  }
+
+  void ResetCounts() {
+    taken_ = 0;
+    sent_ = 0;
+  }
+
+  // Samples checked and sent since the last ResetCounts().
+  uint32_t Taken() const {
+    return taken_;
+  }
+
+  uint32_t Sent() const {
+    return sent_;
+  }
+
+  // Samples taken per sample sent, 1 without compression.
+  float CompressionRatio() const {
+    return sent_ == 0 ? 1.0f : (float)taken_ / sent_;
+  }
+
+ private:
+  float threshold_ = 0;
+  unsigned long heartbeat_ms_ = 0;
+  bool has_sent_ = false;
+  float sent_value_ = 0;
+  unsigned long sent_ms_ = 0;
+  uint32_t taken_ = 0;
+  uint32_t sent_ = 0;
+};
+
+} // deadband
+
+#endif // DEADBAND_H
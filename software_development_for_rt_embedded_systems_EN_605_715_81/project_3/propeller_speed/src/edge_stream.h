@@ -0,0 +1,113 @@
+#ifndef EDGE_STREAM_H
+#define EDGE_STREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+#include "telemetry.h"
+
+// Every blade pass timestamp, streamed to the client for vibration and balance analysis. The blade
+// pass ISR pushes micros() into a single producer, single consumer ring and a scheduler task
+// drains it into edges frames (see telemetry.h). Consecutive edges are close together, so their
+// deltas are sent as varints: one byte below 128 us, two below 16 ms. At 10000 edges per second a
+// 1 KB frame carries a tenth of a second.
+//
+// The ISR never waits. When the ring is full the edge is dropped and counted, and the count is
+// carried in every frame so the client sees the drops.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace edge_stream {
+
+// A power of two, so the free running indices wrap cleanly. 100 ms at 10000 edges per second, to
+// ride out the WiFi bridge blocking a send.
+inline constexpr size_t RING_CAPACITY = 1024;
+static_assert((RING_CAPACITY & (RING_CAPACITY - 1)) == 0, "RING_CAPACITY must be a power of two");
+
+// Head and tail only ever increase. The producer is the only writer of the tail and the consumer
+// the only writer of the head, so each side publishes its index with a release store after the
+// slot it covers and reads the other side's with an acquire load. No compare and swap and no
+// disabled interrupts are needed.
+class Ring {
+ public:
+  // Called from the ISR only.
+  void Push(uint32_t timestamp_us) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == RING_CAPACITY) {
+      overflows_.store(overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return;
+    }
+
+    slots_[tail % RING_CAPACITY] = timestamp_us;
+    tail_.store(tail + 1, std::memory_order_release);
+  }
+
+  // Edges waiting, called from the consumer.
+  size_t Size() const {
+    return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_relaxed);
+  }
+
+  // Edges taken out by the consumer since startup.
+  uint32_t Taken() const {
+    return head_.load(std::memory_order_relaxed);
+  }
+
+  // Edges dropped since startup because the ring was full.
+  uint32_t Overflows() const {
+    return overflows_.load(std::memory_order_relaxed);
+  }
+
+  // The oldest waiting edge. Only valid while Size() > 0.
+  uint32_t Front() const {
+    return slots_[head_.load(std::memory_order_relaxed) % RING_CAPACITY];
+  }
+
+  void Pop() {
+    head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+ private:
+  uint32_t slots_[RING_CAPACITY];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> overflows_{0};
+};
+
+// Moves as many waiting edges as fit into an edges frame in `buffer`, which must hold
+// MAX_EDGES_FRAME_SIZE bytes. Returns the frame length, 0 if no edge was waiting.
+inline size_t EncodeFrame(Ring& ring, uint8_t* buffer, uint8_t node_id, uint32_t sequence) {
+  size_t waiting = ring.Size();
+  if (waiting == 0) {
+    return 0;
+  }
+
+  uint8_t* cursor = telemetry::PutHeader(buffer, telemetry::FrameType::EDGES, node_id, 0,
+                                         sequence);
+  cursor = telemetry::PutU32(cursor, ring.Taken());
+  cursor = telemetry::PutU32(cursor, ring.Overflows());
+  uint8_t* count_field = cursor;
+  cursor += 2;
+
+  uint32_t previous_us = ring.Front();
+  ring.Pop();
+  cursor = telemetry::PutU32(cursor, previous_us);
+  uint16_t count = 1;
+
+  const uint8_t* end = buffer + telemetry::MAX_EDGES_FRAME_SIZE - telemetry::MAX_VARINT_SIZE;
+  while (--waiting > 0 && cursor <= end && count < UINT16_MAX) {
+    uint32_t timestamp_us = ring.Front();
+    ring.Pop();
+    cursor = telemetry::PutVarint(cursor, timestamp_us - previous_us);
+    previous_us = timestamp_us;
+    ++count;
+  }
+
+  telemetry::PutU16(count_field, count);
+  return cursor - buffer;
+}
+
+} // edge_stream
+
+#endif // EDGE_STREAM_H
@@ -0,0 +1,282 @@
+// Command line front end of the blade analysis library, built by the native environment:
+//
+//   pio run -e native
+//   .pio/build/native/program analyze <capture> [--blades N] [--fft N]
+//   .pio/build/native/program bench [--blades N] [--rpm N] [--hours N] [--offsets D,D,...]
+//                                   [--once-per-rev P] [--jitter US]
+//
+// analyze reads a capture written by the plotter client (EDGE_CAPTURE_PATH), one timestamp in
+// microseconds per line. bench synthesizes a trace with known blade offsets, times the analysis of
+// it and compares what was found against what was put in, exiting with 1 if the deviations or the
+// spectrum are off by more than the tolerances below.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "blade_analysis.h"
+
+namespace {
+
+// Edges handed to the analyzer at a time while reading a capture.
+constexpr size_t READ_CHUNK = 65536;
+
+// How far bench results may be from the synthesized faults. Deviations are a fraction of the
+// interval, order amplitudes are in percent with a relative and an absolute part, the absolute one
+// covering the noise floor the jitter leaves in every bin.
+constexpr double DEVIATION_TOLERANCE = 1e-4;
+constexpr double ORDER_TOLERANCE = 0.02;
+constexpr double ORDER_TOLERANCE_PERCENT = 0.005;
+
+void PrintUsage() {
+  fprintf(stderr,
+          "usage: program analyze <capture> [--blades N] [--fft N]\n"
+          "       program bench [--blades N] [--rpm N] [--hours N] [--offsets D,D,...]\n"
+          "                     [--once-per-rev P] [--jitter US] [--fft N]\n");
+}
+
+const char* Option(int argc, char** argv, const char* name) {
+  for (int i = 0; i + 1 < argc; ++i) {
+    if (strcmp(argv[i], name) == 0) {
+      return argv[i + 1];
+    }
+  }
+  return nullptr;
+}
+
+double NumberOption(int argc, char** argv, const char* name, double fallback) {
+  const char* value = Option(argc, argv, name);
+  return value == nullptr ? fallback : strtod(value, nullptr);
+}
+
+blade_analysis::Config AnalyzerConfig(int argc, char** argv) {
+  blade_analysis::Config config;
+  config.blades = (size_t)NumberOption(argc, argv, "--blades", 2);
+  config.fft_size = (size_t)NumberOption(argc, argv, "--fft", 4096);
+  return config;
+}
+
+bool IsValid(const blade_analysis::Config& config) {
+  if (config.blades == 0 || config.blades > 64) {
+    fprintf(stderr, "--blades must be 1 - 64\n");
+    return false;
+  }
+  if (config.fft_size < 16 || (config.fft_size & (config.fft_size - 1)) != 0) {
+    fprintf(stderr, "--fft must be a power of two of at least 16\n");
+    return false;
+  }
+  // Orders are fft / blades bins apart, their lines must not share any bins.
+  if (config.fft_size < blade_analysis::MIN_FFT_REVOLUTIONS * config.blades) {
+    fprintf(stderr, "--fft must be at least %zu * --blades\n",
+            blade_analysis::MIN_FFT_REVOLUTIONS);
+    return false;
+  }
+  return true;
+}
+
+void PrintResults(const blade_analysis::Analyzer& analyzer) {
+  blade_analysis::SpeedStats speed = analyzer.Speed();
+  printf("edges %llu, glitches %llu, restarts %llu\n", (unsigned long long)analyzer.Edges(),
+         (unsigned long long)analyzer.Glitches(), (unsigned long long)analyzer.Restarts());
+  printf("speed %.1f RPM mean, %.1f min, %.1f max\n", speed.mean_rpm, speed.min_rpm,
+         speed.max_rpm);
+
+  std::vector<blade_analysis::BladeStats> blades = analyzer.Blades();
+  std::vector<double> positions = analyzer.PositionErrorsDeg();
+  printf("blade  intervals  deviation %%  stddev %%  position deg\n");
+  for (size_t i = 0; i < blades.size(); ++i) {
+    printf("%5zu  %9llu  %11.4f  %8.4f  %12.4f\n", i, (unsigned long long)blades[i].intervals,
+           blades[i].mean_deviation * 100, blades[i].stddev * 100, positions[i]);
+  }
+
+  // The strongest orders only, the full spectrum has fft / 2 bins.
+  std::vector<blade_analysis::OrderBin> bins = analyzer.Spectrum();
+  if (bins.empty()) {
+    printf("no spectrum, fewer intervals than one FFT frame\n");
+    return;
+  }
+  std::vector<blade_analysis::OrderBin> strongest;
+  for (size_t i = 0; i < 5 && i < bins.size(); ++i) {
+    size_t best = 0;
+    for (size_t j = 1; j < bins.size(); ++j) {
+      if (bins[j].amplitude_percent > bins[best].amplitude_percent) {
+        best = j;
+      }
+    }
+    strongest.push_back(bins[best]);
+    bins[best].amplitude_percent = -1;
+  }
+  printf("orders over %llu frames:", (unsigned long long)analyzer.SpectrumFrames());
+  for (const blade_analysis::OrderBin& bin : strongest) {
+    printf(" %.3f (%.4f%%)", bin.order, bin.amplitude_percent);
+  }
+  printf("\n");
+}
+
+// Parses timestamps straight out of the read buffer, strtoull per line is most of the time on
+// multi hour captures. Anything that is not a digit separates numbers.
+int Analyze(const char* path, const blade_analysis::Config& config) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    perror(path);
+    return 1;
+  }
+
+  blade_analysis::Analyzer analyzer(config);
+  std::vector<char> buffer(1 << 20);
+  std::vector<uint64_t> timestamps;
+  timestamps.reserve(READ_CHUNK);
+  uint64_t value = 0;
+  bool in_number = false;
+
+  auto start = std::chrono::steady_clock::now();
+  size_t read;
+  while ((read = fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+    for (size_t i = 0; i < read; ++i) {
+      unsigned digit = (unsigned char)buffer[i] - '0';
+      if (digit < 10) {
+        value = value * 10 + digit;
+        in_number = true;
+        continue;
+      }
+      if (in_number) {
+        timestamps.push_back(value);
+        value = 0;
+        in_number = false;
+        if (timestamps.size() == READ_CHUNK) {
+          analyzer.Add(timestamps.data(), timestamps.size());
+          timestamps.clear();
+        }
+      }
+    }
+  }
+  if (in_number) {
+    timestamps.push_back(value);
+  }
+  analyzer.Add(timestamps.data(), timestamps.size());
+  fclose(file);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  PrintResults(analyzer);
+  printf("analyzed in %.3f s\n", seconds);
+  return 0;
+}
+
+std::vector<double> ParseOffsets(const char* text) {
+  std::vector<double> offsets;
+  while (text != nullptr && *text != '\0') {
+    char* end;
+    offsets.push_back(strtod(text, &end));
+    text = *end == ',' ? end + 1 : nullptr;
+  }
+  return offsets;
+}
+
+int Bench(int argc, char** argv, const blade_analysis::Config& config) {
+  blade_analysis::TraceConfig trace;
+  trace.blades = config.blades;
+  trace.rpm = NumberOption(argc, argv, "--rpm", 3000);
+  trace.seconds = NumberOption(argc, argv, "--hours", 1) * 3600;
+  trace.once_per_rev_percent = NumberOption(argc, argv, "--once-per-rev", 0);
+  trace.jitter_us = NumberOption(argc, argv, "--jitter", 2);
+  const char* offsets = Option(argc, argv, "--offsets");
+  // One blade half a degree late unless told otherwise.
+  trace.blade_offsets_deg =
+      offsets != nullptr ? ParseOffsets(offsets) : std::vector<double>{0, 0.5};
+
+  std::vector<uint64_t> timestamps = blade_analysis::Synthesize(trace);
+  printf("%zu edges, %.1f h at %.0f RPM\n", timestamps.size(), trace.seconds / 3600, trace.rpm);
+
+  // Fed in edges frame sized chunks, as they arrive live.
+  constexpr size_t FRAME_EDGES = 256;
+  blade_analysis::Analyzer analyzer(config);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < timestamps.size(); i += FRAME_EDGES) {
+    size_t count = timestamps.size() - i < FRAME_EDGES ? timestamps.size() - i : FRAME_EDGES;
+    analyzer.Add(timestamps.data() + i, count);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  PrintResults(analyzer);
+
+  std::vector<blade_analysis::BladeStats> blades = analyzer.Blades();
+  std::vector<double> expected = blade_analysis::ExpectedDeviations(trace);
+  double worst_error = 0;
+  printf("blade  expected %%  found %%\n");
+  for (size_t i = 0; i < blades.size(); ++i) {
+    double error = fabs(blades[i].mean_deviation - expected[i]);
+    worst_error = error > worst_error ? error : worst_error;
+    printf("%5zu  %10.4f  %7.4f\n", i, expected[i] * 100, blades[i].mean_deviation * 100);
+  }
+  printf("worst deviation error %.5f%%\n", worst_error * 100);
+  bool passed = worst_error <= DEVIATION_TOLERANCE;
+
+  // Order k lies at bin k * fft / blades, between two bins unless blades divides the FFT size, and
+  // its line is at the stronger of them. Bin j is bins[j - 1]. The bins on either side of a line
+  // above the noise floor must be below it, or its leakage would read as orders of its own.
+  std::vector<blade_analysis::OrderBin> bins = analyzer.Spectrum();
+  if (bins.empty()) {
+    printf("no spectrum to check, fewer intervals than one FFT frame\n");
+    passed = false;
+  } else {
+    printf("order  expected %%  found %%  neighbours %%\n");
+    for (const blade_analysis::OrderBin& order : blade_analysis::ExpectedOrders(trace)) {
+      double position = order.order * config.fft_size / config.blades;
+      size_t line = (size_t)position;
+      if (line < bins.size() && position != line &&
+          (line == 0 || bins[line].amplitude_percent > bins[line - 1].amplitude_percent)) {
+        ++line;
+      }
+      if (line == 0) {
+        continue;
+      }
+      double found = bins[line - 1].amplitude_percent;
+      double neighbours = line >= 2 ? bins[line - 2].amplitude_percent : 0;
+      if (line < bins.size()) {
+        neighbours = std::max(neighbours, bins[line].amplitude_percent);
+      }
+      printf("%5.0f  %10.4f  %7.4f  %12.4f\n", order.order, order.amplitude_percent, found,
+             neighbours);
+      if (fabs(found - order.amplitude_percent) >
+          order.amplitude_percent * ORDER_TOLERANCE + ORDER_TOLERANCE_PERCENT) {
+        passed = false;
+      }
+      if (order.amplitude_percent > ORDER_TOLERANCE_PERCENT && neighbours >= found) {
+        passed = false;
+      }
+    }
+  }
+
+  printf("analyzed in %.3f s, %.1f M edges/s, %.0fx real time\n", seconds,
+         timestamps.size() / seconds / 1e6, trace.seconds / seconds);
+  printf(passed ? "within tolerance\n" : "OUT OF TOLERANCE\n");
+  return passed ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    PrintUsage();
+    return 2;
+  }
+
+  blade_analysis::Config config = AnalyzerConfig(argc, argv);
+  if (!IsValid(config)) {
+    return 2;
+  }
+
+  if (strcmp(argv[1], "analyze") == 0 && argc >= 3) {
+    return Analyze(argv[2], config);
+  }
+  if (strcmp(argv[1], "bench") == 0) {
+    return Bench(argc, argv, config);
+  }
+  PrintUsage();
+  return 2;
+}
@@ -1,100 +1,612 @@
 #include <Arduino.h>
+#include <DataFlashBlockDevice.h>
 #include <WiFiS3.h>
 #include <WiFiUdp.h>
 
+#include <utility>
+
+#include "blade_timing.h"
 #include "configurations.h"
+#include "deadband.h"
+#include "edge_stream.h"
+#include "flash_log.h"
+#include "retransmit.h"
+#include "rollup.h"
 #include "rtc_config.h"
+#include "scheduler.h"
+#include "subscribers.h"
+#include "telemetry.h"
+#include "time_sync.h"
 
-// Pin used exclusively to be a 5V power supply for the phototransistor
+// Pin used exclusively to be a 5V power supply for the phototransistors
 const int PD_POWER_PIN = 2;
-// Pin to read high / low when the propeller breaks the IR beam
-const int SENSOR_PIN = 3;
-const int PROPELLER_BLADES = 2;
 
-const unsigned long RPM_CALCULATION_INTERVAL_MS = 1000;
+// One channel per rotor, wifi_configs::ROTOR_CHANNELS of them, kept as a struct of arrays: entry i
+// of every array below belongs to channel i. Channel 0 is the primary rotor, the only one whose
+// samples are logged and rolled up. A single channel is sent in sample frames as before, several
+// in one channels frame.
+const size_t CHANNEL_COUNT = wifi_configs::ROTOR_CHANNELS;
+// Pins read high / low when a propeller breaks its IR beam, all able to interrupt. Channel i uses
+// entry i, pins past CHANNEL_COUNT are pulled up rather than left floating.
+const int SENSOR_PINS[] = {3, 8, 12, 13};
+const size_t SENSOR_PIN_COUNT = sizeof(SENSOR_PINS) / sizeof(SENSOR_PINS[0]);
+static_assert(CHANNEL_COUNT >= 1 && CHANNEL_COUNT <= SENSOR_PIN_COUNT &&
+              CHANNEL_COUNT <= telemetry::MAX_CHANNELS);
+// Bounce of the phototransistor is far shorter than a blade pass at full speed, about 1.5 ms for
+// two blades at 20000 RPM. Below 15 RPM, a 2 s period, a propeller counts as stopped.
+const blade_timing::Config BLADE_TIMING[SENSOR_PIN_COUNT] = {
+    {2, 200, 2000000},
+    {2, 200, 2000000},
+    {2, 200, 2000000},
+    {2, 200, 2000000},
+};
+static_assert(wifi_configs::EDGE_STREAM_CHANNEL < CHANNEL_COUNT);
+
+// The speed follows every revolution, so it is recalculated well within a transmit interval.
+const unsigned long RPM_CALCULATION_INTERVAL_MS = 50;
 const unsigned long TRANSMIT_INTERVAL_MS = 1000;
-const unsigned long STOPPED_THRESHOLD_MS = 2000;
+// Packets are polled often so that time responses are timestamped close to their arrival, but
+// every poll is a round trip to the WiFi module that can take a few milliseconds, which a 1 ms
+// period could not meet. Time requests only go out every time_sync::ROUND_INTERVAL_US.
+const unsigned long NETWORK_POLL_INTERVAL_MS = 5;
+const unsigned long TIME_SYNC_INTERVAL_MS = 10;
+// At 10000 edges per second the ring fills in 100 ms, so it is drained far more often. A frame
+// holds about 1000 edges at the one-byte deltas of fast rotors, so the ring filling between two
+// runs is the limit: the stream keeps up with about 80000 edges per second sustained. A stall of
+// the WiFi module is ridden out as long as the edges arriving meanwhile fit the ring.
+const unsigned long EDGE_STREAM_INTERVAL_MS = 10;
+const unsigned long STATS_REPORT_INTERVAL_MS = 60000;
 
-volatile unsigned long bladePassCount = 0;
-volatile unsigned long lastBladePassTime = 0;
+// Each written by its channel's blade pass ISR only, read with interrupts disabled.
+blade_timing::EdgeRecorder bladeEdges[CHANNEL_COUNT];
+float currentRpm[CHANNEL_COUNT] = {};
+// Per channel, so a frame goes out as soon as any rotor changed speed.
+deadband::Filter deadbandFilters[CHANNEL_COUNT];
+edge_stream::Ring edgeRing;
+uint32_t edgeSequence = 0;
+unsigned long lastEdgeFlushMs = 0;
 
 volatile int ready_to_transmit = 0;
-float currentRpm = 0.0;
-unsigned long lastCalcTime = 0;
+uint32_t frameSequence = 0;
+size_t lastSubscriberCount = 0;
+uint32_t samplesSent = 0;
+uint32_t datagramsSent = 0;
+// Units of every sampled value, revolutions per minute unless a client changed them.
+telemetry::Units units = telemetry::Units::RPM;
 
 WiFiUDP udp;
-
-using TaskFunction = void (*)();
-
-struct Task{
-    TaskFunction function;
-    unsigned long interval;
-    unsigned long lastExecuted;
-};
+subscribers::Table subscriberTable;
+retransmit::Window retransmitWindow;
+rollup::Store rollups;
+// Uses the whole 8 KB data flash.
+flash_log::Log<DataFlashBlockDevice> sampleLog(DataFlashBlockDevice::getInstance(), 0);
+time_sync::Clock wallClock;
+time_sync::Synchronizer synchronizer;
+uint32_t timeServerAddress = 0;
+uint16_t timeServerPort = 0;
+int64_t nextSyncUs = 0;
 
 void calculateRPM();
 void transmitRPM();
+void pollNetwork();
+void runTimeSync();
+void streamEdges();
+void replayLog();
+void reportStats();
 
-Task taskQueue[] = {
-    {calculateRPM, RPM_CALCULATION_INTERVAL_MS, 0},
-    {transmitRPM, TRANSMIT_INTERVAL_MS, 0},
+// Packets are handled first so time responses are timestamped close to their arrival, reporting
+// can always wait.
+scheduler::Task taskQueue[] = {
+    {"network", pollNetwork, NETWORK_POLL_INTERVAL_MS * 1000, 0},
+    {"time sync", runTimeSync, TIME_SYNC_INTERVAL_MS * 1000, 1},
+    {"edges", streamEdges, EDGE_STREAM_INTERVAL_MS * 1000, 2},
+    {"rpm", calculateRPM, RPM_CALCULATION_INTERVAL_MS * 1000, 3},
+    {"transmit", transmitRPM, TRANSMIT_INTERVAL_MS * 1000, 4},
+    {"replay", replayLog, wifi_configs::REPLAY_INTERVAL_MS * 1000, 5},
+    {"stats", reportStats, STATS_REPORT_INTERVAL_MS * 1000, 6},
 };
 
-const int numTasks = sizeof(taskQueue) / sizeof(Task);
+const int numTasks = sizeof(taskQueue) / sizeof(scheduler::Task);
+scheduler::Scheduler taskScheduler;
 
-void CountBladePassIsrFunction() {
-    ++bladePassCount;
-    lastBladePassTime = millis();
+// The task that runs `function`, so commands can change a task however taskQueue is ordered.
+scheduler::Task* findTask(scheduler::TaskFunction function) {
+    for (int i = 0; i < numTasks; ++i) {
+        if (taskQueue[i].function == function) {
+            return &taskQueue[i];
+        }
+    }
+    return nullptr;
 }
 
-void calculateRPM() {
-    unsigned long currentTime = millis();
-    unsigned long elapsedTime = currentTime - lastCalcTime;
+// attachInterrupt() takes no argument for the handler, so every channel gets its own instance.
+template <size_t CHANNEL>
+void countBladePass() {
+    uint32_t nowUs = micros();
+    bladeEdges[CHANNEL].OnEdge(BLADE_TIMING[CHANNEL], nowUs);
+    if (wifi_configs::EDGE_STREAM_ENABLED && CHANNEL == wifi_configs::EDGE_STREAM_CHANNEL) {
+        edgeRing.Push(nowUs);
+    }
+}
+
+template <size_t... CHANNELS>
+void attachBladePassInterrupts(std::index_sequence<CHANNELS...>) {
+    (attachInterrupt(digitalPinToInterrupt(SENSOR_PINS[CHANNELS]), countBladePass<CHANNELS>,
+                     RISING), ...);
+}
 
+// Every channel in one pass. The recorders are copied together so all speeds are taken at the
+// same instant.
+void calculateRPM() {
+    blade_timing::EdgeRecorder edges[CHANNEL_COUNT];
     noInterrupts();
-    unsigned long count = bladePassCount;
-    unsigned long lastPassTime = lastBladePassTime;
-    bladePassCount = 0;
+    for (size_t i = 0; i < CHANNEL_COUNT; ++i) {
+        edges[i] = bladeEdges[i];
+    }
+    uint32_t nowUs = micros();
     interrupts();
 
-    if (lastPassTime != 0 && (currentTime - lastPassTime) >= STOPPED_THRESHOLD_MS) {
-        currentRpm = 0.0;
-        lastCalcTime = currentTime;
-        return;
+    for (size_t i = 0; i < CHANNEL_COUNT; ++i) {
+        currentRpm[i] = blade_timing::Rpm(BLADE_TIMING[i], edges[i], nowUs);
     }
+}
+
+void resetDeadbands() {
+    for (deadband::Filter& filter : deadbandFilters) {
+        filter.Reset();
+    }
+}
+
+uint32_t samplesTaken() {
+    uint32_t taken = 0;
+    for (const deadband::Filter& filter : deadbandFilters) {
+        taken += filter.Taken();
+    }
+    return taken;
+}
+
+// Whether a sent sample reaches anyone, otherwise it is kept in the flash log.
+bool hasListeners() {
+    return wifi_configs::MULTICAST_ENABLED || subscriberTable.Count() > 0;
+}
 
+// Sends a frame to the multicast group or to the subscribers it is due for and keeps it for
+// retransmission. Replayed frames go to every subscriber, rate dividers only thin out live samples.
+void publishFrame(const uint8_t* frame, size_t frameLength, bool replay) {
+    retransmitWindow.Store(frame, frameLength);
+    ++datagramsSent;
+    if (wifi_configs::MULTICAST_ENABLED) {
+        const uint8_t* group = wifi_configs::MULTICAST_GROUP;
+        udp.beginPacket(IPAddress(group[0], group[1], group[2], group[3]),
+                        wifi_configs::MULTICAST_PORT);
+        udp.write(frame, frameLength);
+        udp.endPacket();
+        return;
+    }
 
-    if (elapsedTime > 0) {
-        float revolutions = (float)count / PROPELLER_BLADES;
-        currentRpm = (revolutions / (elapsedTime / 1000.0)) * 60.0;
-        lastCalcTime = currentTime;
+    auto send = [&](const subscribers::Subscriber& subscriber) {
+        udp.beginPacket(IPAddress(subscriber.address), subscriber.port);
+        udp.write(frame, frameLength);
+        udp.endPacket();
+    };
+    if (replay) {
+        subscriberTable.ForEach(send);
+    } else {
+        subscriberTable.ForEachDue(send);
     }
 }
 
 void transmitRPM() {
-    RTCTime curr_time;
-    RTC.getTime(curr_time);
-    auto payload = curr_time.toString() + ", " + String(currentRpm, 2);
+    int64_t epochMs = wallClock.EpochMicros(wallClock.Local(micros())) / 1000;
+    unsigned long now = millis();
+    float values[CHANNEL_COUNT];
+    // Sent unless every channel stayed within its deadband, a heartbeat if none moved beyond it.
+    deadband::Decision decision = deadband::Decision::SUPPRESS;
+    for (size_t i = 0; i < CHANNEL_COUNT; ++i) {
+        values[i] = units == telemetry::Units::HERTZ ? currentRpm[i] / 60 : currentRpm[i];
+        Serial.print(values[i]);
+        Serial.print(i + 1 < CHANNEL_COUNT ? '\t' : '\n');
 
-    udp.beginPacket(udp.remoteIP(), udp.remotePort());
-    udp.print(payload);
-    udp.endPacket();
+        deadband::Decision channelDecision = deadbandFilters[i].Check(values[i], now);
+        if (channelDecision == deadband::Decision::SEND ||
+            (channelDecision == deadband::Decision::HEARTBEAT &&
+             decision == deadband::Decision::SUPPRESS)) {
+            decision = channelDecision;
+        }
+    }
 
-    Serial.println(payload);
+    // Only the primary rotor is rolled up and logged, the others are lost while nobody listens.
+    telemetry::Sample sample = {(uint32_t)(epochMs / 1000), (uint16_t)(epochMs % 1000), values[0]};
+    rollups.Add(sample.epoch, sample.value);
+    if (decision == deadband::Decision::SUPPRESS) {
+        return;
+    }
+
+    if (!hasListeners()) {
+        if (!sampleLog.Append(sample)) {
+            Serial.println("Failed to write the sample log");
+        }
+        return;
+    }
+
+    uint8_t flags = decision == deadband::Decision::HEARTBEAT ? telemetry::FLAG_HEARTBEAT : 0;
+    uint8_t frame[telemetry::ChannelsFrameSize(CHANNEL_COUNT)];
+    static_assert(sizeof(frame) >= telemetry::SAMPLE_FRAME_SIZE);
+    size_t frameLength;
+    if (CHANNEL_COUNT == 1) {
+        frameLength = telemetry::EncodeSample(frame, wifi_configs::NODE_ID, frameSequence++,
+                                              sample, flags);
+    } else {
+        frameLength = telemetry::EncodeChannels(frame, wifi_configs::NODE_ID, frameSequence++,
+                                                sample.epoch, sample.millis, values,
+                                                CHANNEL_COUNT, flags);
+    }
+    publishFrame(frame, frameLength, false);
+    samplesSent += CHANNEL_COUNT;
 }
 
-// The runScheduluer loops through all tasks in the queue and exeuctes them if their last executed
-// time is greater than or equal to their expected scheduled interval. The tasks are not dequed from
-// the queue. Instead their last execution time is persisted within and checked at each execution.
-// This removes the need to constantly enqueue the same tasks when it will only ever be these two.
-void runScheduluer() {
+// Sends the waiting blade pass timestamps once enough of them filled a frame or the flush interval
+// ran out, and keeps sending until the ring is empty or EDGE_FRAMES_PER_RUN frames went out. Edges
+// keep arriving while a frame is sent, so without the budget a fast rotor would keep the task
+// here. Without listeners the edges are taken out of the ring and discarded.
+void streamEdges() {
     unsigned long now = millis();
-    for (int i = 0; i < numTasks; ++i) {
-        if (now - taskQueue[i].lastExecuted >= taskQueue[i].interval) {
-            taskQueue[i].function();
-            taskQueue[i].lastExecuted = now;
+    if (edgeRing.Size() < wifi_configs::EDGE_FRAME_MIN_EDGES &&
+        now - lastEdgeFlushMs < wifi_configs::EDGE_FLUSH_INTERVAL_MS) {
+        return;
+    }
+    lastEdgeFlushMs = now;
+
+    uint8_t frame[telemetry::MAX_EDGES_FRAME_SIZE];
+    size_t frameLength;
+    for (size_t frames = 0;
+         frames < wifi_configs::EDGE_FRAMES_PER_RUN &&
+         (frameLength = edge_stream::EncodeFrame(edgeRing, frame, wifi_configs::NODE_ID,
+                                                 edgeSequence)) != 0;
+         ++frames) {
+        ++edgeSequence;
+        if (!hasListeners()) {
+            continue;
+        }
+
+        // Not kept for retransmission and sent to every subscriber, the analysis needs every edge.
+        if (wifi_configs::MULTICAST_ENABLED) {
+            const uint8_t* group = wifi_configs::MULTICAST_GROUP;
+            udp.beginPacket(IPAddress(group[0], group[1], group[2], group[3]),
+                            wifi_configs::MULTICAST_PORT);
+            udp.write(frame, frameLength);
+            udp.endPacket();
+            continue;
+        }
+        subscriberTable.ForEach([&](const subscribers::Subscriber& subscriber) {
+            udp.beginPacket(IPAddress(subscriber.address), subscriber.port);
+            udp.write(frame, frameLength);
+            udp.endPacket();
+        });
+    }
+}
+
+// Sends the next batch of logged samples, flagged as replayed, while anyone is listening.
+void replayLog() {
+    if (sampleLog.IsEmpty() || !hasListeners()) {
+        return;
+    }
+
+    static_assert(wifi_configs::REPLAY_BATCH_SAMPLES <= telemetry::MAX_BATCH_SAMPLES);
+    telemetry::Sample samples[wifi_configs::REPLAY_BATCH_SAMPLES];
+    size_t count = sampleLog.Read(samples, wifi_configs::REPLAY_BATCH_SAMPLES);
+    if (count == 0) {
+        return;
+    }
+
+    uint8_t frame[telemetry::MAX_BATCH_FRAME_SIZE];
+    size_t frameLength = telemetry::EncodeBatch(frame, wifi_configs::NODE_ID, frameSequence++,
+                                                samples, count, telemetry::FLAG_REPLAY);
+    publishFrame(frame, frameLength, true);
+    samplesSent += count;
+    if (sampleLog.IsEmpty()) {
+        Serial.println("Sample log replayed");
+    }
+}
+
+// Fills the GET_COUNTERS result. This node has no event queue, so EVENTS_DROPPED stays 0.
+size_t putCounters(uint8_t* result) {
+    using telemetry::Counter;
+    uint32_t counters[(size_t)Counter::COUNT] = {};
+    counters[(size_t)Counter::UPTIME_S] = millis() / 1000;
+    counters[(size_t)Counter::SAMPLES_TAKEN] = samplesTaken();
+    counters[(size_t)Counter::SAMPLES_SENT] = samplesSent;
+    counters[(size_t)Counter::DATAGRAMS_SENT] = datagramsSent;
+    counters[(size_t)Counter::LOG_PENDING] = sampleLog.Pending();
+    counters[(size_t)Counter::LOG_OVERWRITTEN] = sampleLog.Overwritten();
+    counters[(size_t)Counter::SUBSCRIBERS] = subscriberTable.Count();
+    counters[(size_t)Counter::EDGES_DROPPED] = edgeRing.Overflows();
+
+    uint8_t* cursor = result;
+    *cursor++ = (uint8_t)Counter::COUNT;
+    for (uint32_t counter : counters) {
+        cursor = telemetry::PutU32(cursor, counter);
+    }
+    return cursor - result;
+}
+
+// Carries out a command and returns its status, writing any result to `result`. This node samples
+// continuously and sends every sample on its own, so it has no sessions, batches or oversampling.
+telemetry::CommandStatus runCommand(const telemetry::Command& command, uint8_t* result,
+                                    size_t& resultLength) {
+    using telemetry::CommandStatus;
+    using telemetry::Opcode;
+
+    const uint8_t* args = command.args;
+    switch (command.opcode) {
+        case Opcode::SET_CLOCK: {
+            uint32_t epoch = telemetry::GetU32(args);
+            if (!config::IsValidEpoch(epoch)) {
+                return CommandStatus::INVALID_ARGUMENT;
+            }
+
+            // The sender becomes the time server and is synced with right away.
+            wallClock.SetCoarse(epoch, wallClock.Local(micros()));
+            RTCTime clockTime((time_t)epoch);
+            RTC.setTime(clockTime);
+            timeServerAddress = (uint32_t)udp.remoteIP();
+            timeServerPort = udp.remotePort();
+            nextSyncUs = 0;
+            return CommandStatus::OK;
         }
+
+        case Opcode::SET_INTERVAL: {
+            uint32_t intervalMs = telemetry::GetU32(args);
+            if (intervalMs < wifi_configs::MIN_TRANSMIT_INTERVAL_MS ||
+                intervalMs > wifi_configs::MAX_TRANSMIT_INTERVAL_MS) {
+                return CommandStatus::INVALID_ARGUMENT;
+            }
+
+            scheduler::Task* transmitTask = findTask(transmitRPM);
+            if (transmitTask == nullptr) {
+                return CommandStatus::UNSUPPORTED;
+            }
+            transmitTask->period_us = intervalMs * 1000;
+            return CommandStatus::OK;
+        }
+
+        case Opcode::SET_DEADBAND: {
+            float threshold = telemetry::FromFixedPoint((int32_t)telemetry::GetU32(args));
+            uint32_t heartbeatMs = telemetry::GetU32(args + 4);
+            if (threshold < 0 || heartbeatMs == 0) {
+                return CommandStatus::INVALID_ARGUMENT;
+            }
+
+            for (deadband::Filter& filter : deadbandFilters) {
+                filter.Configure(threshold, heartbeatMs);
+            }
+            resetDeadbands();
+            return CommandStatus::OK;
+        }
+
+        case Opcode::SET_UNITS: {
+            telemetry::Units newUnits = (telemetry::Units)args[0];
+            if (newUnits != telemetry::Units::RPM && newUnits != telemetry::Units::HERTZ) {
+                return CommandStatus::INVALID_ARGUMENT;
+            }
+            // Frames do not say which units their values are in, so logged samples waiting to be
+            // replayed keep the units they were taken in.
+            if (!sampleLog.IsEmpty()) {
+                return CommandStatus::INVALID_STATE;
+            }
+
+            if (newUnits != units) {
+                units = newUnits;
+                rollups.Clear();
+                resetDeadbands();
+            }
+            return CommandStatus::OK;
+        }
+
+        case Opcode::ADD_SUBSCRIBER: {
+            uint16_t grantedLease;
+            if (subscriberTable.Subscribe(telemetry::GetU32(args), telemetry::GetU16(args + 4),
+                                          telemetry::GetU16(args + 6), args[8], millis(),
+                                          grantedLease) != telemetry::SubscribeStatus::OK) {
+                return CommandStatus::INVALID_STATE;
+            }
+
+            resultLength = telemetry::PutU16(result, grantedLease) - result;
+            return CommandStatus::OK;
+        }
+
+        case Opcode::REMOVE_SUBSCRIBER:
+            if (subscriberTable.Unsubscribe(telemetry::GetU32(args), telemetry::GetU16(args + 4)) !=
+                telemetry::SubscribeStatus::OK) {
+                return CommandStatus::INVALID_STATE;
+            }
+            return CommandStatus::OK;
+
+        case Opcode::GET_COUNTERS:
+            resultLength = putCounters(result);
+            return CommandStatus::OK;
+
+        case Opcode::GET_VERSION:
+            result[0] = telemetry::PROTOCOL_VERSION;
+            result[1] = wifi_configs::FIRMWARE_VERSION_MAJOR;
+            result[2] = wifi_configs::FIRMWARE_VERSION_MINOR;
+            result[3] = wifi_configs::FIRMWARE_VERSION_PATCH;
+            result[4] = (uint8_t)units;
+            resultLength = 5;
+            return CommandStatus::OK;
+
+        case Opcode::START:
+        case Opcode::STOP:
+        case Opcode::SET_OVERSAMPLING:
+        case Opcode::SET_BATCH:
+            return CommandStatus::UNSUPPORTED;
     }
+
+    return CommandStatus::UNKNOWN_OPCODE;
+}
+
+// Hands time responses to the synchronizer, answers subscribe and unsubscribe messages, nacks,
+// rollup requests and commands and drops subscribers whose lease ran out. Anything else received
+// is ignored.
+void pollNetwork() {
+    unsigned long now = millis();
+
+    uint8_t packet[64];
+    while (udp.parsePacket()) {
+        uint32_t receivedUs = micros();
+        int packetLength = udp.read(packet, sizeof(packet));
+        if (packetLength <= 0) {
+            continue;
+        }
+
+        telemetry::Header header;
+        uint32_t t1Us;
+        int64_t t2Us;
+        int64_t t3Us;
+        if (telemetry::DecodeHeader(packet, packetLength, header) &&
+            header.type == telemetry::FrameType::TIME_RESPONSE &&
+            telemetry::DecodeTimeResponse(packet, packetLength, t1Us, t2Us, t3Us)) {
+            synchronizer.OnResponse(header.sequence, t1Us, t2Us, t3Us, wallClock.Local(receivedUs));
+            continue;
+        }
+
+        auto reply = [&](const uint8_t* data, size_t length) {
+            udp.beginPacket(udp.remoteIP(), udp.remotePort());
+            udp.write(data, length);
+            udp.endPacket();
+        };
+        if (retransmit::HandleNack(retransmitWindow, packet, packetLength, reply) ||
+            rollup::HandleRequest(rollups, packet, packetLength, wifi_configs::NODE_ID, reply)) {
+            continue;
+        }
+
+        telemetry::Command command;
+        telemetry::CommandStatus status;
+        if (telemetry::DecodeCommand(packet, packetLength, command, status)) {
+            uint8_t result[telemetry::MAX_COMMAND_ACK_SIZE];
+            size_t resultLength = 0;
+            if (status == telemetry::CommandStatus::OK) {
+                status = runCommand(command, result, resultLength);
+            }
+
+            uint8_t commandAck[telemetry::MAX_COMMAND_ACK_SIZE];
+            size_t commandAckLength = telemetry::EncodeCommandAck(
+                commandAck, wifi_configs::NODE_ID, command.request_id, command.opcode, status,
+                result, resultLength);
+            reply(commandAck, commandAckLength);
+            continue;
+        }
+
+        uint8_t ack[telemetry::SUBSCRIBE_ACK_SIZE];
+        size_t ackLength = subscribers::HandleMessage(
+            subscriberTable, packet, packetLength, (uint32_t)udp.remoteIP(), udp.remotePort(),
+            wifi_configs::NODE_ID, now, ack);
+        if (ackLength != 0) {
+            reply(ack, ackLength);
+        }
+    }
+
+    if (subscriberTable.Expire(now) != 0) {
+        Serial.print("Subscriber lease expired, subscribers: ");
+        Serial.println(subscriberTable.Count());
+    }
+
+    // A subscriber that just joined gets the current value right away instead of after the next
+    // change or heartbeat.
+    size_t subscriberCount = subscriberTable.Count();
+    if (subscriberCount > lastSubscriberCount) {
+        resetDeadbands();
+    }
+    lastSubscriberCount = subscriberCount;
+}
+
+void reportStats() {
+    for (size_t i = 0; i < CHANNEL_COUNT; ++i) {
+        const deadband::Filter& filter = deadbandFilters[i];
+        Serial.print("Channel ");
+        Serial.print(i);
+        Serial.print(": sent ");
+        Serial.print(filter.Sent());
+        Serial.print(" of ");
+        Serial.print(filter.Taken());
+        Serial.print(" samples, compression ");
+        Serial.print(filter.CompressionRatio(), 1);
+        Serial.print(":1, ");
+        Serial.print(bladeEdges[i].Glitches());
+        Serial.println(" blade pass glitches");
+    }
+
+    Serial.print(sampleLog.Pending());
+    Serial.print(" samples logged, ");
+    Serial.print(edgeRing.Taken());
+    Serial.print(" edges streamed, ");
+    Serial.print(edgeRing.Overflows());
+    Serial.println(" dropped");
+
+    // Task timing over the last report interval.
+    Serial.print("Load ");
+    Serial.print(taskScheduler.Load() * 100, 1);
+    Serial.println("%");
+    for (int i = 0; i < numTasks; ++i) {
+        const scheduler::Task& task = taskScheduler.GetTask(i);
+        Serial.print("  ");
+        Serial.print(task.name);
+        Serial.print(": ");
+        Serial.print(task.stats.runs);
+        Serial.print(" runs, mean ");
+        Serial.print(task.stats.MeanRunUs());
+        Serial.print(" us, max ");
+        Serial.print(task.stats.max_run_us);
+        Serial.print(" us, jitter max ");
+        Serial.print(task.stats.max_jitter_us);
+        Serial.print(" us, missed ");
+        Serial.println(task.stats.missed);
+    }
+    taskScheduler.ResetStats();
+}
+
+// Keeps wallClock synchronized with the client that set the clock, see time_sync.h. A sync of
+// several request rounds runs every RESYNC_INTERVAL_US, which also lets the drift of micros() be
+// estimated.
+void runTimeSync() {
+    int64_t nowUs = wallClock.Local(micros());
+    if (!synchronizer.IsRunning() && nowUs >= nextSyncUs) {
+        synchronizer.Start(nowUs);
+    }
+
+    uint32_t sequence;
+    uint32_t t1Us;
+    time_sync::Step step = synchronizer.Poll(nowUs, sequence, t1Us);
+    if (step == time_sync::Step::SEND_REQUEST) {
+        uint8_t request[telemetry::TIME_REQUEST_SIZE];
+        size_t requestLength =
+            telemetry::EncodeTimeRequest(request, wifi_configs::NODE_ID, sequence, t1Us);
+        udp.beginPacket(IPAddress(timeServerAddress), timeServerPort);
+        udp.write(request, requestLength);
+        udp.endPacket();
+        return;
+    }
+
+    if (step != time_sync::Step::FINISHED) {
+        return;
+    }
+
+    if (!synchronizer.Succeeded()) {
+        Serial.println("Time sync got no response");
+        nextSyncUs = nowUs + time_sync::RETRY_INTERVAL_US;
+        return;
+    }
+
+    wallClock.Apply(synchronizer.Best());
+    RTCTime syncedTime((time_t)(wallClock.EpochMicros(nowUs) / 1000000));
+    RTC.setTime(syncedTime);
+    nextSyncUs = nowUs + time_sync::RESYNC_INTERVAL_US;
+
+    Serial.print("Time synced, round trip ");
+    Serial.print((long)synchronizer.Best().delay_us);
+    Serial.print(" us, drift ");
+    Serial.print(wallClock.DriftPpb());
+    Serial.println(" ppb");
 }
 
 void setup() {
@@ -103,8 +615,20 @@ void setup() {
     pinMode(PD_POWER_PIN, OUTPUT);
     digitalWrite(PD_POWER_PIN, HIGH);
 
-    pinMode(SENSOR_PIN, INPUT);
+    for (size_t i = 0; i < CHANNEL_COUNT; ++i) {
+        pinMode(SENSOR_PINS[i], INPUT);
+        deadbandFilters[i].Configure(wifi_configs::DEADBAND_RPM, wifi_configs::HEARTBEAT_MS);
+    }
+    for (size_t i = CHANNEL_COUNT; i < SENSOR_PIN_COUNT; ++i) {
+        pinMode(SENSOR_PINS[i], INPUT_PULLUP);
+    }
 
+    if (DataFlashBlockDevice::getInstance().init() != 0 || !sampleLog.Begin()) {
+        Serial.println("Sample log unavailable");
+    } else {
+        Serial.print("Samples waiting in the sample log: ");
+        Serial.println(sampleLog.Pending());
+    }
 
     while (wifi_configs::ConnectToWiFi(wifi_configs::SSID, wifi_configs::PWD)) {
         Serial.println("Unable to connect to Wifi..."
@@ -121,11 +645,33 @@ void setup() {
         });
     }
 
-    attachInterrupt(digitalPinToInterrupt(SENSOR_PIN), CountBladePassIsrFunction, RISING);
+    // The client that set the clock becomes the time server. Its whole second epoch is used until
+    // the first sync refines it.
+    RTCTime clockTime;
+    RTC.getTime(clockTime);
+    wallClock.SetCoarse((uint32_t)clockTime.getUnixTime(), wallClock.Local(micros()));
+    timeServerAddress = (uint32_t)udp.remoteIP();
+    timeServerPort = udp.remotePort();
+
+    // The client that set the clock is subscribed for one default lease, which it renews with
+    // subscribe messages.
+    uint16_t grantedLease;
+    subscriberTable.Subscribe((uint32_t)udp.remoteIP(), udp.remotePort(), 0, 1, millis(),
+                              grantedLease);
 
-    lastCalcTime = millis();
+    attachBladePassInterrupts(std::make_index_sequence<CHANNEL_COUNT>());
+
+    taskScheduler.Begin(taskQueue, numTasks, []() -> uint32_t { return micros(); });
 }
 
+// Runs due tasks one at a time and sleeps until the next interrupt once none is due. The 1 ms
+// system tick bounds the sleep, blade passes and the WiFi module wake the core earlier.
 void loop() {
-    runScheduluer();
+    if (taskScheduler.RunNext()) {
+        return;
+    }
+
+    uint32_t sleepStartUs = micros();
+    __WFI();
+    taskScheduler.AddIdle(micros() - sleepStartUs);
 }
\ No newline at end of file
@@ -7,25 +7,59 @@ import matplotlib.pyplot as plt
 from matplotlib.animation import FuncAnimation
 
 
-from data_handler import DataManager
-from networking import setup_socket, send_unix_time, receive_data
+from data_handler import (DataManager, EdgeStream, encode_command_line, encode_rollup_request,
+                          format_link_stats)
+from networking import (setup_socket, send_unix_time, send_command_line, receive_data,
+                        join_multicast, keep_subscribed)
 from plotting import setup_plot, update_plot
 
 # NOTE: SET THE IP ADDRESS TO WHATEVER THE MICROCONTROLLER OUTPUTS
 HOST = "192.168.1.37"
 PORT = 12345
 PLOT_INTERVAL_MS = 1000
+# Seconds the node keeps sending without a renewal, and to receive only every n-th frame.
+SUBSCRIPTION_LEASE_S = 60
+RATE_DIVIDER = 1
+# Set to the node's group when it is built with MULTICAST_ENABLED.
+MULTICAST_GROUP = None
+# File the blade pass timestamps are written to, one microsecond value per line, or None to only
+# count them.
+EDGE_CAPTURE_PATH = None
 
 stop_receiving = threading.Event() # Use a thread-safe Event for stopping
 user_input_value = None 
 
-def input_thread(stop_event):
-    """Thread to get user input (e.g., '2' to stop) without blocking the plot."""
+def request_rollups(my_socket, command):
+    """Asks the node for a rollup tier, 'r <tier> [hours]' with tier 0 - 2 for 10 s, 1 min and
+    1 h buckets. Without hours every bucket the node keeps is sent."""
+    fields = command.split()
+    try:
+        tier = int(fields[1]) if len(fields) > 1 else 0
+        hours = float(fields[2]) if len(fields) > 2 else None
+    except ValueError:
+        print("Usage: r <tier> [hours]")
+        return
+
+    since_epoch = int(time.time() - hours * 3600) if hours is not None else 0
+    my_socket.sendto(encode_rollup_request(0, tier, since_epoch), (HOST, PORT))
+
+def input_thread(my_socket, stop_event):
+    """Thread to get user input (e.g., '2' to stop, 'r 2' for hourly rollups, 'u Hz' to sample
+    in revolutions per second) without blocking the plot. Anything else is sent as a command, see
+    encode_command_line."""
     global user_input_value
     print("\n--- Input Thread Started ---")
     while not stop_event.is_set():
         try:
             user_input_value = input().strip()
+            if user_input_value.startswith("r"):
+                request_rollups(my_socket, user_input_value)
+            elif user_input_value and user_input_value != "2":
+                try:
+                    if not send_command_line(my_socket, HOST, PORT, user_input_value):
+                        print(encode_command_line.__doc__)
+                except ValueError as e:
+                    print(f"Invalid command: {e}")
             if user_input_value == "2":
                 stop_event.set()
                 print("Stopping data reception and closing plot.")
@@ -41,7 +75,8 @@ def input_thread(stop_event):
 
 def main():
     # 1. Initialize data manager (handles lists and lock)
-    data_manager = DataManager()
+    # A rate divider skips frames on purpose, which must not be mistaken for loss.
+    data_manager = DataManager(track_gaps=RATE_DIVIDER == 1)
     
     # 2. Setup socket
     my_socket = setup_socket(PORT)
@@ -59,31 +94,47 @@ def main():
             time.sleep(2)
 
     # 4. Start threads
+    if MULTICAST_GROUP:
+        join_multicast(my_socket, MULTICAST_GROUP)
+    else:
+        subscription_thread = threading.Thread(
+            target=keep_subscribed,
+            args=(my_socket, HOST, PORT, stop_receiving, SUBSCRIPTION_LEASE_S, RATE_DIVIDER),
+            daemon=True
+        )
+        subscription_thread.start()
+
+    capture = open(EDGE_CAPTURE_PATH, "w") if EDGE_CAPTURE_PATH else None
+    edge_stream = EdgeStream(
+        (lambda timestamps: capture.writelines(f"{t}\n" for t in timestamps)) if capture else None)
     receiver_thread = threading.Thread(
         target=receive_data, 
-        args=(my_socket, data_manager, stop_receiving), 
+        args=(my_socket, data_manager, stop_receiving, edge_stream), 
         daemon=True
     )
     receiver_thread.start()
 
     input_thread_obj = threading.Thread(
         target=input_thread, 
-        args=(stop_receiving,), 
+        args=(my_socket, stop_receiving), 
         daemon=True
     )
     input_thread_obj.start()
 
     # 5. Setup Matplotlib plot
-    fig, ax, line = setup_plot()
+    fig, ax, lines = setup_plot()
 
     print("\n--- Real-time Plotting Started ---")
     print(f"Receiving data from {HOST}:{PORT}. Type '2' + Enter to stop.")
+    print("Type 'r <tier> [hours]' for the node's 10 s, 1 min or 1 h rollups (tier 0, 1 or 2).")
+    print("Type 'i <seconds>' to change the interval, 'd <rpm> <seconds>' to set the deadband,")
+    print("'u RPM' or 'u Hz' for the units, 'c' for the node's counters and 'v' for its version.")
     
     # 6. Start animation
     # Use lambda to pass data_manager into the update_plot function
     ani = FuncAnimation(
         fig, 
-        lambda frame: update_plot(frame, ax, line, data_manager), 
+        lambda frame: update_plot(frame, ax, lines, data_manager), 
         interval=PLOT_INTERVAL_MS, 
         cache_frame_data=False
     )
@@ -96,8 +147,16 @@ def main():
     finally:
         stop_receiving.set()
         print("Plotting ended. Cleaning up resources.")
+        print(format_link_stats(data_manager.get_link_stats()))
+        samples, heartbeats = data_manager.get_heartbeats()
+        print(f"Received {samples} samples, {heartbeats} of them deadband heartbeats")
         if receiver_thread.is_alive():
             receiver_thread.join(timeout=2)
+        edges, lost, dropped = edge_stream.stats()
+        print(f"Received {edges} blade pass edges, {lost} lost in transit, {dropped} dropped on "
+              f"the node")
+        if capture:
+            capture.close()
         my_socket.close()
 
 if __name__ == "__main__":
@@ -1,5 +1,6 @@
 # plotting.py
 
+import matplotlib.dates as mdates
 import matplotlib.pyplot as plt
 from data_handler import DataManager # Not strictly needed here, but good practice
 
@@ -7,40 +8,48 @@ def setup_plot():
     """Initializes and configures the Matplotlib plot."""
     fig, ax = plt.subplots(figsize=(15, 8))
     
-    # 'line,' unpacks the single Line2D object returned by ax.plot
-    line, = ax.plot([], [], marker='o', linestyle='-', label='Remote RPM Data') 
+    # 'line,' unpacks the single Line2D object returned by ax.plot. Values hold until the next
+    # sample, which is all the node sends while a value stays within its deadband.
+    line, = ax.plot([], [], marker='o', linestyle='-', drawstyle='steps-post',
+                    label='Remote RPM Data') 
     
     ax.set_xlabel("Time")
+    ax.xaxis_date()
+    ax.xaxis.set_major_formatter(mdates.DateFormatter("%H:%M:%S"))
     ax.set_ylabel("RPM")
     ax.set_title("Real-Time RPM")
     ax.legend()
     ax.grid(True, linestyle='--', alpha=0.7)
     plt.tight_layout() 
     
-    return fig, ax, line
+    # One line per channel, the first is channel 0. Lines for further rotors are added as their
+    # channels arrive.
+    return fig, ax, {0: line}
 
-def update_plot(frame, ax, line, data_manager: DataManager):
+def update_plot(frame, ax, lines, data_manager: DataManager):
     """Function called periodically by FuncAnimation to update the plot."""
     
-    # Get thread-safe copies of data
-    data_points, timestamps = data_manager.get_data()
+    for channel in data_manager.get_channels():
+        if channel not in lines:
+            lines[channel], = ax.plot([], [], marker='o', linestyle='-', drawstyle='steps-post',
+                                      label=f'Rotor {channel}')
+            ax.legend()
 
-    if not data_points:
-        return line, 
-    
-    # X-data is the index (0, 1, 2, ...), Y-data is the collected values
-    x_data = list(range(len(data_points)))
-    y_data = data_points
+        # Get thread-safe copies of data
+        data_points, timestamps = data_manager.get_data(channel)
+        if not data_points:
+            continue
 
-    line.set_data(x_data, y_data)
+        # X-data is the sample time, so points sent after long unchanged stretches sit where they
+        # belong, Y-data is the collected values
+        lines[channel].set_data(mdates.date2num(timestamps), data_points)
     
     # Rescale axes automatically
     ax.relim()
     ax.autoscale_view()
+    for label in ax.get_xticklabels():
+        label.set_rotation(45)
+        label.set_horizontalalignment('right')
 
-    # Update x-axis labels to show timestamps
-    ax.set_xticks(x_data) 
-    ax.set_xticklabels(timestamps, rotation=45, ha='right')
-
-    # Return the line artist (required by FuncAnimation)
-    return line,
\ No newline at end of file
+    # Return the line artists (required by FuncAnimation)
+    return tuple(lines.values())
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef RETRANSMIT_H
+#define RETRANSMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+// Selective retransmission of sample, batch and channels frames. The node keeps a copy of the last
+// WINDOW_FRAMES frames it sent. A client that notices a gap in the sequence numbers sends a nack
+// for the missing ones, and those still in the window are sent again to that client only, with
+// FLAG_RETRANSMIT set. Frames that already left the window stay lost, the client gives up on them
+// after a few nacks.
+//
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace retransmit {
+
+// Covers a few seconds of frames at the fastest sample rates while keeping the copies, each sized
+// for the largest batch, to a few KB of RAM.
+inline constexpr size_t WINDOW_FRAMES = 16;
+
+class Window {
+ public:
+  // Keeps a copy of a sent frame, replacing the oldest one.
+  void Store(const uint8_t* frame, size_t length) {
+    if (length < telemetry::HEADER_SIZE || length > telemetry::MAX_BATCH_FRAME_SIZE) {
+      return;
+    }
+
+    Entry& entry = entries_[next_];
+    memcpy(entry.frame, frame, length);
+    entry.length = length;
+    next_ = (next_ + 1) % WINDOW_FRAMES;
+  }
+
+  // The stored frame with `sequence`, flagged as retransmitted, or nullptr if it left the window.
+  const uint8_t* Find(uint32_t sequence, size_t& length) {
+    for (Entry& entry : entries_) {
+      if (entry.length != 0 && telemetry::GetU32(entry.frame + 4) == sequence) {
+        entry.frame[3] |= telemetry::FLAG_RETRANSMIT;
+        length = entry.length;
+        return entry.frame;
+      }
+    }
+
+    return nullptr;
+  }
+
+ private:
+  struct Entry {
+    uint8_t frame[telemetry::MAX_BATCH_FRAME_SIZE];
+    size_t length = 0;
+  };
+
+  Entry entries_[WINDOW_FRAMES];
+  size_t next_ = 0;
+};
+
+// Calls `send(frame, length)` for every frame `message` asks for that is still in `window`. Returns
+// false if `message` is not a nack.
+template <typename Send>
+bool HandleNack(Window& window, const uint8_t* message, size_t length, Send send) {
+  telemetry::Header header;
+  uint32_t first;
+  uint32_t bitmap;
+  if (!telemetry::DecodeHeader(message, length, header) ||
+      header.type != telemetry::FrameType::NACK ||
+      !telemetry::DecodeNack(message, length, first, bitmap)) {
+    return false;
+  }
+
+  for (size_t i = 0; i < telemetry::NACK_BITMAP_FRAMES; ++i) {
+    if ((bitmap >> i & 1) == 0) {
+      continue;
+    }
+
+    size_t frame_length;
+    const uint8_t* frame = window.Find(first + i, frame_length);
+    if (frame != nullptr) {
+      send(frame, frame_length);
+    }
+  }
+
+  return true;
+}
+
+} // retransmit
+
+#endif // RETRANSMIT_H
@@ -5,58 +5,71 @@
 #include <WiFiS3.h>
 
 #include "RTC.h"
+#include "configurations.h"
+#include "telemetry.h"
 
 namespace config {
 using Callback = void(*)();
 
-time_t ParseTimeFromUdp(const char* packet) {
-  char* end_ptr;
-  unsigned long epoch = strtoul(packet, &end_ptr, 10);
-  Serial.print("Converted unix timestamp: ");
-  Serial.println(epoch);
-
-  if (*end_ptr != '\0') {
-    Serial.println("Error: Non-numeric characters in timestamp");
-    return 0;
-  }
-
-  if (epoch < 946684800UL || epoch > 4102444800UL) { 
-    // sanity check ~2000-01-01 to ~2100-01-01
-    Serial.println("Error: Epoch timestamp out of valid range");
-    return 0;
-  }
+// Whether `epoch`, sent by a client, is a plausible time to set the clock to.
+inline bool IsValidEpoch(uint32_t epoch) {
+  // sanity check ~2000-01-01 to ~2100-01-01
+  return epoch >= 946684800UL && epoch <= 4102444800UL;
+}
 
-  return (time_t)epoch;
+inline void SendCommandAck(WiFiUDP& udp, const telemetry::Command& command,
+                           telemetry::CommandStatus status) {
+  uint8_t ack[telemetry::MAX_COMMAND_ACK_SIZE];
+  size_t ackLength = telemetry::EncodeCommandAck(ack, wifi_configs::NODE_ID, command.request_id,
+                                                 command.opcode, status, nullptr, 0);
+  udp.beginPacket(udp.remoteIP(), udp.remotePort());
+  udp.write(ack, ackLength);
+  udp.endPacket();
 }
 
+// Blocks until a client sends a SET_CLOCK command with a valid epoch, sets the RTC and acks it.
+// Every other command is rejected with INVALID_STATE until then.
 void WaitForClockConfiguration(WiFiUDP& udp, Callback cb) {
-    char udp_packet[256];
+    uint8_t udp_packet[64];
 
-    Serial.println("Waiting for UDP Connection...");
+    Serial.println("Waiting for SET_CLOCK command...");
     while (1) {
       if (udp.parsePacket()) {
-        int dataLen = udp.available();
-        udp.read(udp_packet, 255);
-        udp_packet[dataLen] = '\0';
-        Serial.print("Received epoch: ");
-        Serial.println(udp_packet);
+        int dataLen = udp.read(udp_packet, sizeof(udp_packet));
+        telemetry::Command command;
+        telemetry::CommandStatus status;
+        if (dataLen <= 0 || !telemetry::DecodeCommand(udp_packet, dataLen, command, status)) {
+          continue;
+        }
 
-        time_t config_epoch = ParseTimeFromUdp(udp_packet);
+        if (status == telemetry::CommandStatus::OK) {
+          if (command.opcode != telemetry::Opcode::SET_CLOCK) {
+            status = telemetry::CommandStatus::INVALID_STATE;
+          } else if (!IsValidEpoch(telemetry::GetU32(command.args))) {
+            Serial.println("Error: Epoch timestamp out of valid range");
+            status = telemetry::CommandStatus::INVALID_ARGUMENT;
+          }
+        }
+        if (status != telemetry::CommandStatus::OK) {
+          SendCommandAck(udp, command, status);
+          continue;
+        }
 
-        if (config_epoch != 0) {
-          RTC.begin();
-          RTCTime config_time_from_udp(config_epoch);
-          RTC.setTime(config_time_from_udp);
-          Serial.println("RTC time has been set.");
+        uint32_t config_epoch = telemetry::GetU32(command.args);
 
-          udp.beginPacket(udp.remoteIP(), udp.remotePort());
-          udp.print("OK");
-          udp.endPacket();
+        Serial.print("Received epoch: ");
+        Serial.println(config_epoch);
 
-          cb();
+        RTC.begin();
+        RTCTime config_time_from_udp((time_t)config_epoch);
+        RTC.setTime(config_time_from_udp);
+        Serial.println("RTC time has been set.");
 
-          return;
-        }
+        SendCommandAck(udp, command, status);
+
+        cb();
+
+        return;
       }
     }
     
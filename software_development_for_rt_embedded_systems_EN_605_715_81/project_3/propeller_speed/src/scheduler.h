@@ -0,0 +1,151 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Cooperative scheduler of periodic tasks with absolute deadlines. Each task is released every
+// period at a fixed time: the next release is the previous one plus the period rather than the
+// time the task last ran, so late starts and long runs do not make the schedule drift. When several
+// tasks are due the one with the lowest priority number runs first, ties going to the earlier
+// release. A task still running at its next release missed its deadline, and releases that passed
+// meanwhile are skipped and counted as missed too instead of being run back to back. The task is
+// next released at the first period boundary after its run ended, so a task that overruns every
+// period still leaves the others room to run.
+//
+// RunNext() runs at most one task, so loop() can sleep whenever it returns false and is woken by
+// the next interrupt, at the latest the 1 ms system tick.
+//
+// Times are micros() readings, periods must stay below half the 71 minute wrap. Nothing in here
+// depends on Arduino, so it can be compiled and checked on the host.
+
+namespace scheduler {
+
+using Clock = uint32_t (*)();
+using TaskFunction = void (*)();
+
+struct Stats {
+  uint32_t runs = 0;
+  uint32_t missed = 0;
+  // Time from release to start.
+  uint32_t max_jitter_us = 0;
+  uint32_t max_run_us = 0;
+  uint64_t total_run_us = 0;
+
+  uint32_t MeanRunUs() const {
+    return runs == 0 ? 0 : (uint32_t)(total_run_us / runs);
+  }
+};
+
+struct Task {
+  const char* name;
+  TaskFunction function;
+  uint32_t period_us;
+  // 0 runs before 1 when both are due.
+  uint8_t priority;
+
+  uint32_t release_us = 0;
+  Stats stats = {};
+};
+
+class Scheduler {
+ public:
+  // Releases every task right away. `tasks` must outlive the scheduler.
+  void Begin(Task* tasks, size_t count, Clock clock) {
+    tasks_ = tasks;
+    count_ = count;
+    clock_ = clock;
+    uint32_t now_us = clock_();
+    for (size_t i = 0; i < count_; ++i) {
+      tasks_[i].release_us = now_us;
+      tasks_[i].stats = Stats();
+    }
+    stats_start_us_ = now_us;
+    idle_us_ = 0;
+  }
+
+  // Runs the most urgent due task. Returns false if none is due.
+  bool RunNext() {
+    uint32_t start_us = clock_();
+    Task* next = nullptr;
+    for (size_t i = 0; i < count_; ++i) {
+      Task& task = tasks_[i];
+      if ((int32_t)(start_us - task.release_us) < 0) {
+        continue;
+      }
+      if (next == nullptr || task.priority < next->priority ||
+          (task.priority == next->priority &&
+           (int32_t)(task.release_us - next->release_us) < 0)) {
+        next = &task;
+      }
+    }
+
+    if (next == nullptr) {
+      return false;
+    }
+
+    next->function();
+    uint32_t end_us = clock_();
+
+    Stats& stats = next->stats;
+    uint32_t jitter_us = start_us - next->release_us;
+    uint32_t run_us = end_us - start_us;
+    ++stats.runs;
+    stats.total_run_us += run_us;
+    if (jitter_us > stats.max_jitter_us) {
+      stats.max_jitter_us = jitter_us;
+    }
+    if (run_us > stats.max_run_us) {
+      stats.max_run_us = run_us;
+    }
+
+    next->release_us += next->period_us;
+    if ((int32_t)(end_us - next->release_us) > 0) {
+      uint32_t skipped = (end_us - next->release_us) / next->period_us + 1;
+      stats.missed += skipped;
+      next->release_us += skipped * next->period_us;
+    }
+    return true;
+  }
+
+  // Counts time loop() spent sleeping, for the load.
+  void AddIdle(uint32_t idle_us) {
+    idle_us_ += idle_us;
+  }
+
+  // Share of the time since the statistics were reset spent running tasks, 0 - 1.
+  float Load() const {
+    uint32_t elapsed_us = clock_() - stats_start_us_;
+    if (elapsed_us == 0 || idle_us_ >= elapsed_us) {
+      return 0;
+    }
+    return 1.0f - (float)idle_us_ / elapsed_us;
+  }
+
+  void ResetStats() {
+    for (size_t i = 0; i < count_; ++i) {
+      tasks_[i].stats = Stats();
+    }
+    stats_start_us_ = clock_();
+    idle_us_ = 0;
+  }
+
+  size_t Count() const {
+    return count_;
+  }
+
+  const Task& GetTask(size_t i) const {
+    return tasks_[i];
+  }
+
+ private:
+  Task* tasks_ = nullptr;
+  size_t count_ = 0;
+  Clock clock_ = nullptr;
+  uint32_t stats_start_us_ = 0;
+  uint32_t idle_us_ = 0;
+};
+
+} // scheduler
+
+#endif // SCHEDULER_H
@@ -0,0 +1,183 @@
+#ifndef SUBSCRIBERS_H
+#define SUBSCRIBERS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+// Fixed capacity table of clients that receive a node's telemetry. Clients add themselves with a
+// subscribe message and have to renew it before their lease runs out, so a client that went away
+// stops being sent to on its own. Each subscriber can ask for only every n-th frame, letting a
+// logger and a dashboard share a node at different rates. Command acks and other replies are still
+// answered to whoever sent the request.
+//
+// The table only keeps IPv4 addresses and ports. Nothing in here depends on Arduino, so it can be
+// compiled and checked on the host.
+
+namespace subscribers {
+
+inline constexpr size_t MAX_SUBSCRIBERS = 4;
+inline constexpr uint16_t DEFAULT_LEASE_S = 60;
+inline constexpr uint16_t MAX_LEASE_S = 3600;
+
+struct Subscriber {
+  uint32_t address = 0;
+  uint16_t port = 0;
+  uint8_t rate_divider = 1;
+  // Frames to skip before the next one is sent to this subscriber.
+  uint8_t countdown = 0;
+  unsigned long expires_ms = 0;
+  bool active = false;
+};
+
+class Table {
+ public:
+  // Adds a subscriber or renews its lease and rate divider. `lease_s` is clamped to MAX_LEASE_S, 0
+  // selects DEFAULT_LEASE_S. The granted lease is written to `granted_s`.
+  telemetry::SubscribeStatus Subscribe(uint32_t address, uint16_t port, uint16_t lease_s,
+                                       uint8_t rate_divider, unsigned long now_ms,
+                                       uint16_t& granted_s) {
+    Subscriber* subscriber = Find(address, port);
+    if (subscriber == nullptr) {
+      subscriber = FindFree();
+      if (subscriber == nullptr) {
+        granted_s = 0;
+        return telemetry::SubscribeStatus::TABLE_FULL;
+      }
+
+      subscriber->address = address;
+      subscriber->port = port;
+      subscriber->countdown = 0;
+      subscriber->active = true;
+    }
+
+    if (lease_s == 0) {
+      lease_s = DEFAULT_LEASE_S;
+    } else if (lease_s > MAX_LEASE_S) {
+      lease_s = MAX_LEASE_S;
+    }
+
+    subscriber->rate_divider = rate_divider == 0 ? 1 : rate_divider;
+    subscriber->expires_ms = now_ms + lease_s * 1000UL;
+    granted_s = lease_s;
+    return telemetry::SubscribeStatus::OK;
+  }
+
+  telemetry::SubscribeStatus Unsubscribe(uint32_t address, uint16_t port) {
+    Subscriber* subscriber = Find(address, port);
+    if (subscriber == nullptr) {
+      return telemetry::SubscribeStatus::NOT_SUBSCRIBED;
+    }
+
+    subscriber->active = false;
+    return telemetry::SubscribeStatus::OK;
+  }
+
+  // Drops every subscriber whose lease has run out. Returns how many were dropped.
+  size_t Expire(unsigned long now_ms) {
+    size_t expired = 0;
+    for (Subscriber& subscriber : subscribers_) {
+      if (subscriber.active && (long)(now_ms - subscriber.expires_ms) >= 0) {
+        subscriber.active = false;
+        ++expired;
+      }
+    }
+
+    return expired;
+  }
+
+  size_t Count() const {
+    size_t count = 0;
+    for (const Subscriber& subscriber : subscribers_) {
+      count += subscriber.active;
+    }
+
+    return count;
+  }
+
+  // Calls `send(subscriber)` for every subscriber, leaving the rate dividers alone.
+  template <typename Send>
+  void ForEach(Send send) {
+    for (Subscriber& subscriber : subscribers_) {
+      if (subscriber.active) {
+        send(subscriber);
+      }
+    }
+  }
+
+  // Calls `send(subscriber)` for every subscriber the next frame is due for and advances their rate
+  // dividers. Call once per frame.
+  template <typename Send>
+  void ForEachDue(Send send) {
+    for (Subscriber& subscriber : subscribers_) {
+      if (!subscriber.active) {
+        continue;
+      }
+
+      if (subscriber.countdown == 0) {
+        send(subscriber);
+        subscriber.countdown = subscriber.rate_divider - 1;
+      } else {
+        --subscriber.countdown;
+      }
+    }
+  }
+
+ private:
+  Subscriber* Find(uint32_t address, uint16_t port) {
+    for (Subscriber& subscriber : subscribers_) {
+      if (subscriber.active && subscriber.address == address && subscriber.port == port) {
+        return &subscriber;
+      }
+    }
+
+    return nullptr;
+  }
+
+  Subscriber* FindFree() {
+    for (Subscriber& subscriber : subscribers_) {
+      if (!subscriber.active) {
+        return &subscriber;
+      }
+    }
+
+    return nullptr;
+  }
+
+  Subscriber subscribers_[MAX_SUBSCRIBERS];
+};
+
+// Applies a subscribe or unsubscribe message received from `address`:`port` to `table` and encodes
+// the ack into `ack`, which must hold SUBSCRIBE_ACK_SIZE bytes. Returns the length of the ack, or 0
+// if `message` is neither.
+inline size_t HandleMessage(Table& table, const uint8_t* message, size_t length,
+                            uint32_t address, uint16_t port, uint8_t node_id,
+                            unsigned long now_ms, uint8_t* ack) {
+  telemetry::Header header;
+  if (!telemetry::DecodeHeader(message, length, header)) {
+    return 0;
+  }
+
+  telemetry::SubscribeStatus status;
+  uint16_t granted_s = 0;
+  if (header.type == telemetry::FrameType::SUBSCRIBE) {
+    uint16_t lease_s;
+    uint8_t rate_divider;
+    if (!telemetry::DecodeSubscribe(message, length, lease_s, rate_divider)) {
+      return 0;
+    }
+
+    status = table.Subscribe(address, port, lease_s, rate_divider, now_ms, granted_s);
+  } else if (header.type == telemetry::FrameType::UNSUBSCRIBE) {
+    status = table.Unsubscribe(address, port);
+  } else {
+    return 0;
+  }
+
+  return telemetry::EncodeSubscribeAck(ack, node_id, header.sequence, status, granted_s);
+}
+
+} // subscribers
+
+#endif // SUBSCRIBERS_H
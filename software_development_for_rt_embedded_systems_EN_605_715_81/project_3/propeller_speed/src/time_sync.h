@@ -0,0 +1,211 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// NTP style clock synchronization against the client that set the clock. Every sync sends ROUNDS
+// time requests. Each request carries the node's local time t1, and the client answers with its
+// receive time t2 and send time t3. The node notes its own receive time t4 and computes
+//
+//   offset = ((t2 - t1) + (t3 - t4)) / 2     delay = (t4 - t1) - (t3 - t2)
+//
+// The round with the smallest delay is the one least disturbed by queueing on the network, so its
+// offset is used. Between syncs the node's crystal drifts. The drift is estimated from how far
+// each sync's offset lands from the one predicted by the previous sync, and applied between syncs.
+//
+// Local time is micros() extended to 64 bits, remote time is microseconds since the unix epoch.
+// Nothing in here depends on Arduino, so it can be compiled and checked on the host.
+
+namespace time_sync {
+
+inline constexpr size_t ROUNDS = 8;
+inline constexpr int64_t ROUND_INTERVAL_US = 50000;
+// How long after the last request responses are still accepted.
+inline constexpr int64_t ROUND_TIMEOUT_US = 500000;
+inline constexpr int64_t RESYNC_INTERVAL_US = 600000000LL;
+// Used instead of RESYNC_INTERVAL_US after a sync that got no response at all.
+inline constexpr int64_t RETRY_INTERVAL_US = 5000000LL;
+// Drift is only estimated from syncs this far apart, over shorter spans the offset noise dominates.
+inline constexpr int64_t MIN_DRIFT_SPAN_US = 60000000LL;
+// Far beyond any crystal, larger estimates come from bad measurements.
+inline constexpr int32_t MAX_DRIFT_PPB = 500000;
+
+struct Measurement {
+  // Epoch time minus local time.
+  int64_t offset_us;
+  int64_t delay_us;
+  // Local time the measurement applies to.
+  int64_t local_us;
+};
+
+inline Measurement Measure(int64_t t1_local_us, int64_t t2_remote_us, int64_t t3_remote_us,
+                           int64_t t4_local_us) {
+  Measurement measurement;
+  measurement.offset_us = ((t2_remote_us - t1_local_us) + (t3_remote_us - t4_local_us)) / 2;
+  measurement.delay_us = (t4_local_us - t1_local_us) - (t3_remote_us - t2_remote_us);
+  measurement.local_us = t4_local_us;
+  return measurement;
+}
+
+// Epoch time derived from the local clock, the offset of the last sync and the estimated drift.
+class Clock {
+ public:
+  // Extends a micros() reading to 64 bits. Readings may be slightly older than the newest one seen,
+  // e.g. a receive time taken before other calls. Has to be called at least every 35 minutes, half
+  // a micros() wrap, which calling it from loop() easily does.
+  int64_t Local(uint32_t now_us) {
+    int32_t delta_us = (int32_t)(now_us - last_us_);
+    int64_t local_us = last_local_us_ + delta_us;
+    if (delta_us > 0) {
+      last_us_ = now_us;
+      last_local_us_ = local_us;
+    }
+    return local_us;
+  }
+
+  bool IsSet() const {
+    return set_;
+  }
+
+  // Sets the clock from a whole second epoch, e.g. one sent as text, until a sync refines it.
+  void SetCoarse(uint32_t epoch_s, int64_t local_us) {
+    anchor_local_us_ = local_us;
+    anchor_offset_us_ = epoch_s * 1000000LL - local_us;
+    precise_ = false;
+    set_ = true;
+  }
+
+  // Moves the clock to the offset of a sync and refines the drift estimate.
+  void Apply(const Measurement& measurement) {
+    int64_t span_us = measurement.local_us - anchor_local_us_;
+    if (precise_ && span_us >= MIN_DRIFT_SPAN_US) {
+      int64_t error_us = measurement.offset_us - PredictedOffset(measurement.local_us);
+      int64_t correction_ppb = error_us * 1000000000LL / span_us;
+      // The first estimate is taken as is, later ones are averaged in to smooth out noise.
+      int64_t drift_ppb = drift_estimated_ ? drift_ppb_ + correction_ppb / 2
+                                           : drift_ppb_ + correction_ppb;
+      if (drift_ppb > MAX_DRIFT_PPB) {
+        drift_ppb = MAX_DRIFT_PPB;
+      } else if (drift_ppb < -MAX_DRIFT_PPB) {
+        drift_ppb = -MAX_DRIFT_PPB;
+      }
+      drift_ppb_ = drift_ppb;
+      drift_estimated_ = true;
+    }
+
+    anchor_local_us_ = measurement.local_us;
+    anchor_offset_us_ = measurement.offset_us;
+    precise_ = true;
+    set_ = true;
+  }
+
+  // Microseconds since the unix epoch at `local_us`.
+  int64_t EpochMicros(int64_t local_us) const {
+    return local_us + PredictedOffset(local_us);
+  }
+
+  int32_t DriftPpb() const {
+    return drift_ppb_;
+  }
+
+ private:
+  int64_t PredictedOffset(int64_t local_us) const {
+    return anchor_offset_us_ + (local_us - anchor_local_us_) * drift_ppb_ / 1000000000LL;
+  }
+
+  uint32_t last_us_ = 0;
+  int64_t last_local_us_ = 0;
+
+  bool set_ = false;
+  bool precise_ = false;
+  bool drift_estimated_ = false;
+  int64_t anchor_local_us_ = 0;
+  int64_t anchor_offset_us_ = 0;
+  int32_t drift_ppb_ = 0;
+};
+
+enum class Step {
+  NONE,
+  // Send a request with the sequence number and t1 from Poll().
+  SEND_REQUEST,
+  // The sync finished, Best() holds the result if it succeeded.
+  FINISHED,
+};
+
+// Runs the request rounds of one sync. Requests go out every ROUND_INTERVAL_US and late responses
+// are matched to their round by sequence number, so a lost response only costs its own round.
+class Synchronizer {
+ public:
+  void Start(int64_t now_local_us) {
+    base_sequence_ += ROUNDS;
+    sent_ = 0;
+    best_.delay_us = -1;
+    next_us_ = now_local_us;
+    running_ = true;
+  }
+
+  bool IsRunning() const {
+    return running_;
+  }
+
+  // Advances the sync. On SEND_REQUEST `sequence` and `t1_us` are what the request has to carry.
+  Step Poll(int64_t now_local_us, uint32_t& sequence, uint32_t& t1_us) {
+    if (!running_ || now_local_us < next_us_) {
+      return Step::NONE;
+    }
+
+    if (sent_ == ROUNDS) {
+      running_ = false;
+      return Step::FINISHED;
+    }
+
+    t1_local_us_[sent_] = now_local_us;
+    sequence = base_sequence_ + sent_;
+    t1_us = (uint32_t)now_local_us;
+    ++sent_;
+    next_us_ = now_local_us + (sent_ == ROUNDS ? ROUND_TIMEOUT_US : ROUND_INTERVAL_US);
+    return Step::SEND_REQUEST;
+  }
+
+  // Takes a response received at `t4_local_us`. Responses to other syncs or with a t1 that does not
+  // match the request are ignored.
+  void OnResponse(uint32_t sequence, uint32_t t1_us, int64_t t2_remote_us, int64_t t3_remote_us,
+                  int64_t t4_local_us) {
+    uint32_t round = sequence - base_sequence_;
+    if (!running_ || round >= sent_ || (uint32_t)t1_local_us_[round] != t1_us) {
+      return;
+    }
+
+    Measurement measurement =
+        Measure(t1_local_us_[round], t2_remote_us, t3_remote_us, t4_local_us);
+    if (measurement.delay_us < 0) {
+      return;
+    }
+
+    if (best_.delay_us < 0 || measurement.delay_us < best_.delay_us) {
+      best_ = measurement;
+    }
+  }
+
+  // Whether the last finished sync got at least one usable response.
+  bool Succeeded() const {
+    return best_.delay_us >= 0;
+  }
+
+  const Measurement& Best() const {
+    return best_;
+  }
+
+ private:
+  uint32_t base_sequence_ = 0;
+  size_t sent_ = 0;
+  int64_t t1_local_us_[ROUNDS];
+  int64_t next_us_ = 0;
+  bool running_ = false;
+  Measurement best_ = {0, -1, 0};
+};
+
+} // time_sync
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <unity.h>
+
+#include <vector>
+
+#include "edge_stream.h"
+
+// Host throughput tests of the edge stream at 10000 edges per second and more, run with
+// `pio test -e native`. The blade pass ISR and the streaming task are simulated on one clock: the
+// ISR pushes an edge every 100 us or so, also while the task is busy sending, and the task drains
+// the ring on its schedule. Each test prints what it saw, including the ring overflows.
+
+namespace {
+
+// The board's streaming task period and EDGE_FRAME_MIN_EDGES / EDGE_FLUSH_INTERVAL_MS /
+// EDGE_FRAMES_PER_RUN.
+constexpr uint32_t TASK_PERIOD_US = 10000;
+constexpr size_t FRAME_MIN_EDGES = 256;
+constexpr uint32_t FLUSH_INTERVAL_US = 100000;
+constexpr size_t FRAMES_PER_RUN = 2;
+
+struct Simulation {
+  explicit Simulation(uint32_t edges_per_second) : edges_per_second(edges_per_second) {}
+
+  uint32_t edges_per_second;
+  edge_stream::Ring ring;
+  uint32_t now_us = 0;
+  // Time of the next edge and every edge pushed, including dropped ones.
+  uint32_t next_edge_us = 0;
+  std::vector<uint32_t> pushed;
+  // Decoded from the frames.
+  std::vector<uint32_t> received;
+  uint32_t sequence = 0;
+  uint32_t last_flush_us = 0;
+  uint32_t frames = 0;
+  uint64_t bytes = 0;
+  size_t max_fill = 0;
+  uint32_t reported_overflows = 0;
+  bool frames_valid = true;
+
+  // Advances the clock, pushing the edges that happen meanwhile. Spacing varies by up to 10 us
+  // around the mean, as blade passes do.
+  void AdvanceTo(uint32_t until_us) {
+    while ((int32_t)(until_us - next_edge_us) >= 0) {
+      ring.Push(next_edge_us);
+      pushed.push_back(next_edge_us);
+      size_t fill = ring.Size();
+      max_fill = fill > max_fill ? fill : max_fill;
+      next_edge_us += 1000000 / edges_per_second - 10 + pushed.size() % 21;
+    }
+    now_us = until_us;
+  }
+
+  // streamEdges(): once enough edges are waiting or the flush interval ran out, frames go out until
+  // the ring is empty or FRAMES_PER_RUN were sent, each taking `send_us` to send.
+  void RunTask(uint32_t send_us) {
+    if (ring.Size() < FRAME_MIN_EDGES && now_us - last_flush_us < FLUSH_INTERVAL_US) {
+      return;
+    }
+    last_flush_us = now_us;
+
+    uint8_t frame[telemetry::MAX_EDGES_FRAME_SIZE];
+    size_t length;
+    for (size_t run_frames = 0;
+         run_frames < FRAMES_PER_RUN &&
+         (length = edge_stream::EncodeFrame(ring, frame, 2, sequence)) != 0;
+         ++run_frames) {
+      ++sequence;
+      ++frames;
+      bytes += length;
+      Decode(frame, length);
+      AdvanceTo(now_us + send_us);
+    }
+  }
+
+  void Decode(const uint8_t* frame, size_t length) {
+    const uint8_t* cursor = frame + telemetry::HEADER_SIZE;
+    uint32_t first_index = telemetry::GetU32(cursor);
+    reported_overflows = telemetry::GetU32(cursor + 4);
+    uint16_t count = telemetry::GetU16(cursor + 8);
+    uint32_t timestamp_us = telemetry::GetU32(cursor + 10);
+    cursor += 14;
+    frames_valid = frames_valid && first_index == received.size() && count > 0 &&
+                   length <= telemetry::MAX_EDGES_FRAME_SIZE;
+    received.push_back(timestamp_us);
+    const uint8_t* end = frame + length;
+    for (uint16_t i = 1; i < count && cursor < end; ++i) {
+      uint32_t delta_us = 0;
+      for (int shift = 0; cursor < end; shift += 7) {
+        uint8_t byte = *cursor++;
+        delta_us |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+          break;
+        }
+      }
+      timestamp_us += delta_us;
+      received.push_back(timestamp_us);
+    }
+    frames_valid = frames_valid && cursor == end;
+  }
+
+  // Runs for `seconds`, the task released every TASK_PERIOD_US after its last run as the scheduler
+  // does. Once every `stall_every_us` the WiFi module blocks the task for `stall_us`.
+  void Run(uint32_t seconds, uint32_t send_us, uint32_t stall_every_us, uint32_t stall_us) {
+    uint32_t end_us = seconds * 1000000;
+    uint32_t release_us = 0;
+    uint32_t next_stall_us = stall_every_us;
+    while (now_us < end_us) {
+      AdvanceTo(release_us);
+      if (stall_every_us != 0 && now_us >= next_stall_us) {
+        AdvanceTo(now_us + stall_us);
+        next_stall_us += stall_every_us;
+      }
+      RunTask(send_us);
+      release_us += TASK_PERIOD_US;
+      while ((int32_t)(now_us - release_us) > 0) {
+        release_us += TASK_PERIOD_US;
+      }
+    }
+  }
+
+  void Report(const char* name) const {
+    double seconds = now_us / 1e6;
+    printf("%s: %zu edges in %.1f s, %u frames, %.0f bytes/s, ring peak %zu of %zu, "
+           "%u overflows\n", name, pushed.size(), seconds, (unsigned)frames, bytes / seconds,
+           max_fill, edge_stream::RING_CAPACITY, (unsigned)ring.Overflows());
+  }
+};
+
+// Everything that was not dropped or is still waiting arrived, in order and with its exact
+// timestamp.
+void AssertReceivedInOrder(const Simulation& simulation) {
+  TEST_ASSERT_TRUE(simulation.frames_valid);
+  TEST_ASSERT_EQUAL_UINT32(simulation.pushed.size(),
+                           simulation.received.size() + simulation.ring.Overflows() +
+                               simulation.ring.Size());
+  size_t next = 0;
+  for (uint32_t timestamp_us : simulation.received) {
+    while (next < simulation.pushed.size() && simulation.pushed[next] != timestamp_us) {
+      ++next;
+    }
+    TEST_ASSERT_TRUE(next < simulation.pushed.size());
+    ++next;
+  }
+}
+
+} // namespace
+
+void setUp() {}
+
+void tearDown() {}
+
+// 3 ms per frame sent and a 60 ms stall of the WiFi module every second, which the ring rides out.
+void test_ten_thousand_edges_per_second() {
+  Simulation simulation(10000);
+  simulation.Run(10, 3000, 1000000, 60000);
+  simulation.Report("10k edges/s");
+
+  TEST_ASSERT_EQUAL_UINT32(0, simulation.ring.Overflows());
+  TEST_ASSERT_EQUAL_UINT32(0, simulation.reported_overflows);
+  TEST_ASSERT_LESS_THAN(edge_stream::RING_CAPACITY, simulation.max_fill);
+  TEST_ASSERT_EQUAL_size_t(simulation.pushed.size() - simulation.ring.Size(),
+                           simulation.received.size());
+  for (size_t i = 0; i < simulation.received.size(); ++i) {
+    TEST_ASSERT_EQUAL_UINT32(simulation.pushed[i], simulation.received[i]);
+  }
+  AssertReceivedInOrder(simulation);
+}
+
+// The sustained rate the 10 ms task period supports: a frame holds about 1000 edges at these
+// one-byte deltas, so the ring filling between two runs is the limit.
+void test_eighty_thousand_edges_per_second() {
+  Simulation simulation(80000);
+  simulation.Run(10, 3000, 0, 0);
+  simulation.Report("80k edges/s");
+
+  TEST_ASSERT_EQUAL_UINT32(0, simulation.ring.Overflows());
+  TEST_ASSERT_LESS_THAN(edge_stream::RING_CAPACITY, simulation.max_fill);
+  AssertReceivedInOrder(simulation);
+}
+
+// A 200 ms stall is twice what the ring holds. The ISR drops the edges that do not fit and the next
+// frame reports them, while the edges that were kept still arrive.
+void test_long_stall_overflows_and_is_reported() {
+  Simulation simulation(10000);
+  simulation.Run(2, 3000, 1500000, 200000);
+  simulation.Report("200 ms stall");
+
+  uint32_t overflows = simulation.ring.Overflows();
+  // At least what the stall adds beyond the ring, plus at most the edges that were already waiting.
+  TEST_ASSERT_GREATER_THAN(2000 - edge_stream::RING_CAPACITY - 1, overflows);
+  TEST_ASSERT_LESS_THAN(2000 - edge_stream::RING_CAPACITY + 2 * FRAME_MIN_EDGES, overflows);
+  TEST_ASSERT_EQUAL_UINT32(overflows, simulation.reported_overflows);
+  TEST_ASSERT_EQUAL_size_t(edge_stream::RING_CAPACITY, simulation.max_fill);
+  AssertReceivedInOrder(simulation);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ten_thousand_edges_per_second);
+  RUN_TEST(test_eighty_thousand_edges_per_second);
+  RUN_TEST(test_long_stall_overflows_and_is_reported);
+  return UNITY_END();
+}